@@ -0,0 +1,97 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "AllocationCounter.h"
+
+// relaxed, the totals are only read as a snapshot between frames and an increment costs next to the malloc
+static std::atomic<unsigned long long> allocationCount(0);
+static std::atomic<unsigned long long> allocatedBytes(0);
+
+unsigned long long GetAllocationCount()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+unsigned long long GetAllocatedBytes()
+{
+	return allocatedBytes.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+	// what the standard library's does: retry through the new handler, throw when there is none
+	if (size == 0)
+	{
+		size = 1;
+	}
+	for (;;)
+	{
+		void* memory = std::malloc(size);
+		if (memory)
+		{
+			return memory;
+		}
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+		{
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Every allocation made through operator new since the program started. AllocationCounter.cpp replaces the global
+// allocation functions to count them, so the engine's containers count too; with Urho3D built as a DLL on Windows
+// the engine has its own copy of the functions and only the game's allocations are seen
+unsigned long long GetAllocationCount();
+unsigned long long GetAllocatedBytes();
@@ -0,0 +1,75 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include "BitStream.h"
+
+BitWriter::BitWriter()
+{
+	bitCount = 0;
+}
+
+void BitWriter::WriteBits(unsigned value, int bits)
+{
+	for (int i = 0; i < bits; i++)
+	{
+		unsigned byte = bitCount >> 3;
+		if (byte == data.Size())
+		{
+			data.Push(0);
+		}
+		if (value & (1u << i))
+		{
+			data[byte] |= (unsigned char)(1u << (bitCount & 7));
+		}
+		bitCount++;
+	}
+}
+
+void BitWriter::WriteQuantised(double value, double minValue, double maxValue, double precision)
+{
+	unsigned steps = (unsigned)((maxValue - minValue) / precision + 0.5);
+	double step = Floor((value - minValue) / precision + 0.5);
+	unsigned quantised = step <= 0.0 ? 0 : step >= steps ? steps : (unsigned)step;
+	WriteBits(quantised, BitsForSteps(steps));
+}
+
+BitReader::BitReader(const unsigned char* data, unsigned size) :
+	data(data),
+	size(size)
+{
+	bitPosition = 0;
+	overrun = false;
+}
+
+BitReader::BitReader(const PODVector<unsigned char>& data) :
+	data(data.Buffer()),
+	size(data.Size())
+{
+	bitPosition = 0;
+	overrun = false;
+}
+
+unsigned BitReader::ReadBits(int bits)
+{
+	unsigned value = 0;
+	for (int i = 0; i < bits; i++)
+	{
+		if (bitPosition >= size * 8)
+		{
+			overrun = true;
+			return 0;
+		}
+		if (data[bitPosition >> 3] & (1u << (bitPosition & 7)))
+		{
+			value |= 1u << i;
+		}
+		bitPosition++;
+	}
+	return value;
+}
+
+double BitReader::ReadQuantised(double minValue, double maxValue, double precision)
+{
+	unsigned steps = (unsigned)((maxValue - minValue) / precision + 0.5);
+	unsigned quantised = ReadBits(BitsForSteps(steps));
+	return minValue + Min(quantised, steps) * precision;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <Urho3D/Container/Vector.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// bits needed for a count of steps, compile time so a schema knows its size without running
+constexpr int BitsForSteps(unsigned steps)
+{
+	return steps == 0 ? 0 : 1 + BitsForSteps(steps >> 1);
+}
+
+// bits for a value between min and max in steps of precision
+constexpr int BitsForRange(double minValue, double maxValue, double precision)
+{
+	return BitsForSteps((unsigned)((maxValue - minValue) / precision + 0.5));
+}
+
+// packs values with only as many bits as their range needs, least significant bit first
+class BitWriter
+{
+public:
+	BitWriter();
+
+	void WriteBits(unsigned value, int bits);
+	void WriteBool(bool value) { WriteBits(value ? 1 : 0, 1); }
+
+	// value clamped to min-max and rounded to the nearest step of precision
+	void WriteQuantised(double value, double minValue, double maxValue, double precision);
+
+	const unsigned char* GetData() const { return data.Buffer(); }
+	unsigned GetSize() const { return data.Size(); }
+	unsigned GetBitCount() const { return bitCount; }
+
+private:
+	PODVector<unsigned char> data;
+	unsigned bitCount;
+};
+
+// reads what a BitWriter packed, reading past the end gives zeros and sets the overrun flag
+class BitReader
+{
+public:
+	BitReader(const unsigned char* data, unsigned size);
+	explicit BitReader(const PODVector<unsigned char>& data);
+
+	unsigned ReadBits(int bits);
+	bool ReadBool() { return ReadBits(1) != 0; }
+	double ReadQuantised(double minValue, double maxValue, double precision);
+
+	bool IsOverrun() const { return overrun; }
+	unsigned GetBitsLeft() const { return size * 8 - bitPosition; }
+
+private:
+	const unsigned char* data;
+	unsigned size;
+	unsigned bitPosition;
+	bool overrun;
+};
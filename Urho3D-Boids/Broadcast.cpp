@@ -0,0 +1,117 @@
+#include <Urho3D/Math/MathDefs.h>
+#include <Urho3D/Network/Connection.h>
+
+#include "Broadcast.h"
+#include "NetworkStats.h"
+
+BroadcastGroup::BroadcastGroup()
+{
+	interval = 1;
+
+	writtenBytes = 0.0f;
+	sentBytes = 0.0f;
+	written = 0;
+	sent = 0;
+	lastReport = 0.0f;
+}
+
+void BroadcastGroup::Add(Connection* connection)
+{
+	members.Insert(connection);
+}
+
+bool BroadcastGroup::Remove(Connection* connection)
+{
+	return members.Erase(connection);
+}
+
+void BroadcastGroup::Clear()
+{
+	members.Clear();
+	bootstrap.Reset();
+}
+
+SharedPtr<SharedMessage> BroadcastGroup::GetBootstrap(unsigned update, unsigned worldChecksum, const PODVector<Vector3>& positions,
+	const PODVector<Vector3>& velocities, float time)
+{
+	// an empty group has not been writing, its mirror is stale
+	if (members.Empty() && writer.sequence != (unsigned short)update)
+	{
+		writer.Restart((unsigned short)update);
+		bootstrap.Reset();
+	}
+
+	if (!bootstrap || bootstrap->sequence != writer.sequence)
+	{
+		bootstrap = new SharedMessage();
+		writer.WriteBootstrap(worldChecksum, positions, velocities, time, bootstrap->buffer);
+		bootstrap->sequence = writer.sequence;
+		written += bootstrap->buffer.GetSize();
+	}
+	return bootstrap;
+}
+
+SharedPtr<SharedMessage> BroadcastGroup::GetResume(unsigned update, unsigned worldChecksum, unsigned sinceTime, unsigned boidCount, float time)
+{
+	if (sinceTime == 0 || (members.Empty() && writer.sequence != (unsigned short)update) || writer.GetBoidCount() == 0
+		|| writer.GetBoidCount() != boidCount)
+	{
+		return SharedPtr<SharedMessage>();
+	}
+
+	// one client's, not shared, nobody else was away for the same time
+	SharedPtr<SharedMessage> message(new SharedMessage());
+	unsigned count = writer.WriteResume(worldChecksum, sinceTime, time, message->buffer);
+	// past half the flock the compressed bootstrap is about as small
+	if (count * 2 > boidCount)
+	{
+		return SharedPtr<SharedMessage>();
+	}
+	message->sequence = writer.sequence;
+	written += message->buffer.GetSize();
+	return message;
+}
+
+SharedMessage* BroadcastGroup::Write(unsigned update, const PODVector<Vector3>& positions, const PODVector<Vector3>& velocities, float time)
+{
+	SharedMessage* message = new SharedMessage();
+	writer.WriteUpdate(positions, velocities, (unsigned short)update, time, message->buffer);
+	message->sequence = writer.sequence;
+	return message;
+}
+
+void BroadcastGroup::Deliver(const SharedMessage& message, float time, NetworkStats& stats)
+{
+	written += message.buffer.GetSize();
+	SendAll(MSG_BOIDUPDATE, false, message, stats, "BoidUpdate");
+
+	if (time - lastReport >= 1.0f)
+	{
+		writtenBytes = written / (time - lastReport);
+		sentBytes = sent / (time - lastReport);
+		written = 0;
+		sent = 0;
+		lastReport = time;
+	}
+}
+
+void BroadcastGroup::SendAll(int messageID, bool reliable, const SharedMessage& message, NetworkStats& stats, const String& messageName)
+{
+	for (HashSet<Connection*>::ConstIterator i = members.Begin(); i != members.End(); ++i)
+	{
+		Send(*i, messageID, reliable, message, stats, messageName);
+	}
+}
+
+void BroadcastGroup::Send(Connection* connection, int messageID, bool reliable, const SharedMessage& message, NetworkStats& stats, const String& messageName)
+{
+	connection->SendMessage(messageID, reliable, reliable, message.buffer);
+	stats.RecordMessage(connection, TRAFFIC_CUSTOM, messageName, message.buffer.GetSize(), true);
+	sent += message.buffer.GetSize();
+}
+
+String BroadcastGroup::GetDebugText() const
+{
+	return String(members.Size()) + " connections every " + String(interval) + " updates, written "
+		+ String((int)writtenBytes) + " B/s sent " + String((int)sentBytes) + " B/s, " + writer.GetDebugText();
+}
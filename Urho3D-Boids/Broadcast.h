@@ -0,0 +1,80 @@
+#pragma once
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/RefCounted.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#include "WorldSync.h"
+
+namespace Urho3D
+{
+	class Connection;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class NetworkStats;
+
+// a message written once and shared by every connection it goes to
+class SharedMessage : public RefCounted
+{
+public:
+	VectorBuffer buffer;
+	// boid stream sequence the message was written at
+	unsigned short sequence;
+};
+
+// server: connections that get the boid stream at the same rate. Each update is written once by the group's own
+// writer, so its dead reckoning mirror matches what exactly these connections were sent, and fanned out to all of
+// them. Joiners in the same update share one compressed bootstrap
+class BroadcastGroup
+{
+public:
+	BroadcastGroup();
+
+	void Add(Connection* connection);
+	bool Remove(Connection* connection);
+	bool Contains(Connection* connection) const { return members.Contains(connection); }
+	void Clear();
+
+	// the bootstrap for a joiner at network update update, written again only once the stream has moved on
+	SharedPtr<SharedMessage> GetBootstrap(unsigned update, unsigned worldChecksum, const PODVector<Vector3>& positions,
+		const PODVector<Vector3>& velocities, float time);
+	// a resumed client's catch up from sinceTime in place of the bootstrap; null when it needs the bootstrap after
+	// all, because the group has not been writing, the client kept a different flock or most boids went out since
+	SharedPtr<SharedMessage> GetResume(unsigned update, unsigned worldChecksum, unsigned sinceTime, unsigned boidCount, float time);
+
+	// on every update'th network update the boid update is written once and sent to every member. Write only
+	// touches the writer, so it can run on another thread, the message is new and the caller's; Deliver sends it
+	// from the main thread
+	bool IsDue(unsigned update) const { return !members.Empty() && update % Max(interval, 1) == 0; }
+	SharedMessage* Write(unsigned update, const PODVector<Vector3>& positions, const PODVector<Vector3>& velocities, float time);
+	void Deliver(const SharedMessage& message, float time, NetworkStats& stats);
+
+	// send a shared message to every member
+	void SendAll(int messageID, bool reliable, const SharedMessage& message, NetworkStats& stats, const String& messageName);
+
+	// send a shared message to one member, for the bootstrap
+	void Send(Connection* connection, int messageID, bool reliable, const SharedMessage& message, NetworkStats& stats, const String& messageName);
+
+	String GetDebugText() const;
+
+	String name;
+	// network updates per boid update, observers can take the stream at a fraction of the send rate
+	int interval;
+
+	BoidStreamWriter writer;
+	HashSet<Connection*> members;
+
+	// readout, per second
+	float writtenBytes;
+	float sentBytes;
+
+private:
+	SharedPtr<SharedMessage> bootstrap;
+	unsigned written;
+	unsigned sent;
+	float lastReport;
+};
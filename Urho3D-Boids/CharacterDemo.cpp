@@ -21,6 +21,8 @@
 //
 
 #include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
 #include <Urho3D/Core/ProcessUtils.h>
 #include <Urho3D/Engine/Engine.h>
 #include <Urho3D/Graphics/AnimatedModel.h>
@@ -33,6 +35,7 @@
 #include <Urho3D/Graphics/Zone.h>
 #include <Urho3D/Input/Controls.h>
 #include <Urho3D/Input/Input.h>
+#include <Urho3D/IO/File.h>
 #include <Urho3D/IO/FileSystem.h>
 #include <Urho3D/Physics/CollisionShape.h>
 #include <Urho3D/Physics/PhysicsWorld.h>
@@ -59,6 +62,10 @@
 
 #include <Urho3D/Physics/PhysicsEvents.h>
 #include <Urho3D/Graphics/DebugRenderer.h>
+#include <Urho3D/Scene/SceneEvents.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Engine/DebugHud.h>
 
 #include "Character.h"
 #include "CharacterDemo.h"
@@ -71,20 +78,9 @@
 
 static const StringHash E_CLIENTCUSTOMEVENT("ClientCustomEvent");
 
-// Custom remote event we use to tell the client which object they control
-static const StringHash E_CLIENTOBJECTAUTHORITY("ClientObjectAuthority");
-// Identifier for the node ID parameter in the event data
-static const StringHash PLAYER_ID("IDENTITY");
-// Custom event on server, client has pressed button that it wants to start game
-static const StringHash E_CLIENTISREADY("ClientReadyToStart");
-
 URHO3D_DEFINE_APPLICATION_MAIN(CharacterDemo)
 
-// gameobjects
-// BoidSet boids;
-int numOfBoidsets = 10; // needs to be an even number for the boid splitting to work properly
-int updateCycleIndex = 0;
-BoidSet boids[10]; // 10 x 20 boids
+// gameobjects, the flock is in each Room
 Player player;
 // integers for the ui texts
 int timer = 100;
@@ -94,8 +90,6 @@ LineEdit* scoreText;
 LineEdit* timerText;
 LineEdit* healthText;
 
-float ClientTimeStep = 0.0f;
-
 // Mouse sensitivity as degrees per pixel
 const float MOUSE_SENSITIVITY = 0.1f;
 
@@ -110,8 +104,404 @@ CharacterDemo::~CharacterDemo()
 {
 }
 
+void CharacterDemo::Setup()
+{
+	ParseArguments();
+
+	// Execute base class setup
+	Sample::Setup();
+
+	String logDir = GetSubsystem<FileSystem>()->GetAppPreferencesDir("urho3d", "logs");
+	if (statsDir_.Empty())
+	{
+		statsDir_ = logDir + "bots/";
+	}
+	if (recordDir_.Empty())
+	{
+		recordDir_ = logDir + "recordings/";
+	}
+	if (captureDir_.Empty())
+	{
+		captureDir_ = logDir + "captures/";
+	}
+
+	if (IsHeadless())
+	{
+		// no window, renderer or sound, and a log per instance so processes sharing a host do not clobber each other
+		engineParameters_["Headless"] = true;
+		if (!trafficFile_.Empty())
+		{
+			engineParameters_["LogName"] = logDir + GetTypeName() + "TrafficReplay.log";
+		}
+		else if (dedicatedServer_)
+		{
+			engineParameters_["LogName"] = logDir + GetTypeName() + "Server" + String(serverPort_) + ".log";
+		}
+		else if (botMode_)
+		{
+			engineParameters_["LogName"] = logDir + GetTypeName() + "Bot" + String(botID_) + ".log";
+		}
+		else if (checkMessages_)
+		{
+			engineParameters_["LogName"] = logDir + GetTypeName() + "MessageCheck.log";
+		}
+		else if (!replayFile_.Empty())
+		{
+			engineParameters_["LogName"] = logDir + GetTypeName() + "Replay.log";
+		}
+		else if (netCheck_)
+		{
+			engineParameters_["LogName"] = logDir + GetTypeName() + "NetCheck.log";
+		}
+		else
+		{
+			engineParameters_["LogName"] = logDir + GetTypeName() + "BotLauncher.log";
+		}
+	}
+
+	if (netStatsDump_)
+	{
+		String dumpName = dedicatedServer_ ? "NetStatsServer" + String(serverPort_) : botMode_ ? "NetStatsBot" + String(botID_) : String("NetStats");
+		if (!networkStats_.OpenDump(context_, logDir + dumpName + ".csv"))
+		{
+			URHO3D_LOGERROR("Could not open the network stats dump in " + logDir);
+		}
+	}
+}
+
+void CharacterDemo::ParseArguments()
+{
+	const Vector<String>& arguments = GetArguments();
+	for (unsigned i = 0; i < arguments.Size(); ++i)
+	{
+		String argument = arguments[i].ToLower();
+		bool hasValue = i + 1 < arguments.Size();
+
+		if (argument == "--server")
+		{
+			dedicatedServer_ = true;
+		}
+		else if (argument == "--port" && hasValue)
+		{
+			serverPort_ = (unsigned short)ToUInt(arguments[++i]);
+		}
+		else if (argument == "--boids" && hasValue)
+		{
+			boidCount_ = Max(ToInt(arguments[++i]), 1);
+		}
+		else if (argument == "--tickrate" && hasValue)
+		{
+			tickRate_ = Clamp(ToInt(arguments[++i]), 1, 240);
+		}
+		else if (argument == "--sendrate" && hasValue)
+		{
+			sendRate_ = Clamp(ToInt(arguments[++i]), 1, 240);
+		}
+		else if (argument == "--fps" && hasValue)
+		{
+			renderFps_ = Max(ToInt(arguments[++i]), 0);
+		}
+		else if (argument == "--dr-error" && hasValue)
+		{
+			deadReckonError_ = Max(ToFloat(arguments[++i]), 0.0f);
+		}
+		else if (argument == "--dr-silence" && hasValue)
+		{
+			deadReckonSilence_ = Max(ToFloat(arguments[++i]), 0.0f);
+		}
+		else if (argument == "--observer-rate" && hasValue)
+		{
+			observerRate_ = Clamp(ToInt(arguments[++i]), 1, 240);
+		}
+		else if (argument == "--slots" && hasValue)
+		{
+			playerSlotCount_ = Max(ToInt(arguments[++i]), 0);
+		}
+		else if (argument == "--bot")
+		{
+			botMode_ = true;
+		}
+		else if (argument == "--bots" && hasValue)
+		{
+			botLaunchCount_ = Max(ToInt(arguments[++i]), 0);
+		}
+		else if (argument == "--bot-id" && hasValue)
+		{
+			botID_ = ToInt(arguments[++i]);
+		}
+		else if (argument == "--address" && hasValue)
+		{
+			botAddress_ = arguments[++i];
+		}
+		else if (argument == "--pattern" && hasValue)
+		{
+			botPattern_ = arguments[++i].ToLower();
+		}
+		else if (argument == "--stats-dir" && hasValue)
+		{
+			statsDir_ = AddTrailingSlash(arguments[++i]);
+		}
+		else if (argument == "--spawn-interval" && hasValue)
+		{
+			botSpawnInterval_ = Max(ToInt(arguments[++i]), 0) / 1000.0f;
+		}
+		else if (argument == "--input-rate" && hasValue)
+		{
+			inputRate_ = Clamp(ToFloat(arguments[++i]), 1.0f, 120.0f);
+		}
+		else if (argument == "--input-redundancy" && hasValue)
+		{
+			inputRedundancy_ = Clamp(ToInt(arguments[++i]), 1, InputSender::MAX_HISTORY);
+		}
+		else if (argument == "--netstats")
+		{
+			netStatsDump_ = true;
+		}
+		else if (argument == "--replicated-physics")
+		{
+			replicatedPhysics_ = true;
+		}
+		else if (argument == "--check-messages")
+		{
+			checkMessages_ = true;
+		}
+		else if (argument == "--lockstep")
+		{
+			lockstep_ = true;
+		}
+		else if (argument == "--seed" && hasValue)
+		{
+			flockSeed_ = ToUInt(arguments[++i]);
+		}
+		else if (argument == "--rooms" && hasValue)
+		{
+			roomCount_ = Clamp(ToInt(arguments[++i]), 1, 64);
+		}
+		else if (argument == "--room" && hasValue)
+		{
+			roomID_ = ToUInt(arguments[++i]);
+		}
+		else if (argument == "--shards" && hasValue)
+		{
+			shardCount_ = Clamp(ToInt(arguments[++i]), 1, 64);
+		}
+		else if (argument == "--shard" && hasValue)
+		{
+			shardIndex_ = Max(ToInt(arguments[++i]), 0);
+		}
+		else if (argument == "--shard-key" && hasValue)
+		{
+			shardKey_ = arguments[++i];
+		}
+		else if (argument == "--shard-width" && hasValue)
+		{
+			shardWidth_ = Max(ToFloat(arguments[++i]), 10.0f);
+		}
+		else if (argument == "--net-thread")
+		{
+			netThread_ = true;
+		}
+		else if (argument == "--serial-frame")
+		{
+			serialFrame_ = true;
+		}
+		else if (argument == "--record")
+		{
+			record_ = true;
+		}
+		else if (argument == "--record-dir" && hasValue)
+		{
+			recordDir_ = AddTrailingSlash(arguments[++i]);
+		}
+		else if (argument == "--replay" && hasValue)
+		{
+			replayFile_ = arguments[++i];
+		}
+		else if (argument == "--from" && hasValue)
+		{
+			replayFrom_ = ToUInt(arguments[++i]);
+		}
+		else if (argument == "--to" && hasValue)
+		{
+			replayTo_ = ToUInt(arguments[++i]);
+		}
+		else if (argument == "--replay-csv" && hasValue)
+		{
+			replayCsv_ = arguments[++i];
+		}
+		else if (argument == "--latency" && hasValue)
+		{
+			simulatedLatency_ = Clamp(ToInt(arguments[++i]), 0, 2000);
+		}
+		else if (argument == "--loss" && hasValue)
+		{
+			simulatedLoss_ = Clamp(ToFloat(arguments[++i]), 0.0f, 100.0f);
+		}
+		else if (argument == "--exit-after" && hasValue)
+		{
+			exitAfter_ = Max(ToFloat(arguments[++i]), 0.0f);
+		}
+		else if (argument == "--netcheck")
+		{
+			netCheck_ = true;
+		}
+		else if (argument == "--netcheck-profile" && hasValue)
+		{
+			netCheckProfile_ = arguments[++i].ToLower();
+		}
+		else if (argument == "--netcheck-bots" && hasValue)
+		{
+			netCheckBots_ = Clamp(ToInt(arguments[++i]), 1, 64);
+		}
+		else if (argument == "--netcheck-time" && hasValue)
+		{
+			netCheckTime_ = Max(ToFloat(arguments[++i]), 5.0f);
+		}
+		else if (argument == "--netcheck-out" && hasValue)
+		{
+			netCheckOut_ = arguments[++i];
+		}
+		else if (argument == "--capture")
+		{
+			capture_ = true;
+		}
+		else if (argument == "--capture-dir" && hasValue)
+		{
+			captureDir_ = AddTrailingSlash(arguments[++i]);
+		}
+		else if (argument == "--replay-traffic" && hasValue)
+		{
+			// the replay plays into a server of its own
+			trafficFile_ = arguments[++i];
+			dedicatedServer_ = true;
+		}
+		else if (argument == "--speed" && hasValue)
+		{
+			String speed = arguments[++i].ToLower();
+			trafficSpeed_ = speed == "max" ? 0.0f : Clamp(ToFloat(speed), 0.1f, 100.0f);
+		}
+		else if (argument == "--traffic-copies" && hasValue)
+		{
+			trafficCopies_ = Clamp(ToInt(arguments[++i]), 1, 64);
+		}
+		else if (argument == "--resume-grace" && hasValue)
+		{
+			resumeGrace_ = Clamp(ToFloat(arguments[++i]), 0.0f, 255.0f);
+		}
+	}
+}
+
 void CharacterDemo::Start()
 {
+	inputSender_.sendInterval = 1.0f / inputRate_;
+	inputSender_.redundancy = inputRedundancy_;
+
+	// simulation, snapshots and rendering each run at their own rate
+	simClock_.SetRate(tickRate_);
+	GetSubsystem<Network>()->SetUpdateFps(sendRate_);
+	frameGraph_.serial = serialFrame_;
+
+	// kNet holds back and drops what this end sends, so a server and its bots given the same values see the
+	// latency and loss both ways
+	if (simulatedLatency_ > 0 || simulatedLoss_ > 0.0f)
+	{
+		GetSubsystem<Network>()->SetSimulatedLatency(simulatedLatency_);
+		GetSubsystem<Network>()->SetSimulatedPacketLoss(simulatedLoss_ / 100.0f);
+		URHO3D_LOGINFO("Simulating " + String(simulatedLatency_) + " ms latency and " + String(simulatedLoss_) + "% loss on sent packets");
+	}
+
+	if (!IsHeadless())
+	{
+		engine_->SetMaxFps(renderFps_);
+	}
+
+	if (shardCount_ > 1 && (!dedicatedServer_ || lockstep_ || roomCount_ > 1 || shardIndex_ >= shardCount_ || shardKey_.Empty()))
+	{
+		URHO3D_LOGWARNING("--shards needs --server, a --shard below it and a --shard-key, without --lockstep or --rooms");
+		shardCount_ = 1;
+	}
+
+	// the flock is laid out from this, a lockstep match sends it to every peer, shards all need the same one
+	if (flockSeed_ == 0)
+	{
+		flockSeed_ = shardCount_ > 1 ? 1 : Max(Time::GetSystemTime(), 1u);
+	}
+	if (lockstep_ && !dedicatedServer_)
+	{
+		URHO3D_LOGWARNING("--lockstep needs --server, a client finds out from the server it joins");
+		lockstep_ = false;
+	}
+	if (roomCount_ > 1 && !dedicatedServer_)
+	{
+		URHO3D_LOGWARNING("--rooms needs --server, a host plays in the one room it shows");
+		roomCount_ = 1;
+	}
+	if (netThread_ && !dedicatedServer_)
+	{
+		URHO3D_LOGWARNING("--net-thread needs --server");
+		netThread_ = false;
+	}
+	if (record_ && !dedicatedServer_)
+	{
+		URHO3D_LOGWARNING("--record needs --server");
+		record_ = false;
+	}
+	if (capture_ && (!dedicatedServer_ || !trafficFile_.Empty()))
+	{
+		URHO3D_LOGWARNING("--capture needs --server, and a replay would only capture itself");
+		capture_ = false;
+	}
+
+	if (checkMessages_)
+	{
+		// round trip the game message schemas and exit, non zero on a failure
+		if (CheckGameMessages())
+		{
+			engine_->Exit();
+		}
+		else
+		{
+			ErrorExit("Game message check failed");
+		}
+		return;
+	}
+	if (!replayFile_.Empty())
+	{
+		// step through the recording as fast as it reads and exit, non zero when it could not be read
+		if (RunReplay())
+		{
+			engine_->Exit();
+		}
+		else
+		{
+			ErrorExit("Could not read the recording " + replayFile_);
+		}
+		return;
+	}
+	if (netCheck_)
+	{
+		StartNetCheck();
+		return;
+	}
+	if (dedicatedServer_)
+	{
+		// just the shared world and the network, none of the Sample window, logo or console setup
+		CreateScene();
+		SubscribeToEvents();
+		StartDedicatedServer();
+		return;
+	}
+	if (botMode_)
+	{
+		StartBot();
+		return;
+	}
+	if (botLaunchCount_ > 0)
+	{
+		StartBotLauncher();
+		return;
+	}
+
 	// Execute base class startup
 	Sample::Start();
 	if (touchEnabled_)
@@ -127,48 +517,290 @@ void CharacterDemo::Start()
 	Sample::InitMouseMode(MM_RELATIVE);
 }
 
-void CharacterDemo::CreateMainMenu()
+void CharacterDemo::StartDedicatedServer()
 {
-	menuVisible = true;
+	// headless the engine would spin as fast as it can, run the frame loop just fast enough for the tick and send rates instead
+	engine_->SetMaxFps(Max(tickRate_, sendRate_));
+	engine_->SetMaxInactiveFps(Max(tickRate_, sendRate_));
 
-	// Set the mouse mode to use in the sample
-	InitMouseMode(MM_RELATIVE);
-	ResourceCache* cache = GetSubsystem<ResourceCache>();
-	UI* ui = GetSubsystem<UI>();
-	UIElement* root = ui->GetRoot();
-	XMLFile* uiStyle = cache->GetResource<XMLFile>("UI/DefaultStyle.xml");
-	root->SetDefaultStyle(uiStyle); //need to set default ui style
-	//Create a Cursor UI element.We want to be able to hide and show the main menu at will. When hidden, the mouse will control the camera, and when visible, the mouse will be able to interact with the GUI.
-	SharedPtr<Cursor> cursor(new Cursor(context_));
-	cursor->SetStyleAuto(uiStyle);
-	ui->SetCursor(cursor);
-	// Create the Window and add it to the UI's root node
-	window_ = new Window(context_);
-	root->AddChild(window_);
-	// Set Window size and layout settings
-	window_->SetMinWidth(384);
-	window_->SetLayout(LM_VERTICAL, 6, IntRect(6, 6, 6, 6));
-	window_->SetAlignment(HA_CENTER, VA_CENTER);
-	window_->SetName("Window");
-	window_->SetStyleAuto();
+	// a shard steers its slab's share of the flock, and listens on a port of its own
+	unsigned short port = serverPort_;
+	if (shardCount_ > 1)
+	{
+		shard_.Initialise(shardIndex_, shardCount_, shardWidth_, serverPort_, *rooms_[0]);
+		port = shard_.GetPort(shard_.index);
+		SubscribeToEvent(E_SERVERCONNECTED, URHO3D_HANDLER(CharacterDemo, HandleShardLinkStatus));
+		SubscribeToEvent(E_SERVERDISCONNECTED, URHO3D_HANDLER(CharacterDemo, HandleShardLinkStatus));
+		SubscribeToEvent(E_CONNECTFAILED, URHO3D_HANDLER(CharacterDemo, HandleShardLinkStatus));
+		URHO3D_LOGINFO(shard_.GetDebugText(*rooms_[0]));
+	}
+	GetSubsystem<Network>()->StartServer(port);
 
-	Font* font = cache->GetResource<Font>("Fonts/Anonymous Pro.ttf");
+	// room 0 is scene_, the others get scenes of their own
+	for (int i = 1; i < roomCount_; i++)
+	{
+		CreateRoom(i, nullptr);
+	}
+	for (unsigned i = 0; i < rooms_.Size(); i++)
+	{
+		Room* room = rooms_[i];
+		if (lockstep_)
+		{
+			// no ships or boids in the scene, every peer runs the match from the tick messages
+			room->lockstepServer.Start(flockSeed_ + room->id, boidCount_, tickRate_);
+			URHO3D_LOGINFO("Room " + String(room->id) + " lockstep match, seed " + String(flockSeed_ + room->id) + ", "
+				+ String(room->lockstepServer.sim.positions.Size()) + " boids");
+		}
+		else
+		{
+			room->serverObjects.Initialise(GetSubsystem<ResourceCache>(), room->scene, playerSlotCount_, GetPhysicsMode());
+		}
+	}
 
-	Button* startButton = CreateButton("START", 24, window_, font);
-	Button* connectButton = CreateButton("CONNECT", 24, window_, font);
-	IPaddress = CreateLineEdit("", 24, window_, font);
-	Button* disconnectButton = CreateButton("DISCONNECT", 24, window_, font);
-	Button* startServerButton = CreateButton("START SERVER", 24, window_, font);
-	Button* startClientGameButton = CreateButton("CLIENT: START GAME", 24, window_, font);
-	Button* quitButton = CreateButton("QUIT", 24, window_, font);
+	if (record_)
+	{
+		// a file per room and run, only ever appended to
+		GetSubsystem<FileSystem>()->CreateDir(recordDir_);
+		for (unsigned i = 0; i < rooms_.Size(); i++)
+		{
+			Room* room = rooms_[i];
+			String fileName = recordDir_ + "Session" + String(port) + "Room" + String(room->id) + "-" + String(Time::GetTimeSinceEpoch()) + ".rec";
+			if (room->recorder.Open(context_, fileName, room->id, tickRate_, worldChecksum_))
+			{
+				URHO3D_LOGINFO("Recording room " + String(room->id) + " to " + fileName);
+			}
+			else
+			{
+				URHO3D_LOGERROR("Could not open " + fileName + " to record room " + String(room->id));
+			}
+		}
+	}
+	if (capture_)
+	{
+		GetSubsystem<FileSystem>()->CreateDir(captureDir_);
+		String fileName = captureDir_ + "Traffic" + String(port) + "-" + String(Time::GetTimeSinceEpoch()) + ".cap";
+		if (trafficCapture_.Open(context_, fileName, tickRate_, worldChecksum_, GetSubsystem<Time>()->GetElapsedTime()))
+		{
+			URHO3D_LOGINFO("Capturing client traffic to " + fileName);
+		}
+		else
+		{
+			URHO3D_LOGERROR("Could not open " + fileName + " to capture client traffic");
+		}
+	}
+	if (!trafficFile_.Empty() && !StartTrafficReplay(port))
+	{
+		ErrorExit("Could not read the capture " + trafficFile_);
+		return;
+	}
 
-	SubscribeToEvent(startButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleStart));
-	SubscribeToEvent(quitButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleQuit));
+	if (netThread_ && networkThread_.Run())
+	{
+		URHO3D_LOGINFO("Network thread decoding input and writing the boid stream");
+	}
+	else if (netThread_)
+	{
+		URHO3D_LOGERROR("Could not start the network thread, decoding and writing on the main thread");
+		netThread_ = false;
+	}
 
-	//Network button handlers
-	SubscribeToEvent(connectButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleConnect));
-	SubscribeToEvent(startServerButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleStartServer));
-	SubscribeToEvent(disconnectButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleDisconnect));
+	// tick time against the budget, to find how many players a server can take
+	SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(CharacterDemo, HandleServerBeginFrame));
+	SubscribeToEvent(E_POSTRENDERUPDATE, URHO3D_HANDLER(CharacterDemo, HandleServerEndFrame));
+
+	URHO3D_LOGINFO("Dedicated server on port " + String(port) + " with " + String(rooms_.Size()) + " rooms of " + String(rooms_[0]->boidNodes.Size())
+		+ " boids at " + String(tickRate_) + " Hz, sending at " + String(sendRate_) + " Hz");
+}
+
+void CharacterDemo::StartBot()
+{
+	// the server replicates the whole world, the bot only needs an empty scene to receive it into
+	scene_ = new Scene(context_);
+
+	botDriver_.Initialise(botID_, BotPatternFromName(botPattern_));
+	if (!botStats_.Open(context_, statsDir_, botID_))
+	{
+		URHO3D_LOGERROR("Could not open bot stats in " + statsDir_);
+	}
+
+	SubscribeToEvents();
+	SubscribeToEvent(E_SERVERCONNECTED, URHO3D_HANDLER(CharacterDemo, HandleBotConnectionStatus));
+	SubscribeToEvent(E_SERVERDISCONNECTED, URHO3D_HANDLER(CharacterDemo, HandleBotConnectionStatus));
+	SubscribeToEvent(E_CONNECTFAILED, URHO3D_HANDLER(CharacterDemo, HandleBotConnectionStatus));
+
+	// a bot sends input at the rate a player would, it does not need to go any faster
+	engine_->SetMaxFps(60);
+	engine_->SetMaxInactiveFps(60);
+
+	botStats_.OnConnectStart(GetSubsystem<Time>()->GetElapsedTime());
+	joinTimer_.Start(GetSubsystem<Time>()->GetElapsedTime());
+	VariantMap identity;
+	identity["RoomID"] = roomID_;
+	serverAddress_ = botAddress_;
+	GetSubsystem<Network>()->Connect(botAddress_, serverPort_, scene_, identity);
+}
+
+void CharacterDemo::StartBotLauncher()
+{
+	if (!botLauncher_.Initialise(context_, statsDir_, GetProgramFileName()))
+	{
+		engine_->Exit();
+		return;
+	}
+
+	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(CharacterDemo, HandleLauncherUpdate));
+	engine_->SetMaxFps(20);
+	engine_->SetMaxInactiveFps(20);
+
+	URHO3D_LOGINFO("Launching " + String(botLaunchCount_) + " bots against " + botAddress_ + ":" + String(serverPort_) + ", stats in " + statsDir_);
+}
+
+void CharacterDemo::StartNetCheck()
+{
+	// the servers simulate what this process would have
+	Vector<String> serverArguments;
+	serverArguments.Push("--boids");
+	serverArguments.Push(String(boidCount_));
+	serverArguments.Push("--tickrate");
+	serverArguments.Push(String(tickRate_));
+	serverArguments.Push("--sendrate");
+	serverArguments.Push(String(sendRate_));
+	if (!impairmentSuite_.Initialise(context_, statsDir_ + "netcheck/", GetProgramFileName(), serverPort_, netCheckBots_, netCheckTime_,
+		serverArguments, netCheckProfile_))
+	{
+		ErrorExit("Could not start the network check");
+		return;
+	}
+
+	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(CharacterDemo, HandleNetCheckUpdate));
+	engine_->SetMaxFps(20);
+	engine_->SetMaxInactiveFps(20);
+
+	URHO3D_LOGINFO("Network check with " + String(netCheckBots_) + " bots for " + String(netCheckTime_) + " s per profile, stats in "
+		+ statsDir_ + "netcheck/");
+}
+
+bool CharacterDemo::StartTrafficReplay(unsigned short port)
+{
+	if (!trafficReplay_.Open(trafficFile_))
+	{
+		return false;
+	}
+	URHO3D_LOGINFO("Replaying " + trafficFile_ + ": " + trafficReplay_.GetInfo());
+	if (trafficReplay_.tickRate != tickRate_)
+	{
+		URHO3D_LOGWARNING("The capture was taken at " + String(trafficReplay_.tickRate) + " Hz, this server ticks at " + String(tickRate_));
+	}
+	if (trafficReplay_.worldChecksum != worldChecksum_)
+	{
+		URHO3D_LOGWARNING("The capture was taken on another world file, its clients' view ticks and positions will not line up");
+	}
+
+	sceneChecksums_.Clear();
+	for (unsigned i = 0; i < rooms_.Size(); i++)
+	{
+		sceneChecksums_.Push(rooms_[i]->scene->GetChecksum());
+	}
+	if (!trafficReplay_.Start(port, trafficCopies_))
+	{
+		URHO3D_LOGERROR("The capture has no clients");
+		return false;
+	}
+
+	// every frame is one tick, so the frame limiter sets the speed and without it the server runs flat out
+	int fps = trafficSpeed_ > 0.0f ? Max((int)(tickRate_ * trafficSpeed_), 1) : 0;
+	engine_->SetMaxFps(fps);
+	engine_->SetMaxInactiveFps(fps);
+	SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(CharacterDemo, HandleTrafficReplayEndFrame));
+	trafficReplayStart_ = GetSubsystem<Time>()->GetElapsedTime();
+	return true;
+}
+
+bool CharacterDemo::RunReplay()
+{
+	SessionReplay replay;
+	if (!replay.Open(replayFile_))
+	{
+		return false;
+	}
+	URHO3D_LOGINFO("Replaying " + replayFile_ + ": " + replay.GetInfo());
+
+	SharedPtr<File> csv;
+	if (!replayCsv_.Empty())
+	{
+		csv = new File(context_, replayCsv_, FILE_WRITE);
+		if (!csv->IsOpen())
+		{
+			URHO3D_LOGERROR("Could not open " + replayCsv_);
+			csv.Reset();
+		}
+	}
+
+	replay.Run(replayFrom_, replayTo_, csv);
+	URHO3D_LOGINFO("Replayed " + replay.GetDebugText());
+	return true;
+}
+
+String CharacterDemo::GetProgramFileName() const
+{
+	// bots are this same executable started with --bot
+	String name = "UrhoBoids";
+#ifndef NDEBUG
+	name += "_d";
+#endif
+#ifdef _WIN32
+	name += ".exe";
+#endif
+	return GetSubsystem<FileSystem>()->GetProgramDir() + name;
+}
+
+Connection* CharacterDemo::GetGameServerConnection() const
+{
+	return dedicatedServer_ ? nullptr : GetSubsystem<Network>()->GetServerConnection();
+}
+
+void CharacterDemo::CreateMainMenu()
+{
+	menuVisible = true;
+
+	// Set the mouse mode to use in the sample
+	InitMouseMode(MM_RELATIVE);
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	UI* ui = GetSubsystem<UI>();
+	UIElement* root = ui->GetRoot();
+	XMLFile* uiStyle = cache->GetResource<XMLFile>("UI/DefaultStyle.xml");
+	root->SetDefaultStyle(uiStyle); //need to set default ui style
+	//Create a Cursor UI element.We want to be able to hide and show the main menu at will. When hidden, the mouse will control the camera, and when visible, the mouse will be able to interact with the GUI.
+	SharedPtr<Cursor> cursor(new Cursor(context_));
+	cursor->SetStyleAuto(uiStyle);
+	ui->SetCursor(cursor);
+	// Create the Window and add it to the UI's root node
+	window_ = new Window(context_);
+	root->AddChild(window_);
+	// Set Window size and layout settings
+	window_->SetMinWidth(384);
+	window_->SetLayout(LM_VERTICAL, 6, IntRect(6, 6, 6, 6));
+	window_->SetAlignment(HA_CENTER, VA_CENTER);
+	window_->SetName("Window");
+	window_->SetStyleAuto();
+
+	Font* font = cache->GetResource<Font>("Fonts/Anonymous Pro.ttf");
+
+	Button* startButton = CreateButton("START", 24, window_, font);
+	Button* connectButton = CreateButton("CONNECT", 24, window_, font);
+	IPaddress = CreateLineEdit("", 24, window_, font);
+	Button* disconnectButton = CreateButton("DISCONNECT", 24, window_, font);
+	Button* startServerButton = CreateButton("START SERVER", 24, window_, font);
+	Button* startClientGameButton = CreateButton("CLIENT: START GAME", 24, window_, font);
+	Button* quitButton = CreateButton("QUIT", 24, window_, font);
+
+	SubscribeToEvent(startButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleStart));
+	SubscribeToEvent(quitButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleQuit));
+
+	//Network button handlers
+	SubscribeToEvent(connectButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleConnect));
+	SubscribeToEvent(startServerButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleStartServer));
+	SubscribeToEvent(disconnectButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleDisconnect));
 	SubscribeToEvent(startClientGameButton, E_RELEASED, URHO3D_HANDLER(CharacterDemo, HandleClientStartGame));
 }
 
@@ -198,618 +830,2244 @@ void CharacterDemo::CreateScoreUI()
 	healthText = CreateLineEdit("Health:  " + String(player.health), 24, windowScore_, font);
 }
 
-void CharacterDemo::CreateScene()
+void CharacterDemo::CreateScene()
+{
+	// -------------------- SCENE -------------------
+		//so we can access resources
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	scene_ = new Scene(context_);
+	// Create scene subsystem components
+	scene_->CreateComponent<Octree>();
+	PhysicsWorld* physicsWorld = scene_->CreateComponent<PhysicsWorld>();
+	physicsWorld->SetFps(tickRate_);
+	physicsWorld->SetMaxSubSteps(simClock_.maxSteps);
+
+	if (!dedicatedServer_)
+	{
+		//debug shape render
+		scene_->CreateComponent<DebugRenderer>();
+
+		// -------------------- CAMERA -------------------
+		{
+			//Create camera node and component
+			cameraNode_ = new Node(context_);
+			Camera* camera = cameraNode_->CreateComponent<Camera>();
+			cameraNode_->SetPosition(Vector3(0.0f, 5.0f, 0.0f));
+			camera->SetFarClip(300.0f);
+
+			GetSubsystem<Renderer>()->SetViewport(0, new Viewport(context_, scene_, camera));
+		}
+	}
+
+	// -------------------- WORLD -------------------
+	{
+		// skybox, fog, light and terrain come from a scene file every peer has, so none of it is replicated
+		worldChecksum_ = LoadWorld(cache, scene_);
+	}
+
+	// a dedicated server has no local seat, every player belongs to a client
+	if (!dedicatedServer_)
+	{
+		player.initialise(cache, scene_, cameraNode_, GetPhysicsMode());
+
+		// effects only where there is a window to show them
+		effects_.Initialise(cache, scene_, 16);
+		effects_.AttachEngine(player.pNode);
+	}
+
+	// the local match, with the flock
+	CreateRoom(0, scene_);
+
+	// create UI
+	if (!dedicatedServer_)
+	{
+		CreateMainMenu();
+	}
+}
+
+void CharacterDemo::SubscribeToEvents()
+{
+	// Subscribe to Update event for setting the character controls, a bot scripts its own
+	if (botMode_)
+	{
+		SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(CharacterDemo, HandleBotUpdate));
+	}
+	else
+	{
+		SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(CharacterDemo, HandleUpdate));
+	}
+
+	// server: what happens when a client is connected, and the room its identity asks for
+	SubscribeToEvent(E_CLIENTCONNECTED, URHO3D_HANDLER(CharacterDemo, HandleClientConnected));
+	SubscribeToEvent(E_CLIENTIDENTITY, URHO3D_HANDLER(CharacterDemo, HandleClientIdentity));
+	SubscribeToEvent(E_CLIENTDISCONNECTED, URHO3D_HANDLER(CharacterDemo, HandleClientDisconnected));
+
+	// Setting or applying controls
+	SubscribeToEvent(E_PHYSICSPRESTEP, URHO3D_HANDLER(CharacterDemo, HandlePhysicsPreStep));
+
+	//Server: This is called when a client has connected to a Server
+	SubscribeToEvent(E_CLIENTSCENELOADED, URHO3D_HANDLER(CharacterDemo, HandleClientFinishedLoading));
+
+	// SubscribeToEvent(E_CLIENTCUSTOMEVENT, URHO3D_HANDLER(CharacterDemo, HandleCustomEvent));
+	// GetSubsystem<Network>()->RegisterRemoteEvent(E_CLIENTCUSTOMEVENT);
+
+	// client ready and object authority travel as bit packed game messages, see HandleNetworkMessage
+
+	// client side interpolation of replicated nodes, bots use it to count snapshots
+	SubscribeToEvent(E_NODENAMECHANGED, URHO3D_HANDLER(CharacterDemo, HandleNodeNameChanged));
+	SubscribeToEvent(E_NODEREMOVED, URHO3D_HANDLER(CharacterDemo, HandleNodeRemoved));
+	SubscribeToEvent(E_INTERCEPTNETWORKUPDATE, URHO3D_HANDLER(CharacterDemo, HandleInterceptNetworkUpdate));
+
+	// client: build the world and receive the flock when joining
+	SubscribeToEvent(E_NETWORKSCENELOADED, URHO3D_HANDLER(CharacterDemo, HandleNetworkSceneLoaded));
+
+	// client input frames, sent as a custom message instead of the per update controls
+	SubscribeToEvent(E_NETWORKMESSAGE, URHO3D_HANDLER(CharacterDemo, HandleNetworkMessage));
+
+	// per connection traffic counters, server and client alike
+	SubscribeToEvent(E_NETWORKUPDATE, URHO3D_HANDLER(CharacterDemo, HandleNetworkUpdate));
+
+	// everything below drives the window, the menu or the local player
+	if (IsHeadless())
+	{
+		return;
+	}
+
+	SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(CharacterDemo, HandlePostUpdate));
+	SubscribeToEvent(E_POSTRENDERUPDATE, URHO3D_HANDLER(CharacterDemo, HandlePostRender));
+
+	// client: the server going away mid game
+	SubscribeToEvent(E_SERVERDISCONNECTED, URHO3D_HANDLER(CharacterDemo, HandleServerConnectionStatus));
+	SubscribeToEvent(E_CONNECTFAILED, URHO3D_HANDLER(CharacterDemo, HandleServerConnectionStatus));
+
+	// node collision
+	SubscribeToEvent(player.pNode, E_NODECOLLISION, URHO3D_HANDLER(CharacterDemo, HandlePlayerCollision));
+	SubscribeToEvent(player.playerMissile.pNode, E_NODECOLLISION, URHO3D_HANDLER(CharacterDemo, HandleMissileCollision));
+}
+
+void CharacterDemo::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+	// Take the frame time step, which is stored as a float
+	float timeStep = eventData[P_TIMESTEP].GetFloat();
+
+	effects_.Update(timeStep);
+
+	// Client: our ship has moved to another shard, or the server dropped us and we are getting it back
+	if (redirectPort_ != 0)
+	{
+		FollowRedirect();
+	}
+	UpdateResume(GetSubsystem<Time>()->GetElapsedTime());
+
+	// Client: play remote nodes back from the interpolation buffer, menu or not
+	if (GetGameServerConnection())
+	{
+		interpolator_.Update(timeStep, scene_);
+		boidInterpolator_.Update(timeStep, scene_);
+
+		// keep the server clock estimate fresh
+		clockSync_.Update(timeStep);
+		VectorBuffer ping;
+		Connection* serverConnection = GetGameServerConnection();
+		if (clockSync_.WritePing(timeStep, GetSubsystem<Time>()->GetElapsedTime(), ping))
+		{
+			serverConnection->SendMessage(MSG_CLOCKPING, false, false, ping);
+			networkStats_.RecordMessage(serverConnection, TRAFFIC_CUSTOM, ClockPingMessage::GetName(), ping.GetSize(), true);
+		}
+
+		// a lockstep match is shown from the client's own copy, our ship is the one in our slot
+		if (lockstepClient_.active)
+		{
+			lockstepView_.Apply(lockstepClient_.sim);
+			Node* ship = lockstepView_.GetShip(lockstepClient_.slot);
+			clientObjectID_ = ship ? ship->GetID() : 0;
+		}
+
+		// the first frame with the whole world in it
+		if (joinTimer_.OnFrame(GetSubsystem<Time>()->GetElapsedTime(), boidReader_.ready || lockstepClient_.active))
+		{
+			PODVector<RigidBody*> bodies;
+			scene_->GetComponents<RigidBody>(bodies, true);
+			URHO3D_LOGINFO("Joined: " + joinTimer_.GetDebugText() + ", bootstrap " + String(boidReader_.bootstrapBytes) + " bytes ("
+				+ String(boidReader_.bootstrapRawBytes) + " uncompressed), " + String(bodies.Size()) + " rigid bodies in the scene");
+		}
+
+		DebugHud* debugHud = GetSubsystem<DebugHud>();
+		if (debugHud)
+		{
+			debugHud->SetAppStats("Interpolation", interpolator_.GetDebugText());
+			debugHud->SetAppStats("Boid interpolation", boidInterpolator_.GetDebugText());
+			debugHud->SetAppStats("Join", joinTimer_.GetDebugText());
+			debugHud->SetAppStats("Clock", clockSync_.GetDebugText());
+			debugHud->SetAppStats("Lockstep", lockstepClient_.GetDebugText());
+		}
+	}
+
+	// Dedicated server: no local seat, just the flock
+	if (dedicatedServer_)
+	{
+		int steps = simClock_.Advance(timeStep);
+		for (int i = 0; i < steps; i++)
+		{
+			UpdateFlocks(simClock_.step);
+		}
+		return;
+	}
+
+	if ((GetSubsystem<Network>()->IsServerRunning() || singlePlayer) && !menuVisible)
+	{
+		// Do not move if the UI has a focused element (the console)
+		if (GetSubsystem<UI>()->GetFocusElement()) return;
+		Input* input = GetSubsystem<Input>();
+
+		// Use this frame's mouse motion to adjust camera node yaw and pitch.
+		// Clamp the pitch between -90 and 90 degrees
+		IntVector2 mouseMove = input->GetMouseMove();
+		yaw_ += MOUSE_SENSITIVITY * mouseMove.x_;
+		pitch_ += MOUSE_SENSITIVITY * mouseMove.y_;
+		pitch_ = Clamp(pitch_, -90.0f, 90.0f);
+
+		if (input->GetKeyPress(KEY_M))
+		{
+			menuVisible = !menuVisible;
+		}
+
+		// rotating the player, the steps below move it along where it now faces
+		player.pNode->SetRotation(Quaternion(pitch_, yaw_, 0.0f));
+
+		// gameplay and flocking advance in fixed steps, however long the frame took
+		int steps = simClock_.Advance(timeStep);
+		for (int i = 0; i < steps; i++)
+		{
+			SimulateLocalStep(simClock_.step);
+		}
+
+		DebugHud* debugHud = GetSubsystem<DebugHud>();
+		if (debugHud)
+		{
+			debugHud->SetAppStats("Simulation", simClock_.GetDebugText());
+		}
+
+		// making camera follow and rotate around the player
+		cameraNode_->SetPosition(player.pNode->GetPosition() + Vector3(0.0f, 2.0f, -10.0f));
+		cameraNode_->SetRotation(Quaternion(0.0f, 0.0f, 0.0f));
+		cameraNode_->RotateAround(player.pNode->GetPosition(), player.pNode->GetRotation(), TS_WORLD);
+
+		// go back to menu if health reaches 0 
+		if (player.health < 0)
+		{
+			// engine_->Exit();
+			menuVisible = true;
+		}
+
+		// exit game if timer reacher 0
+		if (timer == 0)
+		{
+			// engine_->Exit();
+			menuVisible = !menuVisible;
+		}
+
+		// update the timer text
+		timerText->SetText("Timer: " + String(timer));
+	}
+	else if (!menuVisible) // runs the update if it is a client and not on the menu
+	{ 
+		Input* input = GetSubsystem<Input>();
+
+		// Mouse sensitivity as degrees per pixel
+		const float MOUSE_SENSITIVITY = 0.1f;
+
+		// Use this frame's mouse motion to adjust camera node yaw and pitch.
+		// Clamp the pitch between -90 and 90 degrees
+		IntVector2 mouseMove = input->GetMouseMove();
+		yaw_ += MOUSE_SENSITIVITY * mouseMove.x_;
+		pitch_ += MOUSE_SENSITIVITY * mouseMove.y_;
+		pitch_ = Clamp(pitch_, -90.0f, 90.0f);
+		
+		// Only move the camera if we have a controllable object
+		if (clientObjectID_)
+		{
+			Node* ClientPlayerNode = this->scene_->GetNode(clientObjectID_);
+			if (ClientPlayerNode)
+			{
+				// making camera follow and rotate around the client player
+				cameraNode_->SetPosition(ClientPlayerNode->GetPosition() + Vector3(0.0f, 2.0f, -10.0f));
+				cameraNode_->SetRotation(Quaternion(0.0f, 0.0f, 0.0f));
+				cameraNode_->RotateAround(ClientPlayerNode->GetPosition(), ClientPlayerNode->GetRotation(), TS_WORLD);
+
+				// -------------------- KEY CLIENT INPUT -------------------
+				{
+					if (input->GetKeyPress(KEY_M))
+					{
+						menuVisible = !menuVisible;
+					}
+				}
+			}
+		}
+	}
+}
+
+void CharacterDemo::SimulateLocalStep(float timeStep)
+{
+	Input* input = GetSubsystem<Input>();
+
+	// -------------------- KEY INPUT -------------------
+	{
+		// Read WASD keys and move the player node to the corresponding direction if they are pressed, use the Translate() functio(default local space) to move relative to the node's orientation.
+		if (input->GetKeyDown(KEY_W))
+		{
+			player.pNode->Translate(Vector3::FORWARD * MOVE_SPEED * timeStep);
+		}
+
+		if (input->GetKeyDown(KEY_S))
+		{
+			player.pNode->Translate(Vector3::BACK * MOVE_SPEED * timeStep);
+		}
+
+		if (input->GetKeyDown(KEY_A))
+		{
+			player.pNode->Translate(Vector3::LEFT * MOVE_SPEED * timeStep);
+		}
+
+		if (input->GetKeyDown(KEY_D))
+		{
+			player.pNode->Translate(Vector3::RIGHT * MOVE_SPEED * timeStep);
+		}
+
+		if (input->GetKeyDown(KEY_F))
+		{
+			if (player.playerMissile.active == false)
+			{
+				// shoot missile if not active already
+				player.playerMissile.active = true;
+				player.shoot(cameraNode_);
+			}
+		}
+	}
+
+	UpdateFlocks(timeStep);
+
+	player.update(cameraNode_);
+
+	// decriment timer every 70 steps
+	timerIndex++;
+	if (timerIndex % 70 == 0 && menuVisible == false)
+	{
+		timer--;
+	}
+}
+
+static void EncodeRoomTask(void* owner, void* data)
+{
+	EncodeJob* job = static_cast<EncodeJob*>(data);
+	job->room->CaptureBoids(job->positions, job->velocities);
+	job->Write();
+}
+
+static void FlockSliceTask(void* owner, void* data)
+{
+	FlockSlice* slice = static_cast<FlockSlice*>(data);
+	slice->room->ComputeFlock(slice->first, slice->last);
+}
+
+void CharacterDemo::SendRoomTask(void* owner, void* data)
+{
+	static_cast<CharacterDemo*>(owner)->DeliverJob(*static_cast<EncodeJob*>(data));
+}
+
+void CharacterDemo::RoomStatsTask(void* owner, void* data)
+{
+	static_cast<CharacterDemo*>(owner)->ShowRoomStats(*static_cast<Room*>(data));
+}
+
+void CharacterDemo::RunFrameGraph()
+{
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+	bool server = GetSubsystem<Network>()->IsServerRunning();
+	unsigned slicesPerRoom = queue->GetNumThreads() + 1;
+	// sized before any task points into it
+	flockSlices_.Resize(rooms_.Size() * slicesPerRoom);
+
+	frameGraph_.Clear();
+	for (unsigned i = 0; i < rooms_.Size(); i++)
+	{
+		Room* room = rooms_[i];
+		String id(room->id);
+
+		// this tick's boid updates: the flock captured and each due feed's update written on a worker, then sent
+		int send = -1;
+		if (room->sendDue)
+		{
+			room->sendDue = false;
+			if (room->PrepareEncode())
+			{
+				unsigned encode = frameGraph_.Add("encode r" + id, EncodeRoomTask, nullptr, &room->encodeJob);
+				send = frameGraph_.Add("send r" + id, SendRoomTask, this, &room->encodeJob, true);
+				frameGraph_.DependsOn(send, encode);
+			}
+		}
+		if (server && GetSubsystem<DebugHud>())
+		{
+			unsigned stats = frameGraph_.Add("hud r" + id, RoomStatsTask, this, room, true);
+			if (send >= 0)
+			{
+				frameGraph_.DependsOn(stats, send);
+			}
+		}
+
+		// the next tick's steering from where this frame's physics left the flock, the next step only applies it
+		if (!room->forcesReady && !room->flock.Empty())
+		{
+			room->BeginFlockStep();
+			unsigned due = room->GetDueCount();
+			unsigned slices = Min(slicesPerRoom, due);
+			for (unsigned j = 0; j < slices; j++)
+			{
+				FlockSlice& slice = flockSlices_[i * slicesPerRoom + j];
+				slice.room = room;
+				slice.first = due * j / slices;
+				slice.last = due * (j + 1) / slices;
+				frameGraph_.Add("flock r" + id + "." + String(j), FlockSliceTask, nullptr, &slice);
+			}
+			room->forcesReady = true;
+		}
+	}
+	frameGraph_.Run(queue);
+}
+
+void CharacterDemo::UpdateFlocks(float timeStep)
+{
+	// the steering of every due boid set in every room at once, spread over the worker threads; the first step of a
+	// frame usually finds it computed already, by the last frame's graph
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+	for (unsigned i = 0; i < rooms_.Size(); i++)
+	{
+		if (!rooms_[i]->forcesReady)
+		{
+			rooms_[i]->QueueFlock(queue);
+		}
+	}
+	queue->Complete(M_MAX_UNSIGNED);
+
+	// Bullet is not thread safe, the forces go in from here
+	for (unsigned i = 0; i < rooms_.Size(); i++)
+	{
+		rooms_[i]->ApplyFlock(timeStep);
+	}
+}
+
+Room* CharacterDemo::CreateRoom(unsigned id, Scene* scene)
+{
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	if (!scene)
+	{
+		// physics at the tick rate and the shared world, nothing here is rendered
+		scene = new Scene(context_);
+		scene->CreateComponent<Octree>();
+		PhysicsWorld* physicsWorld = scene->CreateComponent<PhysicsWorld>();
+		physicsWorld->SetFps(tickRate_);
+		physicsWorld->SetMaxSubSteps(simClock_.maxSteps);
+		LoadWorld(cache, scene);
+	}
+
+	SharedPtr<Room> room(new Room(id, scene));
+
+	// players get every boid update while their link keeps up, each slower tier half as often with coarser dead
+	// reckoning, observers every few
+	for (int i = 0; i < RATE_TIERS; i++)
+	{
+		room->playerFeeds[i].name = "players tier " + String(i);
+		room->playerFeeds[i].interval = 1 << i;
+		room->playerFeeds[i].writer.maxError = deadReckonError_ * (1 << i);
+		room->playerFeeds[i].writer.maxSilence = deadReckonSilence_ * (1 + i);
+	}
+	room->observerFeed.name = "observers";
+	room->observerFeed.interval = Max(sendRate_ / observerRate_, 1);
+	room->observerFeed.writer.maxError = deadReckonError_;
+	room->observerFeed.writer.maxSilence = deadReckonSilence_;
+	room->resumes.grace = resumeGrace_;
+
+	// none on a lockstep server, its flock is in the LockstepSim
+	if (!lockstep_)
+	{
+		room->CreateFlock(cache, boidCount_, flockSeed_ + id);
+	}
+
+	rooms_.Push(room);
+	return room;
+}
+
+Room* CharacterDemo::GetRoom(Connection* connection) const
+{
+	HashMap<Connection*, Room*>::ConstIterator i = connectionRooms_.Find(connection);
+	return i != connectionRooms_.End() ? i->second_ : nullptr;
+}
+
+Room* CharacterDemo::GetRoom(Scene* scene) const
+{
+	for (unsigned i = 0; i < rooms_.Size(); i++)
+	{
+		if (rooms_[i]->scene.Get() == scene)
+		{
+			return rooms_[i];
+		}
+	}
+	return nullptr;
+}
+
+void CharacterDemo::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+	// menu visible & invisible
+	UI* ui = GetSubsystem<UI>();
+	Input* input = GetSubsystem<Input>();
+	ui->GetCursor()->SetVisible(menuVisible);
+	window_->SetVisible(menuVisible);
+}
+
+void CharacterDemo::HandlePostRender(StringHash eventType, VariantMap & eventData)
+{
+	RunFrameGraph();
+	DebugHud* debugHud = GetSubsystem<DebugHud>();
+	if (frameGraph_.Report(GetSubsystem<Time>()->GetElapsedTime()) && debugHud)
+	{
+		debugHud->SetAppStats("Frame graph", frameGraph_.GetDebugText());
+	}
+
+	// Drawing collision boxes around objects
+	//scene_->GetComponent<PhysicsWorld>()->DrawDebugGeometry(true);
+}
+
+void CharacterDemo::HandlePlayerCollision(StringHash eventType, VariantMap & eventData)
+{
+	using namespace NodeCollision;
+
+	// decrease health if player player collides with boids
+	Node* collidedNode = static_cast<Node*>(eventData[P_OTHERNODE].GetPtr());
+	
+	if (collidedNode->GetName() == "boid")
+	{
+		if (!menuVisible)
+		{
+			// engine_->Exit();
+			printf("Player collided with Boid!! \n");
+			player.health = player.health - 20;
+			healthText->SetText("Health: " + String(player.health));
+		}
+	}
+}
+
+void CharacterDemo::HandleMissileCollision(StringHash eventType, VariantMap & eventData)
+{
+	using namespace NodeCollision;
+
+	// increase score if missile collides with boids
+	Node* collidedNode = static_cast<Node*>(eventData[P_OTHERNODE].GetPtr());
+	if (collidedNode->GetName() == "boid")
+	{
+		if (!menuVisible)
+		{
+			player.score++;
+			player.playerMissile.active = false;
+			scoreText->SetText("Score: " + String(player.score));
+
+			// emitt particle effect when boid has been hit
+			SendEffect(*rooms_[0], EFFECT_BURST, collidedNode->GetWorldPosition());
+		}
+	}
+}
+
+void CharacterDemo::HandleClientPlayerCollision(StringHash eventType, VariantMap & eventData)
+{
+	using namespace NodeCollision;
+
+	// decrease health if player player collides with boids
+	Node* collidedNode = static_cast<Node*>(eventData[P_OTHERNODE].GetPtr());
+
+	if (collidedNode->GetName() == "boid")
+	{
+		if (!menuVisible)
+		{
+			// engine_->Exit();
+			printf("Player collided with Boid!! \n");
+		}
+	}
+}
+
+Button * CharacterDemo::CreateButton(const String & text, int pHeight, Urho3D::Window * whichWindow, Font * font)
+{
+	Button* button = whichWindow->CreateChild<Button>();
+	button->SetMinHeight(pHeight);
+	button->SetStyleAuto();
+	Text* buttonText = button->CreateChild<Text>();
+	buttonText->SetFont(font, 12);
+	buttonText->SetAlignment(HA_CENTER, VA_CENTER);
+	buttonText->SetText(text);
+	whichWindow->AddChild(button);
+
+	return button;
+}
+
+LineEdit * CharacterDemo::CreateLineEdit(const String & text, int pHeight, Urho3D::Window * whichWindow, Font * font)
+{
+	LineEdit* lineEdit = whichWindow->CreateChild<LineEdit>();
+	lineEdit->SetMinHeight(pHeight);
+	lineEdit->SetAlignment(HA_CENTER, VA_CENTER);
+	lineEdit->SetText(text);
+	whichWindow->AddChild(lineEdit);
+	lineEdit->SetStyleAuto();
+
+	return lineEdit;
+}
+
+void CharacterDemo::HandleStart(StringHash eventType, VariantMap & eventData)
+{
+	if (menuVisible)
+	{
+		menuVisible = false;
+	}
+
+	CreateScoreUI();
+
+	singlePlayer = true;
+
+	// resetting score and timer
+	timer = 100;
+	player.score = 0;
+	player.health = 100;
+}
+
+void CharacterDemo::HandleQuit(StringHash eventType, VariantMap & eventData)
+{
+	engine_->Exit();
+}
+
+void CharacterDemo::HandleConnect(StringHash eventType, VariantMap & eventData)
+{
+	// CreateScene();
+
+	Network* network = GetSubsystem<Network>();
+	String address = IPaddress->GetText().Trimmed();
+	if (address.Empty()) { address = "localhost"; }
+	//Specify scene to use as a client for replication, and the room to join
+	joinTimer_.Start(GetSubsystem<Time>()->GetElapsedTime());
+	VariantMap identity;
+	identity["RoomID"] = roomID_;
+	serverAddress_ = address;
+	network->Connect(address, serverPort_, scene_, identity);
+}
+
+void CharacterDemo::HandleStartServer(StringHash eventType, VariantMap & eventData)
+{
+	Log::WriteRaw("(HandleStartServer called) Server is started!");
+	Network* network = GetSubsystem<Network>();
+	network->StartServer(serverPort_);
+	rooms_[0]->serverObjects.Initialise(GetSubsystem<ResourceCache>(), scene_, playerSlotCount_, GetPhysicsMode());
+	// code to make your main menu disappear. Boolean value
+	menuVisible = !menuVisible;
+	CreateScoreUI();
+
+	// resetting score and timer
+	timer = 100;
+	player.score = 0;
+	player.health = 100;
+}
+
+void CharacterDemo::HandleDisconnect(StringHash eventType, VariantMap & eventData)
+{
+	Log::WriteRaw("HandleDisconnect has been pressed. \n");
+	Network* network = GetSubsystem<Network>();
+	Connection* serverConnection = GetGameServerConnection();
+	// Running as Client, or between attempts to resume, a disconnect is meant so the ship is not asked back
+	if (serverConnection || resuming_)
+	{
+		if (serverConnection)
+		{
+			serverConnection->Disconnect();
+		}
+		resumeToken_ = 0;
+		resuming_ = false;
+		scene_->Clear(true, false);
+		clientObjectID_ = 0;
+		interpolator_.Reset();
+		inputSender_.Reset();
+		boidReader_.Clear();
+		boidInterpolator_.Reset();
+		clockSync_.Reset();
+		lockstepClient_.Reset();
+		lockstepView_.Clear();
+	}
+	// Running as a server, stop it
+	else if (network->IsServerRunning())
+	{
+		network->StopServer();
+		scene_->Clear(true, false);
+		for (unsigned i = 0; i < rooms_.Size(); i++)
+		{
+			rooms_[i]->ClearConnections();
+		}
+		connectionRooms_.Clear();
+		connectionSerials_.Clear();
+	}
+}
+
+void CharacterDemo::HandleClientConnected(StringHash eventType, VariantMap & eventData)
+{
+	using namespace ClientConnected;
+	Log::WriteRaw("(HandleClientConnected) A client has connected!");
+	// the scene comes with the client's identity, which names its room
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	connectionSerials_[connection] = ++nextConnectionSerial_;
+}
+
+void CharacterDemo::HandleClientIdentity(StringHash eventType, VariantMap & eventData)
+{
+	using namespace ClientIdentity;
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	const VariantMap& identity = connection->GetIdentity();
+
+	// the shard on our left linking up, it trades boids and players with us and gets no scene. Only a process on
+	// this host that knows --shard-key gets to, the rest of the identity is public
+	VariantMap::ConstIterator shardID = identity.Find("ShardID");
+	if (shardID != identity.End())
+	{
+		VariantMap::ConstIterator key = identity.Find("ShardKey");
+		String address = connection->GetAddress();
+		if (!shard_.IsEnabled() || (address != "127.0.0.1" && address != "::1") || key == identity.End()
+			|| !SecretsMatch(key->second_.GetString(), shardKey_))
+		{
+			URHO3D_LOGERROR("Turned away a shard link from " + connection->ToString() + ", it is not local or its --shard-key differs");
+			eventData[P_ALLOW] = false;
+			return;
+		}
+		if (shard_.links[SHARD_LEFT])
+		{
+			URHO3D_LOGERROR("Turned away a shard link from " + connection->ToString() + ", the left one is already up");
+			eventData[P_ALLOW] = false;
+			return;
+		}
+		VariantMap::ConstIterator seed = identity.Find("FlockSeed");
+		VariantMap::ConstIterator sets = identity.Find("BoidSets");
+		if (shardID->second_.GetInt() != shard_.GetNeighbour(SHARD_LEFT) || seed == identity.End()
+			|| seed->second_.GetUInt() != flockSeed_ || sets == identity.End() || sets->second_.GetUInt() != rooms_[0]->flock.Size())
+		{
+			URHO3D_LOGERROR("Turned away a shard link from " + connection->ToString() + ", it is not our left neighbour or its --seed or --boids differ");
+			eventData[P_ALLOW] = false;
+			return;
+		}
+		shard_.SetLink(SHARD_LEFT, connection);
+		URHO3D_LOGINFO("Shard link from the left, " + connection->ToString());
+		return;
+	}
+
+	VariantMap::ConstIterator roomID = identity.Find("RoomID");
+	unsigned id = roomID != identity.End() ? roomID->second_.GetUInt() : 0;
+	if (id >= rooms_.Size())
+	{
+		URHO3D_LOGWARNING(connection->ToString() + " asked for room " + String(id) + ", there are " + String(rooms_.Size()));
+		eventData[P_ALLOW] = false;
+		return;
+	}
+
+	// assign to the room's scene, replication only ever sends it that one
+	Room* room = rooms_[id];
+	connectionRooms_[connection] = room;
+	room->connections.Insert(connection);
+	connection->SetScene(room->scene);
+	room->serverObjects.OnConnected(connection, GetSubsystem<Time>()->GetElapsedTime());
+	trafficCapture_.RecordConnect(connection, GetSubsystem<Time>()->GetElapsedTime(), identity);
+}
+
+void CharacterDemo::HandleClientDisconnected(StringHash eventType, VariantMap & eventData)
+{
+	using namespace ClientDisconnected;
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	// input still queued on the network thread for it is dropped when it comes back
+	connectionSerials_.Erase(connection);
+	if (shard_.GetLinkSide(connection) >= 0)
+	{
+		shard_.RemoveLink(connection, *rooms_[0]);
+	}
+	bool redirected = shard_.redirected.Erase(connection);
+	Room* room = GetRoom(connection);
+	if (!room)
+	{
+		return;
+	}
+	connectionRooms_.Erase(connection);
+	room->recorder.RecordLeave(connection, room->serverTick);
+	trafficCapture_.RecordDisconnect(connection, GetSubsystem<Time>()->GetElapsedTime());
+
+	// a player that dropped keeps its ship a while for its client to come back to, one that crossed into another
+	// shard has gone for good
+	if (!redirected && room->resumes.grace > 0.0f && room->resumes.GetToken(connection) != 0)
+	{
+		Player* heldPlayer = room->serverObjects.Detach(connection);
+		if (room->resumes.Hold(connection, heldPlayer, GetSubsystem<Time>()->GetElapsedTime()))
+		{
+			room->Remove(connection);
+			URHO3D_LOGINFO("Player dropped from room " + String(room->id) + ", holding its ship for " + String(room->resumes.grace) + " s");
+			return;
+		}
+	}
+	room->resumes.Forget(connection);
+
+	// park the ship for the next client, its collision handler goes with it
+	Player* oldPlayer = room->Remove(connection);
+	if (oldPlayer)
+	{
+		UnsubscribeFromEvent(oldPlayer->pNode, E_NODECOLLISION);
+		URHO3D_LOGINFO("Player left room " + String(room->id) + ", " + room->serverObjects.GetDebugText());
+	}
+}
+
+Controls CharacterDemo::FromClientToServerControls()
+{
+	Input* input = GetSubsystem<Input>();
+	Controls controls;
+	//Check which button has been pressed, keep track
+	controls.Set(CTRL_FORWARD, input->GetKeyDown(KEY_W));
+	controls.Set(CTRL_BACK, input->GetKeyDown(KEY_S));
+	controls.Set(CTRL_LEFT, input->GetKeyDown(KEY_A));
+	controls.Set(CTRL_RIGHT, input->GetKeyDown(KEY_D));
+	controls.Set(1024, input->GetKeyDown(KEY_E));
+	controls.Set(CTRL_SHOOT, input->GetKeyDown(KEY_F));
+	// mouse to server
+	controls.yaw_ = yaw_;
+	controls.pitch_ = pitch_;
+
+	return controls;
+}
+
+void CharacterDemo::ProcessClientControls(Room& room, float timeStep)
+{
+	//Server: go through every client in the room that has a player, connections still loading have none
+	for (HashMap<Connection*, Player*>::Iterator i = room.serverObjects.players.Begin(); i != room.serverObjects.players.End(); ++i)
+	{
+		Connection* connection = i->first_;
+		// Get the object this connection is controlling
+		Player* ClientPlayer = i->second_;
+
+		// Get the next input frame sent by the client, in order and once each
+		InputReceiver& input = room.clientInputs[connection];
+		const Controls& controls = input.Next();
+
+		// test where the missile went during the last physics step before moving anything
+		ValidateMissileHit(room, connection, ClientPlayer, input.viewTick);
+
+		// Torque is relative to the forward vector
+		Quaternion rotation(0.0f, controls.yaw_, 0.0f);
+		const float MOVE_TORQUE = 5.0f;
+
+		if (controls.buttons_ & CTRL_FORWARD)
+		{
+			ClientPlayer->pNode->Translate(Vector3::FORWARD * MOVE_SPEED * timeStep);
+		}
+			
+		if (controls.buttons_ & CTRL_BACK)
+		{
+			ClientPlayer->pNode->Translate(Vector3::BACK * MOVE_SPEED * timeStep);
+		}
+			
+		if (controls.buttons_ & CTRL_LEFT)
+		{
+			ClientPlayer->pNode->Translate(Vector3::LEFT * MOVE_SPEED * timeStep);
+		}
+			
+		if (controls.buttons_ & CTRL_RIGHT)
+		{
+			ClientPlayer->pNode->Translate(Vector3::RIGHT * MOVE_SPEED * timeStep);
+		}
+
+		if (controls.buttons_ & CTRL_SHOOT)
+		{
+			// shoot missile if not active already
+			if (ClientPlayer->playerMissile.active == false)
+			{
+				ClientPlayer->playerMissile.active = true;
+				ClientPlayer->shoot(cameraNode_);
+			}
+		}
+
+		// update the client player
+		ClientPlayer->update(cameraNode_);
+
+		// change the rotation of the client player
+		ClientPlayer->pNode->SetRotation(Quaternion(controls.pitch_, controls.yaw_, 0.0f));
+
+		// the next sweep starts from here, a freshly fired missile has just teleported so it is not swept yet
+		Missile& missile = ClientPlayer->playerMissile;
+		missile.sweepStart = missile.pRigidBody->GetPosition();
+		missile.sweepValid = missile.active;
+	}
+}
+
+void CharacterDemo::HandlePhysicsPreStep(StringHash eventType, VariantMap & eventData)
+{
+	Network* network = GetSubsystem<Network>();
+	Connection* serverConnection = GetGameServerConnection();
+	// Client: collect controls, a bot plays its scripted ones once it has a ship
+	if (serverConnection)
+	{
+		using namespace PhysicsPreStep;
+		float timeStep = eventData[P_TIMESTEP].GetFloat();
+		if (!botMode_)
+		{
+			serverConnection->SetPosition(cameraNode_->GetPosition()); // send camera position too
+			SendInputFrames(serverConnection, FromClientToServerControls(), timeStep);
+		}
+		else if (botStats_.playable)
+		{
+			SendInputFrames(serverConnection, botDriver_.controls, timeStep);
+		}
+	}
+	// Server: Read Controls, Apply them if needed, for the room whose physics world is stepping
+	else if (!serverConnection && network->IsServerRunning())
+	{
+		using namespace PhysicsPreStep;
+		PhysicsWorld* world = static_cast<PhysicsWorld*>(eventData[P_WORLD].GetPtr());
+		Room* room = world ? GetRoom(world->GetScene()) : nullptr;
+		if (!room)
+		{
+			return;
+		}
+		float timeStep = eventData[P_TIMESTEP].GetFloat();
+		room->serverTime += timeStep;
+		room->serverTick++;
+		room->lagCompensator.Record(room->serverTime, room->boidNodes); // remember where the boids are this tick
+		room->recorder.RecordTick(*room);
+
+		// take data from clients, process it, one fixed physics step; a lockstep match just passes it on
+		if (room->lockstepServer.IsRunning())
+		{
+			StepLockstep(*room);
+		}
+		else
+		{
+			ProcessClientControls(*room, timeStep);
+		}
+	}
+}
+
+void CharacterDemo::ShowRoomStats(Room& room)
+{
+	DebugHud* debugHud = GetSubsystem<DebugHud>();
+	if (!debugHud)
+	{
+		return;
+	}
+	FinishEncoding(room);
+	debugHud->SetAppStats("Lag compensation", room.lagCompensator.GetDebugText());
+	debugHud->SetAppStats("Player slots", room.serverObjects.GetDebugText());
+	for (int i = 0; i < RATE_TIERS; i++)
+	{
+		debugHud->SetAppStats("Boids to " + room.playerFeeds[i].name, room.playerFeeds[i].GetDebugText());
+	}
+	debugHud->SetAppStats("Boids to observers", room.observerFeed.GetDebugText());
+	if (room.lockstepServer.IsRunning())
+	{
+		debugHud->SetAppStats("Lockstep", room.lockstepServer.GetDebugText());
+	}
+	if (room.recorder.IsOpen())
+	{
+		debugHud->SetAppStats("Recording", room.recorder.GetDebugText());
+	}
+}
+
+void CharacterDemo::HandleClientFinishedLoading(StringHash eventType, VariantMap & eventData)
+{
+	printf("Client has finished loading up the scene from the server \n");
+
+	// everyone starts as an observer, the flock in one compressed message and the observer updates after it
+	using namespace ClientSceneLoaded;
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	Room* room = GetRoom(connection);
+	if (!room)
+	{
+		return;
+	}
+	trafficCapture_.RecordSceneLoaded(connection, GetSubsystem<Time>()->GetElapsedTime());
+	if (room->lockstepServer.IsRunning())
+	{
+		// the match state instead, then every tick
+		room->lockstepServer.Add(connection);
+		SendLockstepStart(*room, connection);
+		return;
+	}
+
+	// a client back from a drop takes its held ship and carries on as a player, a late one joins afresh
+	const VariantMap& identity = connection->GetIdentity();
+	VariantMap::ConstIterator token = identity.Find("ResumeToken");
+	if (token != identity.End())
+	{
+		Player* heldPlayer = room->resumes.Claim(token->second_.GetUInt64(), connection, GetSubsystem<Time>()->GetElapsedTime());
+		if (heldPlayer)
+		{
+			ResumePlayer(*room, connection, heldPlayer);
+			return;
+		}
+		URHO3D_LOGINFO(connection->ToString() + " came back too late to resume, it joins room " + String(room->id) + " afresh");
+	}
+
+	BroadcastGroup& feed = room->observerFeed;
+	feed.Send(connection, MSG_WORLDBOOTSTRAP, true, *GetBootstrap(*room, feed), networkStats_, "WorldBootstrap");
+	feed.Add(connection);
+}
+
+void CharacterDemo::HandleCustomEvent(StringHash eventType, VariantMap & eventData)
+{
+	printf("This is a custom event!! \n");
+}
+
+void CharacterDemo::HandleClientStartGame(StringHash eventType, VariantMap & eventData)
+{
+	printf("Client has pressed START GAME \n");
+	SendClientReady();
+	
+	menuVisible = !menuVisible;
+}
+
+void CharacterDemo::SendClientReady()
+{
+	if (clientObjectID_ == 0) // Client is still observer
+	{
+		Connection* serverConnection = GetGameServerConnection();
+		if (serverConnection)
+		{
+			ClientReadyMessage ready;
+			ready.nodeID = 0;
+			VectorBuffer message;
+			WriteGameMessage(ready, message);
+			serverConnection->SendMessage(ClientReadyMessage::ID, true, true, message);
+			networkStats_.RecordMessage(serverConnection, TRAFFIC_CUSTOM, ClientReadyMessage::GetName(), message.GetSize(), true);
+		}
+	}
+}
+
+void CharacterDemo::HandleServerToClientObjectID(const ObjectAuthorityMessage& authority)
+{
+	clientObjectID_ = authority.nodeID;
+	printf("Client ID : %i \n", clientObjectID_);
+
+	if (resuming_)
+	{
+		resuming_ = false;
+		float away = GetSubsystem<Time>()->GetElapsedTime() - (resumeDeadline_ - resumeGraceSeconds_);
+		URHO3D_LOGINFO("Resumed after " + String((int)(away * 1000.0f)) + " ms, flock catch up " + String(boidReader_.bootstrapBytes) + " bytes");
+	}
+}
+
+void CharacterDemo::ResumePlayer(Room& room, Connection* connection, Player* player)
+{
+	room.serverObjects.Attach(connection, player);
+	room.clientInputs[connection] = InputReceiver();
+	room.recorder.RecordJoin(connection, room.serverTick);
+
+	// back on the full rate feed with only the boids it has missed when that is smaller than the flock; had it been
+	// on a slower tier its mirror differs a little, which the silence limit evens out as after a tier change
+	const VariantMap& identity = connection->GetIdentity();
+	VariantMap::ConstIterator sinceTime = identity.Find("ResumeTime");
+	VariantMap::ConstIterator boidCount = identity.Find("ResumeBoids");
+	BroadcastGroup& feed = room.playerFeeds[0];
+	room.rateControllers[connection].Reset((float)sendRate_);
+	FinishEncoding(room);
+	SharedPtr<SharedMessage> resume = feed.GetResume(room.networkUpdates, worldChecksum_, sinceTime != identity.End() ? sinceTime->second_.GetUInt() : 0,
+		boidCount != identity.End() ? boidCount->second_.GetUInt() : 0, room.serverTime);
+	if (resume)
+	{
+		feed.Send(connection, MSG_BOIDRESUME, true, *resume, networkStats_, "BoidResume");
+	}
+	else
+	{
+		feed.Send(connection, MSG_WORLDBOOTSTRAP, true, *GetBootstrap(room, feed), networkStats_, "WorldBootstrap");
+	}
+	feed.Add(connection);
+
+	URHO3D_LOGINFO("Player resumed in room " + String(room.id) + " after " + String((int)room.resumes.lastAwayMs) + " ms, "
+		+ (resume ? "caught up in " + String(resume->buffer.GetSize()) + " bytes" : String("sent the bootstrap")) + ", "
+		+ room.serverObjects.GetDebugText());
+	// the ObjectAuthority follows when its ready comes, as for any repeated ready
+}
+
+void CharacterDemo::ExpireHeldPlayers(Room& room, float now)
+{
+	if (room.resumes.GetHeldCount() == 0)
+	{
+		return;
+	}
+
+	PODVector<Player*> expired;
+	room.resumes.Expire(now, expired);
+	for (unsigned i = 0; i < expired.Size(); i++)
+	{
+		// parked for the next client, its collision handler goes with it
+		UnsubscribeFromEvent(expired[i]->pNode, E_NODECOLLISION);
+		room.serverObjects.ReleaseDetached(expired[i]);
+		URHO3D_LOGINFO("Held ship in room " + String(room.id) + " parked, its client did not come back, " + room.serverObjects.GetDebugText());
+	}
+}
+
+void CharacterDemo::HandleClientToServerReadyToStart(Room& room, Connection* newConnection)
+{
+	printf("Message sent by the Client and running on Server: Client is ready to start the game \n");
+	if (room.lockstepServer.IsRunning())
+	{
+		// a slot in the match, its ship appears on every peer with the first tick that carries its input
+		bool seated = room.lockstepServer.GetSlot(newConnection) != LOCKSTEP_OBSERVER;
+		int slot = room.lockstepServer.AssignSlot(newConnection);
+		if (slot == LOCKSTEP_OBSERVER)
+		{
+			URHO3D_LOGWARNING("Lockstep match is full, " + newConnection->ToString() + " stays an observer");
+			return;
+		}
+		if (!seated)
+		{
+			room.clientInputs[newConnection] = InputReceiver();
+			room.recorder.RecordJoin(newConnection, room.serverTick);
+			URHO3D_LOGINFO("Player joined the lockstep match in room " + String(room.id) + " slot " + String(slot));
+		}
+		SendLockstepStart(room, newConnection);
+		return;
+	}
+
+	// Hand that client a pooled ship, a repeated ready just gets the same one back
+	bool rejoin = room.serverObjects.Find(newConnection) != nullptr;
+	Player* newPlayer = room.serverObjects.Acquire(newConnection, GetSubsystem<Time>()->GetElapsedTime());
+	if (!rejoin)
+	{
+		room.clientInputs[newConnection] = InputReceiver();
+		room.recorder.RecordJoin(newConnection, room.serverTick);
+		// node collision, once per join, missile hits are judged by ValidateMissileHit instead of the trigger
+		SubscribeToEvent(newPlayer->pNode, E_NODECOLLISION, URHO3D_HANDLER(CharacterDemo, HandleClientPlayerCollision));
+		URHO3D_LOGINFO("Player joined room " + String(room.id) + ", " + room.serverObjects.GetDebugText());
+		effects_.AttachEngine(newPlayer->pNode);
+
+		// a player handed over by a neighbouring shard carries on where its ship crossed
+		const VariantMap& identity = newConnection->GetIdentity();
+		VariantMap::ConstIterator ticket = identity.Find("ShardTicket");
+		ShardArrival arrival;
+		if (shard_.IsEnabled() && ticket != identity.End() && shard_.TakeArrival(ticket->second_.GetUInt64(), arrival))
+		{
+			newPlayer->pNode->SetPosition(arrival.position);
+			newPlayer->pRigidBody->SetPosition(arrival.position);
+			newPlayer->score = arrival.score;
+			newPlayer->health = arrival.health;
+			URHO3D_LOGINFO("Player arrived from a neighbouring shard at " + arrival.position.ToString());
+		}
+
+		// a player needs every boid update its link can take, it starts on the full rate feed with its bootstrap
+		if (room.observerFeed.Remove(newConnection))
+		{
+			BroadcastGroup& feed = room.playerFeeds[0];
+			room.rateControllers[newConnection].Reset((float)sendRate_);
+			feed.Send(newConnection, MSG_WORLDBOOTSTRAP, true, *GetBootstrap(room, feed), networkStats_, "WorldBootstrap");
+			feed.Add(newConnection);
+		}
+
+		// the client reconnects with this after a drop to get the ship back, see HandleClientDisconnected
+		if (room.resumes.grace > 0.0f)
+		{
+			ResumeTokenMessage resume;
+			SecureToken token = room.resumes.Issue(newConnection);
+			resume.tokenHigh = GetTokenHigh(token);
+			resume.tokenLow = GetTokenLow(token);
+			resume.grace = CeilToInt(room.resumes.grace);
+			VectorBuffer message;
+			WriteGameMessage(resume, message);
+			newConnection->SendMessage(ResumeTokenMessage::ID, true, true, message);
+			networkStats_.RecordMessage(newConnection, TRAFFIC_CUSTOM, ResumeTokenMessage::GetName(), message.GetSize(), true);
+		}
+	}
+	// Finally send the object's node ID
+	ObjectAuthorityMessage authority;
+	authority.nodeID = newPlayer->pNode->GetID();
+	VectorBuffer message;
+	WriteGameMessage(authority, message);
+	newConnection->SendMessage(ObjectAuthorityMessage::ID, true, true, message);
+	networkStats_.RecordMessage(newConnection, TRAFFIC_CUSTOM, ObjectAuthorityMessage::GetName(), message.GetSize(), true);
+}
+
+
+
+void CharacterDemo::HandleNodeNameChanged(StringHash eventType, VariantMap& eventData)
+{
+	using namespace NodeNameChanged;
+
+	// only clients buffer, the server owns the real transforms
+	if (!GetGameServerConnection())
+	{
+		return;
+	}
+
+	Node* node = static_cast<Node*>(eventData[P_NODE].GetPtr());
+	if (!node || node->GetID() >= FIRST_LOCAL_ID || node->GetParent() != scene_)
+	{
+		return;
+	}
+
+	// missiles teleport back to the ship when they expire, so they are left to plain replication
+	const String& name = node->GetName();
+	if ((name == "boid" || name == "ship") && !interpolator_.IsTracked(node->GetID()))
+	{
+		interpolator_.Track(node->GetID());
+		node->SetInterceptNetworkUpdate("Network Position", true);
+		node->SetInterceptNetworkUpdate("Network Rotation", true);
+	}
+	if (name == "ship")
+	{
+		effects_.AttachEngine(node);
+	}
+}
+
+void CharacterDemo::HandleNodeRemoved(StringHash eventType, VariantMap& eventData)
+{
+	using namespace NodeRemoved;
+
+	Node* node = static_cast<Node*>(eventData[P_NODE].GetPtr());
+	if (node)
+	{
+		interpolator_.Untrack(node->GetID());
+	}
+}
+
+void CharacterDemo::HandleInterceptNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace InterceptNetworkUpdate;
+
+	Node* node = static_cast<Node*>(eventData[P_SERIALIZABLE].GetPtr());
+	if (!node)
+	{
+		return;
+	}
+
+	unsigned stamp = eventData[P_TIMESTAMP].GetUInt();
+	const String& name = eventData[P_NAME].GetString();
+	if (name == "Network Position")
+	{
+		interpolator_.OnPosition(node->GetID(), stamp, eventData[P_VALUE].GetVector3());
+	}
+	else if (name == "Network Rotation")
+	{
+		// rotation travels as a packed quaternion buffer
+		MemoryBuffer buffer(eventData[P_VALUE].GetBuffer());
+		interpolator_.OnRotation(node->GetID(), stamp, buffer.ReadPackedQuaternion());
+	}
+}
+
+void CharacterDemo::ValidateMissileHit(Room& room, Connection* connection, Player* shooter, unsigned viewTick)
+{
+	Missile& missile = shooter->playerMissile;
+	if (!missile.active || !missile.sweepValid)
+	{
+		return;
+	}
+
+	// the client stamps the tick of the boids it saw, until its clock is synced guess a round trip plus the default playout delay
+	float viewTime = viewTick != 0 ? viewTick / (float)tickRate_ : room.serverTime - connection->GetRoundTripTime() / 1000.0f - 0.1f;
+
+	Vector3 end = missile.pRigidBody->GetPosition();
+	int hit = room.lagCompensator.SweepSegment(room.serverTime, viewTime, missile.sweepStart, end, MISSILE_HIT_RADIUS);
+	if (room.recorder.IsOpen())
+	{
+		room.recorder.RecordSweep(connection, room.serverTick, viewTime, missile.sweepStart, end, hit);
+	}
+	if (hit < 0)
+	{
+		return;
+	}
+
+	shooter->score++;
+	missile.active = false;
+	missile.sweepValid = false;
+
+	// emitt particle effect when boid has been hit
+	SendEffect(room, EFFECT_BURST, room.boidNodes[hit]->GetWorldPosition());
+}
+
+void CharacterDemo::SendEffect(Room& room, EffectType type, const Vector3& position)
+{
+	effects_.Spawn(type, position);
+
+	Network* network = GetSubsystem<Network>();
+	if (!network->IsServerRunning())
+	{
+		return;
+	}
+
+	// written once, every client in the room with the scene loaded is in one of its feeds
+	EffectMessage effect;
+	effect.effect = type;
+	effect.x = position.x_;
+	effect.y = position.y_;
+	effect.z = position.z_;
+	SharedMessage message;
+	WriteGameMessage(effect, message.buffer);
+	for (int i = 0; i < RATE_TIERS; i++)
+	{
+		room.playerFeeds[i].SendAll(MSG_EFFECT, false, message, networkStats_, EffectMessage::GetName());
+	}
+	room.observerFeed.SendAll(MSG_EFFECT, false, message, networkStats_, EffectMessage::GetName());
+}
+
+void CharacterDemo::StepLockstep(Room& room)
+{
+	VectorBuffer message;
+	room.lockstepServer.Step(room.clientInputs, message);
+	if (room.recorder.IsOpen())
+	{
+		room.recorder.RecordLockstepTick(room.lockstepServer.sim.tick, room.lockstepServer.sim.GetHash(), message);
+	}
+
+	// reliable and in order, a peer that missed a tick could not go on
+	for (HashMap<Connection*, int>::ConstIterator i = room.lockstepServer.members.Begin(); i != room.lockstepServer.members.End(); ++i)
+	{
+		i->first_->SendMessage(MSG_LOCKSTEPTICK, true, true, message);
+		networkStats_.RecordMessage(i->first_, TRAFFIC_CUSTOM, "LockstepTick", message.GetSize(), true);
+	}
+}
+
+void CharacterDemo::SendLockstepStart(Room& room, Connection* connection)
 {
-	// -------------------- SCENE -------------------
-		//so we can access resources
-	ResourceCache* cache = GetSubsystem<ResourceCache>();
-	scene_ = new Scene(context_);
-	// Create scene subsystem components
-	scene_->CreateComponent<Octree>();
-	scene_->CreateComponent<PhysicsWorld>();
+	VectorBuffer message;
+	room.lockstepServer.WriteStart(connection, message);
+	connection->SendMessage(MSG_LOCKSTEPSTART, true, true, message);
+	networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, "LockstepStart", message.GetSize(), true);
+}
 
-	//debug shape render
-	scene_->CreateComponent<DebugRenderer>();
+void CharacterDemo::HandleServerBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+	tickStats_.BeginFrame();
 
-	// -------------------- SKYBOX -------------------
+	// boid updates written since the last network update go out now, and input decoded since the last frame goes
+	// to its receivers once for every room, before any of them steps
+	if (netThread_)
 	{
-		//create skybox 
-		Node* skyNode = scene_->CreateChild("Skybox");
-		Skybox* sky = skyNode->CreateComponent<Skybox>();
-		sky->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
-		sky->SetMaterial(cache->GetResource<Material>("Materials/Skybox.xml"));
+		DeliverEncoded();
+		ApplyQueuedInputs();
 	}
+}
 
-	// -------------------- CAMERA -------------------
+void CharacterDemo::HandleServerEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	RunFrameGraph();
+	tickStats_.EndFrame();
+
+	float now = GetSubsystem<Time>()->GetElapsedTime();
+	if (exitAfter_ > 0.0f && now >= exitAfter_)
+	{
+		URHO3D_LOGINFO("Exiting after " + String(exitAfter_) + " s");
+		engine_->Exit();
+		return;
+	}
+	trafficCapture_.Update(now);
+	if (frameGraph_.Report(now))
 	{
-		//Create camera node and component
-		cameraNode_ = new Node(context_);
-		Camera* camera = cameraNode_->CreateComponent<Camera>();
-		cameraNode_->SetPosition(Vector3(0.0f, 5.0f, 0.0f));
-		camera->SetFarClip(300.0f);
+		URHO3D_LOGINFO("Frame graph " + frameGraph_.GetDebugText() + ", slowest frame:\n" + frameGraph_.GetTimeline());
+	}
+	if (tickStats_.Report(now))
+	{
+		float budgetMs = 1000.0f / tickRate_;
+		unsigned players = 0;
+		for (unsigned i = 0; i < rooms_.Size(); i++)
+		{
+			players += rooms_[i]->serverObjects.GetActiveCount();
+		}
+		URHO3D_LOGINFO("Tick avg " + String(tickStats_.averageMs) + " ms max " + String(tickStats_.maxMs) + " ms budget " + String(budgetMs)
+			+ " ms, allocations avg " + String((int)tickStats_.averageAllocations) + " max " + String(tickStats_.maxAllocations) + " ("
+			+ String((int)(tickStats_.averageAllocatedBytes / 1024.0f)) + " KB), clients " + String(GetSubsystem<Network>()->GetClientConnections().Size())
+			+ " players " + String(players)
+			+ (tickStats_.maxMs > budgetMs ? " OVER BUDGET" : ""));
+		for (unsigned i = 0; i < rooms_.Size(); i++)
+		{
+			Room* room = rooms_[i];
+			FinishEncoding(*room);
+			URHO3D_LOGINFO(room->GetDebugText());
+			for (int j = 0; j < RATE_TIERS; j++)
+			{
+				URHO3D_LOGINFO("Boid stream to " + room->playerFeeds[j].name + " " + room->playerFeeds[j].GetDebugText());
+			}
+			URHO3D_LOGINFO("Boid stream to " + room->observerFeed.name + " " + room->observerFeed.GetDebugText());
+			if (room->lockstepServer.IsRunning())
+			{
+				URHO3D_LOGINFO("Lockstep " + room->lockstepServer.GetDebugText());
+			}
+			if (room->recorder.IsOpen())
+			{
+				URHO3D_LOGINFO("Recording " + room->recorder.GetDebugText());
+			}
+			if (room->resumes.holds > 0)
+			{
+				URHO3D_LOGINFO("Resume " + room->resumes.GetDebugText());
+			}
+		}
+		if (trafficCapture_.IsOpen())
+		{
+			URHO3D_LOGINFO("Capture " + trafficCapture_.GetDebugText());
+		}
+		if (shard_.IsEnabled())
+		{
+			URHO3D_LOGINFO(shard_.GetDebugText(*rooms_[0]));
+		}
+		if (netThread_)
+		{
+			URHO3D_LOGINFO("Network thread " + networkThread_.GetDebugText());
+			networkThread_.ResetPeaks();
+		}
+	}
+}
+
+void CharacterDemo::HandleBotUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+	float timeStep = eventData[P_TIMESTEP].GetFloat();
+	float now = GetSubsystem<Time>()->GetElapsedTime();
 
-		GetSubsystem<Renderer>()->SetViewport(0, new Viewport(context_, scene_, camera));
+	if (exitAfter_ > 0.0f && now >= exitAfter_)
+	{
+		engine_->Exit();
+		return;
+	}
+	if (redirectPort_ != 0)
+	{
+		FollowRedirect();
 	}
+	UpdateResume(now);
 
-	// -------------------- FOG -------------------
+	Connection* serverConnection = GetGameServerConnection();
+	if (!serverConnection)
 	{
-		// Create static scene content. First create a zone for ambient lighting and fog control
-		Node* zoneNode = scene_->CreateChild("Zone");
-		// Zone* zone = zoneNode->CreateComponent<Zone>();
-		Zone* zone = zoneNode->CreateComponent<Zone>(LOCAL);
-		zone->SetAmbientColor(Color(0.15f, 0.15f, 0.15f));
-		zone->SetFogColor(Color(0.5f, 0.5f, 0.7f));
-		zone->SetFogStart(100.0f);
-		zone->SetFogEnd(300.0f);
-		zone->SetBoundingBox(BoundingBox(-1000.0f, 1000.0f));
+		return;
 	}
 
-	// -------------------- LIGHT -------------------
+	interpolator_.Update(timeStep, scene_);
+	boidInterpolator_.Update(timeStep, scene_);
+	if (joinTimer_.OnFrame(now, boidReader_.ready || lockstepClient_.active))
 	{
-		// Create a directional light with cascaded shadow mapping
-		Node* lightNode = scene_->CreateChild("DirectionalLight");
-		lightNode->SetDirection(Vector3(0.3f, -0.5f, 0.425f));
-		Light* light = lightNode->CreateComponent<Light>();
-		// Light* light = lightNode->CreateComponent<Light>(LOCAL);
-		light->SetLightType(LIGHT_DIRECTIONAL);
-		light->SetCastShadows(true);
-		light->SetShadowBias(BiasParameters(0.00025f, 0.5f));
-		light->SetShadowCascade(CascadeParameters(10.0f, 50.0f, 200.0f, 0.0f, 0.8f));
-		light->SetSpecularIntensity(0.5f);
+		URHO3D_LOGINFO("Bot " + String(botID_) + " joined: " + joinTimer_.GetDebugText());
 	}
 
-	// -------------------- TERRAIN -------------------
+	bool seated = (clientObjectID_ && boidReader_.ready) || lockstepClient_.slot != LOCKSTEP_OBSERVER;
+	if (seated && !botStats_.playable)
 	{
-		Node* terrrainNode = scene_->CreateChild("Terrain");
-		terrrainNode->SetPosition(Vector3(0.0f, -10.5f));
-		Terrain* terrain = terrrainNode->CreateComponent<Terrain>();
-		// Terrain* terrain = terrrainNode->CreateComponent<Terrain>(LOCAL);
-		terrain->SetSpacing(Vector3(2.0f, 0.25f, 2.0f));
-		terrain->SetSmoothing(true);
-		terrain->SetHeightMap(cache->GetResource<Image>("Textures/HeightMap.png"));
-		terrain->SetMaterial(cache->GetResource<Material>("Materials/Terrain.xml"));
-		terrain->SetCastShadows(true);
-		terrain->SetOccluder(true);
+		botStats_.OnPlayable(now);
 	}
 
-	player.initialise(cache, scene_, cameraNode_);
-	for (int i = 0; i < numOfBoidsets; i++)
+	// the controls go out with the input frames at each physics step
+	if (botStats_.playable)
 	{
-		boids[i].Initialise(cache, scene_);
+		botDriver_.Update(timeStep);
+
+		// from pressing forward to the ship moving on this client, the whole round trip as a player feels it
+		Node* ship = clientObjectID_ ? scene_->GetNode(clientObjectID_) : nullptr;
+		if (ship && botDriver_.probeStarted)
+		{
+			botStats_.StartProbe(now, ship->GetWorldPosition());
+		}
+		else if (ship)
+		{
+			botStats_.UpdateProbe(now, ship->GetWorldPosition());
+		}
 	}
-	
-	// create UI
-	CreateMainMenu();
+
+	botStats_.Update(now, boidInterpolator_.GetServerFrame(), serverConnection->GetRoundTripTime(), serverConnection->GetBytesInPerSec(),
+		boidReader_.corrections);
 }
 
-void CharacterDemo::SubscribeToEvents()
+void CharacterDemo::HandleBotConnectionStatus(StringHash eventType, VariantMap& eventData)
 {
-	// Subscribe to Update event for setting the character controls
-	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(CharacterDemo, HandleUpdate));
-	SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(CharacterDemo, HandlePostUpdate));
+	float now = GetSubsystem<Time>()->GetElapsedTime();
 
-	// server: what happens when a client is connected
-	SubscribeToEvent(E_CLIENTCONNECTED, URHO3D_HANDLER(CharacterDemo, HandleClientConnected));
+	// moving to another shard drops the old connection, the server has not gone
+	if (redirecting_)
+	{
+		return;
+	}
 
-	// Setting or applying controls
-	SubscribeToEvent(E_PHYSICSPRESTEP, URHO3D_HANDLER(CharacterDemo, HandlePhysicsPreStep));
+	if (eventType == E_SERVERCONNECTED)
+	{
+		botStats_.OnConnected(now);
+	}
+	else if (resuming_)
+	{
+		// a reconnect that failed, UpdateResume tries again
+	}
+	else if (resumeToken_ != 0)
+	{
+		URHO3D_LOGWARNING("Bot " + String(botID_) + " dropped, resuming");
+		BeginResume(now);
+	}
+	else
+	{
+		URHO3D_LOGERROR("Bot " + String(botID_) + " lost the server");
+		botStats_.connected = false;
+		botStats_.Update(now + 1.0f, boidInterpolator_.GetServerFrame(), 0.0f, 0.0f, boidReader_.corrections);
+		engine_->Exit();
+	}
+}
 
-	//Server: This is called when a client has connected to a Server
-	SubscribeToEvent(E_CLIENTSCENELOADED, URHO3D_HANDLER(CharacterDemo, HandleClientFinishedLoading));
+void CharacterDemo::HandleLauncherUpdate(StringHash eventType, VariantMap& eventData)
+{
+	float now = GetSubsystem<Time>()->GetElapsedTime();
 
-	// SubscribeToEvent(E_CLIENTCUSTOMEVENT, URHO3D_HANDLER(CharacterDemo, HandleCustomEvent));
-	// GetSubsystem<Network>()->RegisterRemoteEvent(E_CLIENTCUSTOMEVENT);
+	// stagger the joins so the connect times measure the server, not a thundering herd
+	if (botLauncher_.spawned < botLaunchCount_ && now >= botLauncher_.spawned * botSpawnInterval_)
+	{
+		Vector<String> arguments;
+		arguments.Push("--address");
+		arguments.Push(botAddress_);
+		arguments.Push("--port");
+		arguments.Push(String(serverPort_));
+		arguments.Push("--pattern");
+		arguments.Push(botPattern_);
+		arguments.Push("--room");
+		arguments.Push(String(roomID_));
+		if (!botLauncher_.SpawnBot(arguments))
+		{
+			// stop trying after a failed spawn, the rest would fail the same way
+			botLaunchCount_ = botLauncher_.spawned;
+		}
+	}
 
-	SubscribeToEvent(E_CLIENTISREADY, URHO3D_HANDLER(CharacterDemo, HandleClientToServerReadyToStart));
-	GetSubsystem<Network>()->RegisterRemoteEvent(E_CLIENTISREADY);
-	SubscribeToEvent(E_CLIENTOBJECTAUTHORITY, URHO3D_HANDLER(CharacterDemo, HandleServerToClientObjectID));
-	GetSubsystem<Network>()->RegisterRemoteEvent(E_CLIENTOBJECTAUTHORITY);
+	botLauncher_.Update(now);
+}
 
-	SubscribeToEvent(E_POSTRENDERUPDATE, URHO3D_HANDLER(CharacterDemo, HandlePostRender));
+void CharacterDemo::HandleTrafficReplayEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	engine_->SetNextTimeStep(1.0f / tickRate_);
 
-	// node collision
-	SubscribeToEvent(player.pNode, E_NODECOLLISION, URHO3D_HANDLER(CharacterDemo, HandlePlayerCollision));
-	SubscribeToEvent(player.playerMissile.pNode, E_NODECOLLISION, URHO3D_HANDLER(CharacterDemo, HandleMissileCollision));
+	// after the frame's measured work, so the replay's own sending and reading is not counted in it
+	trafficReplay_.OnFrame(tickStats_.frameUsec, tickStats_.frameAllocations, tickStats_.frameAllocatedBytes);
+	if (trafficReplay_.Update(rooms_[0]->serverTime, sceneChecksums_))
+	{
+		return;
+	}
+
+	UnsubscribeFromEvent(E_ENDFRAME);
+	URHO3D_LOGINFO("Traffic replay at " + (trafficSpeed_ > 0.0f ? String(trafficSpeed_) + "x" : String("max speed")) + ": "
+		+ trafficReplay_.GetDebugText(GetSubsystem<Time>()->GetElapsedTime() - trafficReplayStart_));
+	trafficReplay_.Stop();
+	engine_->Exit();
 }
 
-void CharacterDemo::HandleUpdate(StringHash eventType, VariantMap& eventData)
+void CharacterDemo::HandleNetCheckUpdate(StringHash eventType, VariantMap& eventData)
 {
-	if ((GetSubsystem<Network>()->IsServerRunning() || singlePlayer) && !menuVisible)
+	if (impairmentSuite_.Update(GetSubsystem<Time>()->GetElapsedTime()))
 	{
-		using namespace Update;
-		// Take the frame time step, which is stored as a float
-		float timeStep = eventData[P_TIMESTEP].GetFloat();
-		ClientTimeStep = timeStep;
+		return;
+	}
+	UnsubscribeFromEvent(E_UPDATE);
 
-		// Do not move if the UI has a focused element (the console)
-		if (GetSubsystem<UI>()->GetFocusElement()) return;
-		Input* input = GetSubsystem<Input>();
+	String fileName = netCheckOut_.Empty() ? statsDir_ + "netcheck.json" : netCheckOut_;
+	if (!impairmentSuite_.WriteJson(fileName))
+	{
+		URHO3D_LOGERROR("Could not write the network check results to " + fileName);
+	}
 
-		// Use this frame's mouse motion to adjust camera node yaw and pitch.
-		// Clamp the pitch between -90 and 90 degrees
-		IntVector2 mouseMove = input->GetMouseMove();
-		yaw_ += MOUSE_SENSITIVITY * mouseMove.x_;
-		pitch_ += MOUSE_SENSITIVITY * mouseMove.y_;
-		pitch_ = Clamp(pitch_, -90.0f, 90.0f);
+	// non zero for a script to fail on
+	if (impairmentSuite_.Passed())
+	{
+		URHO3D_LOGINFO("Network check passed, results in " + fileName);
+		engine_->Exit();
+	}
+	else
+	{
+		ErrorExit("Network check failed, results in " + fileName);
+	}
+}
+
+void CharacterDemo::HandleNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+	Network* network = GetSubsystem<Network>();
+	float now = GetSubsystem<Time>()->GetElapsedTime();
+
+	if (network->IsServerRunning())
+	{
+		// node IDs are only unique within a scene, the replication diff follows room 0
+		networkStats_.OnNetworkUpdate(scene_, now);
 
-		// -------------------- KEY INPUT -------------------
+		// each boid update is written once and sent to every client in the feed
+		if (netThread_)
+		{
+			DeliverEncoded();
+		}
+		for (unsigned i = 0; i < rooms_.Size(); i++)
 		{
-			// Read WASD keys and move the camera scene node to the corresponding direction if they are pressed, use the Translate() functio(default local space) to move relative to the node's orientation.
-			if (input->GetKeyDown(KEY_W))
+			Room* room = rooms_[i];
+			room->networkUpdates++;
+			ExpireHeldPlayers(*room, now);
+			if (netThread_)
 			{
-				//cameraNode_->Translate(Vector3::FORWARD * MOVE_SPEED * timeStep);
-				player.pNode->Translate(Vector3::FORWARD * MOVE_SPEED * timeStep);
+				QueueEncode(*room);
 			}
-
-			if (input->GetKeyDown(KEY_S))
+			else
 			{
-				//cameraNode_->Translate(Vector3::BACK * MOVE_SPEED * timeStep);
-				player.pNode->Translate(Vector3::BACK * MOVE_SPEED * timeStep);
+				room->sendDue = true;
 			}
+		}
 
-			if (input->GetKeyDown(KEY_A))
-			{
-				//cameraNode_->Translate(Vector3::LEFT * MOVE_SPEED * timeStep);
-				player.pNode->Translate(Vector3::LEFT * MOVE_SPEED * timeStep);
-			}
+		if (shard_.IsEnabled())
+		{
+			UpdateShard(now);
+		}
+	}
 
-			if (input->GetKeyDown(KEY_D))
-			{
-				//cameraNode_->Translate(Vector3::RIGHT * MOVE_SPEED * timeStep);
-				player.pNode->Translate(Vector3::RIGHT * MOVE_SPEED * timeStep);
-			}
+	if (!networkStats_.Update(network, now))
+	{
+		return;
+	}
+
+	if (network->IsServerRunning())
+	{
+		UpdateSendRates();
+	}
+
+	DebugHud* debugHud = GetSubsystem<DebugHud>();
+	if (!debugHud)
+	{
+		return;
+	}
 
-			if (input->GetKeyDown(KEY_F))
+	// connections come and go, so start the HUD lines over each time
+	debugHud->ClearAppStats();
+	Connection* serverConnection = GetGameServerConnection();
+	if (serverConnection)
+	{
+		debugHud->SetAppStats("Net server", networkStats_.GetDebugText(serverConnection));
+	}
+	if (netThread_)
+	{
+		debugHud->SetAppStats("Network thread", networkThread_.GetDebugText());
+	}
+	const Vector<SharedPtr<Connection> >& clients = network->GetClientConnections();
+	for (unsigned i = 0; i < clients.Size(); i++)
+	{
+		String text = networkStats_.GetDebugText(clients[i]);
+		Room* room = GetRoom(clients[i]);
+		if (room)
+		{
+			HashMap<Connection*, InputReceiver>::ConstIterator input = room->clientInputs.Find(clients[i]);
+			if (input != room->clientInputs.End())
 			{
-				if (player.playerMissile.active == false)
-				{
-					// shoot missile if not active already
-					player.playerMissile.active = true;
-					player.shoot(cameraNode_);
-					// score++;
-				}		
+				text += ", " + input->second_.GetDebugText();
 			}
-
-			if (input->GetKeyPress(KEY_M))
+			HashMap<Connection*, RateController>::ConstIterator rate = room->rateControllers.Find(clients[i]);
+			if (rate != room->rateControllers.End())
 			{
-				menuVisible = !menuVisible;
+				text += ", " + rate->second_.GetDebugText();
 			}
 		}
+		debugHud->SetAppStats("Net " + clients[i]->ToString(), text);
+	}
+}
 
-		// updating half the boids at a time depending on the update cycle index
-		if (updateCycleIndex == 0)
+void CharacterDemo::UpdateSendRates()
+{
+	for (unsigned r = 0; r < rooms_.Size(); r++)
+	{
+		Room* room = rooms_[r];
+		for (HashMap<Connection*, RateController>::Iterator i = room->rateControllers.Begin(); i != room->rateControllers.End(); ++i)
 		{
-			for (int i = 0; i < (numOfBoidsets/2); i++)
+			Connection* connection = i->first_;
+			HashMap<Connection*, ConnectionStats>::ConstIterator stats = networkStats_.connections.Find(connection);
+			if (stats == networkStats_.connections.End())
 			{
-				boids[i].Update(timeStep);
+				continue;
 			}
-			updateCycleIndex = 1;
-		}
-		else if (updateCycleIndex == 1)
-		{
-			for (int i = (numOfBoidsets / 2); i < numOfBoidsets; i++)
+
+			RateController& rate = i->second_;
+			int oldTier = rate.tier;
+			if (rate.Update(stats->second_))
 			{
-				boids[i].Update(timeStep);
+				FinishEncoding(*room);
+				// no bootstrap, updates carry whole states on the shared sequence, and the new feed's silence limit
+				// refreshes any boid its mirror disagrees with the client about within a couple of seconds
+				room->playerFeeds[oldTier].Remove(connection);
+				room->playerFeeds[rate.tier].Add(connection);
+				URHO3D_LOGINFO(connection->ToString() + " " + rate.GetDebugText());
 			}
-			updateCycleIndex = 0;
+			networkStats_.SetValue(connection, "boid_rate_hz", sendRate_ / (float)(1 << rate.tier));
+			networkStats_.SetValue(connection, "rate_tier", (float)rate.tier);
 		}
+	}
+}
 
-		
-		player.update(cameraNode_);
+void CharacterDemo::QueueEncode(Room& room)
+{
+	// still writing the last one, the stream skips this update for the room rather than queue behind it
+	if (room.encoding)
+	{
+		networkThread_.late++;
+		return;
+	}
 
-		// rotating the player and making camera follow and rotate around the player
-		player.pNode->SetRotation(Quaternion(pitch_, yaw_, 0.0f));
+	if (!room.PrepareEncode())
+	{
+		return;
+	}
+	room.CaptureBoids(room.encodeJob.positions, room.encodeJob.velocities);
+	room.encoding = networkThread_.PushEncode(&room.encodeJob);
+}
 
-		cameraNode_->SetPosition(player.pNode->GetPosition() + Vector3(0.0f, 2.0f, -10.0f));
-		cameraNode_->SetRotation(Quaternion(0.0f, 0.0f, 0.0f));
-		cameraNode_->RotateAround(player.pNode->GetPosition(), player.pNode->GetRotation(), TS_WORLD);
+void CharacterDemo::DeliverJob(EncodeJob& job)
+{
+	for (int i = 0; i < job.feedCount; i++)
+	{
+		SharedPtr<SharedMessage> message(job.messages[i]);
+		job.messages[i] = nullptr;
+		job.feeds[i]->Deliver(*message, job.time, networkStats_);
+	}
+}
 
-		// go back to menu if health reaches 0 
-		if (player.health < 0)
+void CharacterDemo::DeliverEncoded()
+{
+	EncodeJob* job;
+	while ((job = networkThread_.PopEncoded()) != nullptr)
+	{
+		DeliverJob(*job);
+		job->room->encoding = false;
+	}
+}
+
+void CharacterDemo::FinishEncoding(Room& room)
+{
+	if (!room.encoding)
+	{
+		return;
+	}
+	networkThread_.waits++;
+	while (room.encoding)
+	{
+		DeliverEncoded();
+		if (room.encoding)
 		{
-			// engine_->Exit();
-			menuVisible = true;
+			Time::Sleep(0);
 		}
+	}
+}
+
+SharedPtr<SharedMessage> CharacterDemo::GetBootstrap(Room& room, BroadcastGroup& feed)
+{
+	FinishEncoding(room);
+	room.CaptureBoids(room.boidPositions, room.boidVelocities);
+	return feed.GetBootstrap(room.networkUpdates, worldChecksum_, room.boidPositions, room.boidVelocities, room.serverTime);
+}
 
-		// decriment timer every 200 update loops
-		timerIndex++;
-		if (timerIndex % 70 == 0 && menuVisible == false)
+void CharacterDemo::ApplyQueuedInputs()
+{
+	DecodedInput input;
+	for (int i = 0; i < networkThread_.applyBudget && networkThread_.PopInput(input); i++)
+	{
+		// from a connection that has gone, even if a new one has its address
+		HashMap<Connection*, unsigned>::ConstIterator serial = connectionSerials_.Find(input.connection);
+		if (serial == connectionSerials_.End() || serial->second_ != input.serial)
+		{
+			continue;
+		}
+		Room* room = GetRoom(input.connection);
+		if (!room)
+		{
+			continue;
+		}
+		HashMap<Connection*, InputReceiver>::Iterator receiver = room->clientInputs.Find(input.connection);
+		if (receiver != room->clientInputs.End())
 		{
-			timer--;
+			receiver->second_.Add(input.message, room->serverTick);
 		}
+	}
+}
 
-		// exit game if timer reacher 0
-		if (timer == 0)
+void CharacterDemo::HandleNetworkMessage(StringHash eventType, VariantMap& eventData)
+{
+	using namespace NetworkMessage;
+	int messageID = eventData[P_MESSAGEID].GetInt();
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	const PODVector<unsigned char>& data = eventData[P_DATA].GetBuffer();
+	// Server: the sender's room, null for messages from the server
+	Room* room = GetRoom(connection);
+	if (room && trafficCapture_.IsOpen())
+	{
+		trafficCapture_.RecordMessage(connection, GetSubsystem<Time>()->GetElapsedTime(), messageID, data);
+	}
+
+	// Server: answer clock pings at once, the time it took is the client's round trip
+	if (messageID == MSG_CLOCKPING)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, ClockPingMessage::GetName(), data.Size(), false);
+		ClockPingMessage ping;
+		if (ReadGameMessage(data, ping) && room)
 		{
-			// engine_->Exit();
-			menuVisible = !menuVisible;
+			ClockPongMessage pong;
+			pong.clientTime = ping.clientTime;
+			pong.serverTime = (unsigned)(room->serverTime * 1000.0f);
+			pong.tickRate = tickRate_;
+			VectorBuffer message;
+			WriteGameMessage(pong, message);
+			connection->SendMessage(MSG_CLOCKPONG, false, false, message);
+			networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, ClockPongMessage::GetName(), message.GetSize(), true);
 		}
+		return;
+	}
+	// Client: the server's clock
+	if (messageID == MSG_CLOCKPONG)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, ClockPongMessage::GetName(), data.Size(), false);
+		ClockPongMessage pong;
+		if (ReadGameMessage(data, pong) && connection == GetGameServerConnection())
+		{
+			clockSync_.ReadPong(pong, GetSubsystem<Time>()->GetElapsedTime());
+		}
+		return;
+	}
 
-		// update the timer text
-		timerText->SetText("Timer: " + String(timer));
+	// Client: which ship is ours
+	if (messageID == MSG_OBJECTAUTHORITY)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, ObjectAuthorityMessage::GetName(), data.Size(), false);
+		ObjectAuthorityMessage authority;
+		if (ReadGameMessage(data, authority) && connection == GetGameServerConnection())
+		{
+			HandleServerToClientObjectID(authority);
+		}
+		return;
+	}
+	// Server: a client pressed start
+	if (messageID == MSG_CLIENTREADY)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, ClientReadyMessage::GetName(), data.Size(), false);
+		ClientReadyMessage ready;
+		if (ReadGameMessage(data, ready) && room)
+		{
+			HandleClientToServerReadyToStart(*room, connection);
+		}
+		return;
 	}
-	else if (!menuVisible) // runs the update if it is a client and not on the menu
-	{ 
-		Input* input = GetSubsystem<Input>();
 
-		// Mouse sensitivity as degrees per pixel
-		const float MOUSE_SENSITIVITY = 0.1f;
+	// Client: the flock
+	if (messageID == MSG_WORLDBOOTSTRAP)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, "WorldBootstrap", data.Size(), false);
+		MemoryBuffer message(data);
+		if (!boidReader_.ReadBootstrap(message, worldChecksum_, GetSubsystem<ResourceCache>(), scene_, boidInterpolator_))
+		{
+			URHO3D_LOGERROR("World file " + String(WORLD_SCENE_FILE) + " does not match the server's, checksum " + String(worldChecksum_)
+				+ " against " + String(boidReader_.serverChecksum));
+			connection->Disconnect();
+			return;
+		}
+		joinTimer_.OnBootstrap(GetSubsystem<Time>()->GetElapsedTime());
+		return;
+	}
+	if (messageID == MSG_BOIDRESUME)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, "BoidResume", data.Size(), false);
+		MemoryBuffer message(data);
+		if (!boidReader_.ReadResume(message, worldChecksum_, boidInterpolator_))
+		{
+			// not the flock we kept, give the ship up rather than resume again into the same message
+			URHO3D_LOGERROR("Could not catch up on the flock after resuming");
+			resuming_ = false;
+			resumeToken_ = 0;
+			connection->Disconnect();
+		}
+		return;
+	}
+	if (messageID == MSG_BOIDUPDATE)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, "BoidUpdate", data.Size(), false);
+		MemoryBuffer message(data);
+		boidReader_.ReadUpdate(message, boidInterpolator_);
+		return;
+	}
+	if (messageID == MSG_LOCKSTEPSTART)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, "LockstepStart", data.Size(), false);
+		MemoryBuffer message(data);
+		if (!lockstepClient_.ReadStart(message))
+		{
+			URHO3D_LOGERROR("Could not read the lockstep match state");
+			return;
+		}
+		if (!IsHeadless())
+		{
+			lockstepView_.Initialise(GetSubsystem<ResourceCache>(), scene_, &effects_);
+		}
+		joinTimer_.OnBootstrap(GetSubsystem<Time>()->GetElapsedTime());
+		return;
+	}
+	if (messageID == MSG_LOCKSTEPTICK)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, "LockstepTick", data.Size(), false);
+		MemoryBuffer message(data);
+		if (!lockstepClient_.ReadTick(message))
+		{
+			return;
+		}
+		const LockstepSim& sim = lockstepClient_.sim;
+		for (unsigned i = 0; i < sim.hits.Size(); i++)
+		{
+			effects_.Spawn(EFFECT_BURST, sim.positions[sim.hits[i]]);
+		}
 
-		// Use this frame's mouse motion to adjust camera node yaw and pitch.
-		// Clamp the pitch between -90 and 90 degrees
-		IntVector2 mouseMove = input->GetMouseMove();
-		yaw_ += MOUSE_SENSITIVITY * mouseMove.x_;
-		pitch_ += MOUSE_SENSITIVITY * mouseMove.y_;
-		pitch_ = Clamp(pitch_, -90.0f, 90.0f);
-		
-		// Only move the camera if we have a controllable object
-		if (clientObjectID_)
+		// the server compares this with its own hash for the tick
+		if (lockstepClient_.IsHashDue())
+		{
+			LockstepHashMessage report;
+			report.tick = sim.tick;
+			report.hash = sim.GetHash();
+			VectorBuffer hashMessage;
+			WriteGameMessage(report, hashMessage);
+			connection->SendMessage(MSG_LOCKSTEPHASH, true, true, hashMessage);
+			networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, LockstepHashMessage::GetName(), hashMessage.GetSize(), true);
+		}
+		return;
+	}
+	// Server: a peer's lockstep hash, a mismatch means it has drifted and gets the state again
+	if (messageID == MSG_LOCKSTEPHASH)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, LockstepHashMessage::GetName(), data.Size(), false);
+		LockstepHashMessage report;
+		if (ReadGameMessage(data, report) && room && room->lockstepServer.IsRunning() && !room->lockstepServer.CheckHash(report.tick, report.hash))
+		{
+			URHO3D_LOGERROR("Lockstep desync with " + connection->ToString() + " at tick " + String(report.tick) + ", resending the match state");
+			SendLockstepStart(*room, connection);
+		}
+		return;
+	}
+	// Shard: boid sets and players from a neighbour
+	if (messageID == MSG_SHARDSETS || messageID == MSG_SHARDGHOSTS)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, messageID == MSG_SHARDSETS ? "ShardSets" : "ShardGhosts", data.Size(), false);
+		if (shard_.GetLinkSide(connection) >= 0)
 		{
-			Node* ClientPlayerNode = this->scene_->GetNode(clientObjectID_);
-			if (ClientPlayerNode)
+			MemoryBuffer message(data);
+			if (messageID == MSG_SHARDSETS)
 			{
-				// making camera follow and rotate around the client player
-				cameraNode_->SetPosition(ClientPlayerNode->GetPosition() + Vector3(0.0f, 2.0f, -10.0f));
-				cameraNode_->SetRotation(Quaternion(0.0f, 0.0f, 0.0f));
-				cameraNode_->RotateAround(ClientPlayerNode->GetPosition(), ClientPlayerNode->GetRotation(), TS_WORLD);
-
-				// -------------------- KEY CLIENT INPUT -------------------
-				{
-					if (input->GetKeyPress(KEY_M))
-					{
-						menuVisible = !menuVisible;
-					}
-				}
+				VectorBuffer ack;
+				shard_.ReadHandoffs(*rooms_[0], message, ack);
+				connection->SendMessage(MSG_SHARDSETSACK, true, true, ack);
+				networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, "ShardSetsAck", ack.GetSize(), true);
+			}
+			else
+			{
+				shard_.ReadGhosts(*rooms_[0], message);
 			}
 		}
+		return;
 	}
-}
-
-void CharacterDemo::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
-{
-	// menu visible & invisible
-	UI* ui = GetSubsystem<UI>();
-	Input* input = GetSubsystem<Input>();
-	ui->GetCursor()->SetVisible(menuVisible);
-	window_->SetVisible(menuVisible);
-}
-
-void CharacterDemo::HandlePostRender(StringHash eventType, VariantMap & eventData)
-{
-	// Drawing collision boxes around objects
-	//scene_->GetComponent<PhysicsWorld>()->DrawDebugGeometry(true);
-}
-
-void CharacterDemo::HandlePlayerCollision(StringHash eventType, VariantMap & eventData)
-{
-	using namespace NodeCollision;
-
-	// decrease health if player player collides with boids
-	Node* collidedNode = static_cast<Node*>(eventData[P_OTHERNODE].GetPtr());
-	
-	if (collidedNode->GetName() == "boid")
+	if (messageID == MSG_SHARDSETSACK)
 	{
-		if (!menuVisible)
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, "ShardSetsAck", data.Size(), false);
+		int side = shard_.GetLinkSide(connection);
+		if (side >= 0)
 		{
-			// engine_->Exit();
-			printf("Player collided with Boid!! \n");
-			player.health = player.health - 20;
-			healthText->SetText("Health: " + String(player.health));
+			MemoryBuffer message(data);
+			shard_.ReadHandoffAck(side, message);
 		}
+		return;
 	}
-}
-
-void CharacterDemo::HandleMissileCollision(StringHash eventType, VariantMap & eventData)
-{
-	using namespace NodeCollision;
-
-	// increase score if missile collides with boids
-	Node* collidedNode = static_cast<Node*>(eventData[P_OTHERNODE].GetPtr());
-	if (collidedNode->GetName() == "boid")
+	if (messageID == MSG_SHARDPLAYER)
 	{
-		if (!menuVisible)
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, ShardPlayerMessage::GetName(), data.Size(), false);
+		ShardPlayerMessage handoff;
+		if (shard_.GetLinkSide(connection) >= 0 && ReadGameMessage(data, handoff))
 		{
-			player.score++;
-			player.playerMissile.active = false;
-			scoreText->SetText("Score: " + String(player.score));
-
-			// emitt particle effect when boid has been hit
-			Node* particle = collidedNode->CreateChild("Particle");
-			particle->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-			particle->SetScale(2.0f);
-			ParticleEmitter* emitter = particle->CreateComponent<ParticleEmitter>();
-			emitter->SetEffect(GetSubsystem<ResourceCache>()->GetResource<ParticleEffect>("Particle/Burst.xml"));
+			shard_.AddArrival(handoff, GetSubsystem<Time>()->GetElapsedTime());
 		}
+		return;
 	}
-}
-
-void CharacterDemo::HandleClientPlayerCollision(StringHash eventType, VariantMap & eventData)
-{
-	using namespace NodeCollision;
-
-	// decrease health if player player collides with boids
-	Node* collidedNode = static_cast<Node*>(eventData[P_OTHERNODE].GetPtr());
-
-	if (collidedNode->GetName() == "boid")
+	// Client: our ship has crossed into another shard, followed from the next update rather than from inside the
+	// connection's own message handling
+	if (messageID == MSG_SHARDREDIRECT)
 	{
-		if (!menuVisible)
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, ShardRedirectMessage::GetName(), data.Size(), false);
+		ShardRedirectMessage redirect;
+		if (ReadGameMessage(data, redirect) && connection == GetGameServerConnection())
 		{
-			// engine_->Exit();
-			printf("Player collided with Boid!! \n");
+			redirectPort_ = (unsigned short)redirect.port;
+			redirectTicket_ = MakeToken(redirect.ticketHigh, redirect.ticketLow);
 		}
+		return;
 	}
-}
-
-void CharacterDemo::HandleClientMissileCollision(StringHash eventType, VariantMap & eventData)
-{
-	using namespace NodeCollision;
-	
-	// increase score if missile collides with boids
-	Node* collidedNode = static_cast<Node*>(eventData[P_OTHERNODE].GetPtr());
-	if (collidedNode->GetName() == "boid")
+	// Client: what gets our ship back after a drop
+	if (messageID == MSG_RESUMETOKEN)
 	{
-		if (!menuVisible)
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, ResumeTokenMessage::GetName(), data.Size(), false);
+		ResumeTokenMessage resume;
+		if (ReadGameMessage(data, resume) && connection == GetGameServerConnection())
 		{
-			// emitt particle effect when boid has been hit
-			Node* particle = collidedNode->CreateChild("Particle");
-			particle->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-			particle->SetScale(2.0f);
-			ParticleEmitter* emitter = particle->CreateComponent<ParticleEmitter>();
-			emitter->SetEffect(GetSubsystem<ResourceCache>()->GetResource<ParticleEffect>("Particle/Burst.xml"));
+			resumeToken_ = MakeToken(resume.tokenHigh, resume.tokenLow);
+			resumeGraceSeconds_ = (float)resume.grace;
 		}
+		return;
+	}
+	if (messageID == MSG_EFFECT)
+	{
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, EffectMessage::GetName(), data.Size(), false);
+		EffectMessage effect;
+		if (ReadGameMessage(data, effect) && effect.effect < MAX_EFFECT_TYPES)
+		{
+			effects_.Spawn((EffectType)effect.effect, Vector3(effect.x, effect.y, effect.z));
+		}
+		return;
 	}
-}
-
-Button * CharacterDemo::CreateButton(const String & text, int pHeight, Urho3D::Window * whichWindow, Font * font)
-{
-	Button* button = whichWindow->CreateChild<Button>();
-	button->SetMinHeight(pHeight);
-	button->SetStyleAuto();
-	Text* buttonText = button->CreateChild<Text>();
-	buttonText->SetFont(font, 12);
-	buttonText->SetAlignment(HA_CENTER, VA_CENTER);
-	buttonText->SetText(text);
-	whichWindow->AddChild(button);
-
-	return button;
-}
-
-LineEdit * CharacterDemo::CreateLineEdit(const String & text, int pHeight, Urho3D::Window * whichWindow, Font * font)
-{
-	LineEdit* lineEdit = whichWindow->CreateChild<LineEdit>();
-	lineEdit->SetMinHeight(pHeight);
-	lineEdit->SetAlignment(HA_CENTER, VA_CENTER);
-	lineEdit->SetText(text);
-	whichWindow->AddChild(lineEdit);
-	lineEdit->SetStyleAuto();
-
-	return lineEdit;
-}
 
-void CharacterDemo::HandleStart(StringHash eventType, VariantMap & eventData)
-{
-	if (menuVisible)
+	// Server: input frames
+	if (messageID != MSG_INPUTFRAMES)
 	{
-		menuVisible = false;
+		return;
 	}
+	networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, "InputFrames", data.Size(), false);
 
-	CreateScoreUI();
+	// frames from a client that has no ship yet have nothing to drive
+	if (!room)
+	{
+		return;
+	}
+	HashMap<Connection*, InputReceiver>::Iterator input = room->clientInputs.Find(connection);
+	if (input == room->clientInputs.End())
+	{
+		return;
+	}
 
-	singlePlayer = true;
+	room->recorder.RecordInput(connection, room->serverTick, data);
 
-	// resetting score and timer
-	timer = 100;
-	player.score = 0;
-	player.health = 100;
+	// with the network thread it is only copied here, decoded there and applied at the start of the next frame
+	if (netThread_)
+	{
+		networkThread_.PushInput(connection, connectionSerials_[connection], data);
+		return;
+	}
+	MemoryBuffer message(data);
+	input->second_.Read(message, room->serverTick);
 }
 
-void CharacterDemo::HandleQuit(StringHash eventType, VariantMap & eventData)
+void CharacterDemo::SendInputFrames(Connection* serverConnection, const Controls& controls, float timeStep)
 {
-	engine_->Exit();
-}
+	inputSender_.Push(controls);
 
-void CharacterDemo::HandleConnect(StringHash eventType, VariantMap & eventData)
-{
-	// CreateScene();
+	// the tick of the boids on screen lets the server rewind missile hits, it comes from the boid stream's timestamps
+	float now = GetSubsystem<Time>()->GetElapsedTime();
+	unsigned viewTick = 0;
+	if (clockSync_.IsSynced() && boidReader_.lastTime != 0)
+	{
+		float behind = (boidInterpolator_.GetServerFrame() - boidInterpolator_.renderFrame) * boidInterpolator_.frameInterval;
+		viewTick = (unsigned)Max((boidReader_.lastTime / 1000.0f - behind) * clockSync_.tickRate, 0.0f);
+	}
 
-	Network* network = GetSubsystem<Network>();
-	String address = IPaddress->GetText().Trimmed();
-	if (address.Empty()) { address = "localhost"; }
-	//Specify scene to use as a client for replication
-	network->Connect(address, SERVER_PORT, scene_);
+	VectorBuffer message;
+	if (inputSender_.Write(timeStep, clockSync_.GetServerTick(now), viewTick, message))
+	{
+		serverConnection->SendMessage(MSG_INPUTFRAMES, false, false, message);
+		networkStats_.RecordMessage(serverConnection, TRAFFIC_CUSTOM, "InputFrames", message.GetSize(), true);
+	}
 }
 
-void CharacterDemo::HandleStartServer(StringHash eventType, VariantMap & eventData)
+void CharacterDemo::HandleNetworkSceneLoaded(StringHash eventType, VariantMap& eventData)
 {
-	Log::WriteRaw("(HandleStartServer called) Server is started!");
-	Network* network = GetSubsystem<Network>();
-	network->StartServer(SERVER_PORT);
-	// code to make your main menu disappear. Boolean value
-	menuVisible = !menuVisible;
-	CreateScoreUI();
-
-	// resetting score and timer
-	timer = 100;
-	player.score = 0;
-	player.health = 100;
-}
+	float now = GetSubsystem<Time>()->GetElapsedTime();
+	joinTimer_.OnSceneLoaded(now);
 
-void CharacterDemo::HandleDisconnect(StringHash eventType, VariantMap & eventData)
-{
-	Log::WriteRaw("HandleDisconnect has been pressed. \n");
-	Network* network = GetSubsystem<Network>();
-	Connection* serverConnection = network->GetServerConnection();
-	// Running as Client
-	if (serverConnection)
+	// a bot starts from an empty scene, a client already has the world from CreateScene
+	if (!scene_->GetChild("World"))
 	{
-		serverConnection->Disconnect();
-		scene_->Clear(true, false);
-		clientObjectID_ = 0;
+		worldChecksum_ = LoadWorld(GetSubsystem<ResourceCache>(), scene_);
 	}
-	// Running as a server, stop it
-	else if (network->IsServerRunning())
+	// the server's flock replaces the locally simulated one, a bot never had one
+	if (!rooms_.Empty())
 	{
-		network->StopServer();
-		scene_->Clear(true, false);
+		rooms_[0]->RemoveFlock();
 	}
-}
 
-void CharacterDemo::HandleClientConnected(StringHash eventType, VariantMap & eventData)
-{
-	Log::WriteRaw("(HandleClientConnected) A client has connected!");
-	using namespace ClientConnected;
-	// When a client connects, assign to a scene
-	Connection* newConnection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
-	newConnection->SetScene(scene_);
+	if (botMode_)
+	{
+		botStats_.OnSceneLoaded(now);
+	}
+	// straight into the game, a bot has no menu to press START GAME on and a redirected or resuming player was
+	// already playing; a resume gets its ship back with the ready, or a new one if it came too late
+	if (botMode_ || redirectTicket_ != 0 || resuming_)
+	{
+		redirectTicket_ = 0;
+		SendClientReady();
+	}
 }
 
-Controls CharacterDemo::FromClientToServerControls()
+void CharacterDemo::UpdateShard(float now)
 {
-	Input* input = GetSubsystem<Input>();
-	Controls controls;
-	//Check which button has been pressed, keep track
-	controls.Set(CTRL_FORWARD, input->GetKeyDown(KEY_W));
-	controls.Set(CTRL_BACK, input->GetKeyDown(KEY_S));
-	controls.Set(CTRL_LEFT, input->GetKeyDown(KEY_A));
-	controls.Set(CTRL_RIGHT, input->GetKeyDown(KEY_D));
-	controls.Set(1024, input->GetKeyDown(KEY_E));
-	controls.Set(CTRL_SHOOT, input->GetKeyDown(KEY_F));
-	// mouse to server
-	controls.yaw_ = yaw_;
-	controls.pitch_ = pitch_;
+	Network* network = GetSubsystem<Network>();
+	Room& room = *rooms_[0];
 
-	return controls;
-}
+	// we link to the shard on our right, tried again every second until it is up
+	if (shard_.GetNeighbour(SHARD_RIGHT) >= 0 && !network->GetServerConnection() && now - shardConnectTime_ >= 1.0f)
+	{
+		shardConnectTime_ = now;
+		VariantMap identity;
+		identity["ShardID"] = shard_.index;
+		identity["FlockSeed"] = flockSeed_;
+		identity["BoidSets"] = room.flock.Size();
+		identity["ShardKey"] = shardKey_;
+		network->Connect("localhost", shard_.GetPort(shard_.GetNeighbour(SHARD_RIGHT)), nullptr, identity);
+	}
 
-void CharacterDemo::ProcessClientControls()
-{
-	Network* network = GetSubsystem<Network>();
-	const Vector<SharedPtr<Connection> >& connections = network->GetClientConnections();
-	//Server: go through every client connected
-	for (unsigned i = 0; i < connections.Size(); ++i)
+	for (int side = SHARD_LEFT; side <= SHARD_RIGHT; side++)
 	{
-		Connection* connection = connections[i];
-		// Get the object this connection is controlling
-		Player* ClientPlayer = serverObjects_[connection];
-		// Client has no item connected
-		if (!ClientPlayer)
+		Connection* link = shard_.links[side];
+		if (!link)
 		{
 			continue;
 		}
 
-		// Get the last controls sent by the client
-		const Controls& controls = connection->GetControls();
-
-		// Torque is relative to the forward vector
-		Quaternion rotation(0.0f, controls.yaw_, 0.0f);
-		const float MOVE_TORQUE = 5.0f;
-
-		if (controls.buttons_ & CTRL_FORWARD)
-		{
-			ClientPlayer->pNode->Translate(Vector3::FORWARD * MOVE_SPEED * ClientTimeStep);
-		}
-			
-		if (controls.buttons_ & CTRL_BACK)
+		// hand offs first and reliably, the ghosts after them no longer carry those sets
+		VectorBuffer message;
+		if (shard_.WriteHandoffs(room, side, message))
 		{
-			ClientPlayer->pNode->Translate(Vector3::BACK * MOVE_SPEED * ClientTimeStep);
+			link->SendMessage(MSG_SHARDSETS, true, true, message);
+			networkStats_.RecordMessage(link, TRAFFIC_CUSTOM, "ShardSets", message.GetSize(), true);
 		}
-			
-		if (controls.buttons_ & CTRL_LEFT)
-		{
-			ClientPlayer->pNode->Translate(Vector3::LEFT * MOVE_SPEED * ClientTimeStep);
-		}
-			
-		if (controls.buttons_ & CTRL_RIGHT)
+		if (shard_.WriteGhosts(room, side, message))
 		{
-			ClientPlayer->pNode->Translate(Vector3::RIGHT * MOVE_SPEED * ClientTimeStep);
+			link->SendMessage(MSG_SHARDGHOSTS, false, false, message);
+			networkStats_.RecordMessage(link, TRAFFIC_CUSTOM, "ShardGhosts", message.GetSize(), true);
 		}
+	}
+	shard_.UpdateGhosts(room);
 
-		if (controls.buttons_ & CTRL_SHOOT)
+	// ships that crossed go over with their score and health, and their clients follow with the ticket
+	for (HashMap<Connection*, Player*>::Iterator i = room.serverObjects.players.Begin(); i != room.serverObjects.players.End(); ++i)
+	{
+		Connection* connection = i->first_;
+		Player* player = i->second_;
+		int side = shard_.GetCrossing(player->pNode->GetPosition());
+		if (side < 0 || !shard_.links[side] || shard_.redirected.Contains(connection))
 		{
-			// shoot missile if not active already
-			if (ClientPlayer->playerMissile.active == false)
-			{
-				ClientPlayer->playerMissile.active = true;
-				ClientPlayer->shoot(cameraNode_);
-			}
+			continue;
 		}
 
-		// update the client player
-		ClientPlayer->update(cameraNode_);
-
-		// change the rotation of the client player
-		ClientPlayer->pNode->SetRotation(Quaternion(controls.pitch_, controls.yaw_, 0.0f));
-
-		// node collision
-		SubscribeToEvent(ClientPlayer->pNode, E_NODECOLLISION, URHO3D_HANDLER(CharacterDemo, HandleClientPlayerCollision));
-		SubscribeToEvent(ClientPlayer->playerMissile.pNode, E_NODECOLLISION, URHO3D_HANDLER(CharacterDemo, HandleClientMissileCollision));
+		ShardPlayerMessage handoff;
+		SecureToken ticket = NewSecureToken();
+		handoff.ticketHigh = GetTokenHigh(ticket);
+		handoff.ticketLow = GetTokenLow(ticket);
+		handoff.x = player->pNode->GetPosition().x_;
+		handoff.y = player->pNode->GetPosition().y_;
+		handoff.z = player->pNode->GetPosition().z_;
+		handoff.score = player->score;
+		handoff.health = player->health;
+		VectorBuffer message;
+		WriteGameMessage(handoff, message);
+		shard_.links[side]->SendMessage(MSG_SHARDPLAYER, true, true, message);
+		networkStats_.RecordMessage(shard_.links[side], TRAFFIC_CUSTOM, ShardPlayerMessage::GetName(), message.GetSize(), true);
+
+		ShardRedirectMessage redirect;
+		redirect.port = shard_.GetPort(shard_.GetNeighbour(side));
+		redirect.ticketHigh = handoff.ticketHigh;
+		redirect.ticketLow = handoff.ticketLow;
+		WriteGameMessage(redirect, message);
+		connection->SendMessage(MSG_SHARDREDIRECT, true, true, message);
+		networkStats_.RecordMessage(connection, TRAFFIC_CUSTOM, ShardRedirectMessage::GetName(), message.GetSize(), true);
+
+		shard_.redirected.Insert(connection);
+		shard_.playersOut++;
+		URHO3D_LOGINFO(connection->ToString() + " crossed into shard " + String(shard_.GetNeighbour(side)));
 	}
+	shard_.ExpireArrivals(now);
 }
 
-void CharacterDemo::HandlePhysicsPreStep(StringHash eventType, VariantMap & eventData)
+void CharacterDemo::HandleShardLinkStatus(StringHash eventType, VariantMap& eventData)
 {
-	Network* network = GetSubsystem<Network>();
-	Connection* serverConnection = network->GetServerConnection();
-	// Client: collect controls
-	if (serverConnection)
+	Connection* link = GetSubsystem<Network>()->GetServerConnection();
+	if (eventType == E_SERVERCONNECTED && link)
 	{
-		serverConnection->SetPosition(cameraNode_->GetPosition()); // send camera position too
-		serverConnection->SetControls(FromClientToServerControls()); // send controls to server
+		shard_.SetLink(SHARD_RIGHT, link);
+		URHO3D_LOGINFO("Shard link to the right, " + link->ToString());
+		return;
 	}
-	// Server: Read Controls, Apply them if needed
-	else if (network->IsServerRunning())
+	if (shard_.links[SHARD_RIGHT])
 	{
-		ProcessClientControls(); // take data from clients, process it
+		URHO3D_LOGWARNING("Lost the shard link to the right, retrying");
+		shard_.RemoveLink(shard_.links[SHARD_RIGHT], *rooms_[0]);
 	}
 }
 
-void CharacterDemo::HandleClientFinishedLoading(StringHash eventType, VariantMap & eventData)
+void CharacterDemo::FollowRedirect()
 {
-	printf("Client has finished loading up the scene from the server \n");
+	// the same world from the neighbour, joined from scratch with the ticket that carries our ship over; the old
+	// shard's resume token is no use there
+	scene_->Clear(true, false);
+	clientObjectID_ = 0;
+	resumeToken_ = 0;
+	interpolator_.Reset();
+	inputSender_.Reset();
+	boidReader_.Clear();
+	boidInterpolator_.Reset();
+	clockSync_.Reset();
+
+	VariantMap identity;
+	identity["RoomID"] = roomID_;
+	identity["ShardTicket"] = redirectTicket_;
+	URHO3D_LOGINFO("Moving to the shard on port " + String(redirectPort_));
+	joinTimer_.Start(GetSubsystem<Time>()->GetElapsedTime());
+
+	// Connect drops the old connection first, which is not the server going away
+	redirecting_ = true;
+	GetSubsystem<Network>()->Connect(serverAddress_, redirectPort_, scene_, identity);
+	redirecting_ = false;
+	redirectPort_ = 0;
 }
 
-void CharacterDemo::HandleCustomEvent(StringHash eventType, VariantMap & eventData)
+void CharacterDemo::BeginResume(float now)
 {
-	printf("This is a custom event!! \n");
+	// the world and the flock stay for the resume to build on, the replicated ships are sent again on reconnect
+	URHO3D_LOGWARNING("Lost the server, resuming for up to " + String(resumeGraceSeconds_) + " s");
+	resuming_ = true;
+	resumeRetryTime_ = now;
+	resumeDeadline_ = now + resumeGraceSeconds_;
+	clientObjectID_ = 0;
+	interpolator_.Reset();
+	inputSender_.Reset();
+	// the stamps start over from wherever the stream is when we are back
+	boidInterpolator_.Reset();
 }
 
-void CharacterDemo::HandleClientStartGame(StringHash eventType, VariantMap & eventData)
+void CharacterDemo::UpdateResume(float now)
 {
-	printf("Client has pressed START GAME \n");
-	if (clientObjectID_ == 0) // Client is still observer
+	if (!resuming_ || GetSubsystem<Network>()->GetServerConnection() || now < resumeRetryTime_)
 	{
-		Network* network = GetSubsystem<Network>();
-		Connection* serverConnection = network->GetServerConnection();
-		if (serverConnection)
+		return;
+	}
+
+	if (now >= resumeDeadline_)
+	{
+		// the server has parked our ship by now, what we kept is no use
+		URHO3D_LOGERROR("Could not resume within " + String(resumeGraceSeconds_) + " s");
+		resuming_ = false;
+		resumeToken_ = 0;
+		scene_->Clear(true, false);
+		boidReader_.Clear();
+		clockSync_.Reset();
+		if (botMode_)
 		{
-			VariantMap remoteEventData;
-			remoteEventData[PLAYER_ID] = 0;
-			serverConnection->SendRemoteEvent(E_CLIENTISREADY, true, remoteEventData);
+			botStats_.connected = false;
+			botStats_.Update(now + 1.0f, boidInterpolator_.GetServerFrame(), 0.0f, 0.0f, boidReader_.corrections);
+			engine_->Exit();
 		}
+		return;
 	}
-	
-	menuVisible = !menuVisible;
-}
 
-void CharacterDemo::HandleServerToClientObjectID(StringHash eventType, VariantMap & eventData)
-{
-	clientObjectID_ = eventData[PLAYER_ID].GetUInt();
-	printf("Client ID : %i \n", clientObjectID_);
+	// the server sends only the boids we have not heard of when it can, so it is told where our stream stopped
+	resumeRetryTime_ = now + 1.0f;
+	VariantMap identity;
+	identity["RoomID"] = roomID_;
+	identity["ResumeToken"] = resumeToken_;
+	identity["ResumeTime"] = boidReader_.lastTime;
+	identity["ResumeBoids"] = boidReader_.nodes.Size();
+	GetSubsystem<Network>()->Connect(serverAddress_, serverPort_, scene_, identity);
 }
 
-void CharacterDemo::HandleClientToServerReadyToStart(StringHash eventType, VariantMap & eventData)
+void CharacterDemo::HandleServerConnectionStatus(StringHash eventType, VariantMap& eventData)
 {
-	printf("Event sent by the Client and running on Server: Client is ready to start the game \n");
-	using namespace ClientConnected;
-	Connection* newConnection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
-	// Create a controllable object for that client
-	Player* newPlayer = new Player();
-	newPlayer->initialise(GetSubsystem<ResourceCache>(), scene_, cameraNode_);
-	
-	serverObjects_[newConnection] = newPlayer;
-	// Finally send the object's node ID using a remote event
-	VariantMap remoteEventData;
-	remoteEventData[PLAYER_ID] = newPlayer->pNode->GetID();
-	newConnection->SendRemoteEvent(E_CLIENTOBJECTAUTHORITY, true, remoteEventData);
+	// moving to another shard drops the old connection, the server has not gone; a failed reconnect is retried
+	if (redirecting_ || resuming_ || resumeToken_ == 0)
+	{
+		return;
+	}
+	BeginResume(GetSubsystem<Time>()->GetElapsedTime());
 }
-
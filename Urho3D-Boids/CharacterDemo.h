@@ -22,8 +22,30 @@
 
 #pragma once
 
+#include <Urho3D/Container/HashSet.h>
+
 #include "Sample.h"
 #include "Player.h"
+#include "InterpolationBuffer.h"
+#include "LagCompensation.h"
+#include "LoadTest.h"
+#include "NetworkStats.h"
+#include "PlayerSlots.h"
+#include "InputStream.h"
+#include "FixedStep.h"
+#include "WorldSync.h"
+#include "GameMessages.h"
+#include "ClockSync.h"
+#include "Broadcast.h"
+#include "Effects.h"
+#include "Lockstep.h"
+#include "RateControl.h"
+#include "Room.h"
+#include "Shard.h"
+#include "NetworkThread.h"
+#include "FrameGraph.h"
+#include "Recording.h"
+#include "Traffic.h"
 
 namespace Urho3D
 {
@@ -56,6 +78,8 @@ public:
     /// Destruct.
     ~CharacterDemo();
 
+    /// Setup before engine initialization. Reads the command line and goes headless for a dedicated server.
+    virtual void Setup();
     /// Setup after engine initialization and before running the main loop.
     virtual void Start();
 
@@ -71,8 +95,104 @@ public:
 	// Which port this is running on
 	static const unsigned short SERVER_PORT = 2345;
 	unsigned clientObjectID_ = 0; // Client: ID of own object
-	HashMap<Connection*, Player*> serverObjects_; // Server Client/Object HashMap
 
+	// Command line: --server [--port N] [--boids N] [--tickrate N] [--slots N]
+	bool dedicatedServer_ = false; // headless, no UI, camera, skybox or local player
+	unsigned short serverPort_ = SERVER_PORT;
+	int boidCount_ = 200;
+	int tickRate_ = 60; // simulation steps per second, gameplay, flocking and physics
+	// Command line: --sendrate N, --fps N
+	int sendRate_ = 30; // network updates (snapshots) per second
+	int renderFps_ = 200; // frame cap when there is a window, 0 for uncapped
+	int playerSlotCount_ = 16; // --slots N, ships created up front for remote players, in each room
+
+	// Command line: --bot [--address A] [--bot-id N] [--pattern random|circle|strafe|probe] [--stats-dir D]
+	//               --bots N [--spawn-interval MS], spawns N bot processes and summarises their stats
+	bool botMode_ = false;
+	int botLaunchCount_ = 0;
+	int botID_ = 0;
+	float botSpawnInterval_ = 0.25f;
+	String botAddress_ = "localhost";
+	String botPattern_ = "random";
+	String statsDir_;
+
+	// Command line: --input-rate HZ [--input-redundancy N], client input messages per second and frames in each
+	float inputRate_ = 30.0f;
+	int inputRedundancy_ = 8;
+
+	// Command line: --netstats, dumps the per connection traffic breakdown to the log directory every second
+	bool netStatsDump_ = false;
+
+	// Command line: --replicated-physics, replicate ship and missile rigid bodies so clients simulate them too
+	bool replicatedPhysics_ = false;
+	CreateMode GetPhysicsMode() const { return replicatedPhysics_ ? REPLICATED : LOCAL; }
+
+	// Command line: --check-messages, round trips the game message schemas, logs their sizes and exits
+	bool checkMessages_ = false;
+
+	// Command line: --dr-error U, --dr-silence S, --observer-rate HZ, boid stream dead reckoning and observer update rate
+	float deadReckonError_ = 0.25f;
+	float deadReckonSilence_ = 1.0f;
+	int observerRate_ = 10;
+
+	// Command line: --lockstep [--seed N], dedicated server, sends each tick's player input instead of the flock and
+	// every peer simulates the match itself; --seed lays out the flock, by default it differs every run
+	bool lockstep_ = false;
+	unsigned flockSeed_ = 0;
+
+	// Command line: --rooms N, dedicated server, hosts N independent matches in one process; --room N, client or bot,
+	// the one to join
+	int roomCount_ = 1;
+	unsigned roomID_ = 0;
+
+	// Command line: --shards N --shard I --shard-key K [--shard-width W], dedicated server, one of N processes on this
+	// host that split the arena into slabs W wide along x; shard I listens on --port + I, its links carry K
+	int shardCount_ = 1;
+	int shardIndex_ = 0;
+	float shardWidth_ = 60.0f;
+	String shardKey_;
+
+	// Command line: --net-thread, dedicated server, decodes input and writes the boid stream on a thread of its own
+	bool netThread_ = false;
+	// Command line: --serial-frame, runs the frame graph's tasks one after another on the main thread, to compare
+	bool serialFrame_ = false;
+
+	// Command line: --record [--record-dir D], dedicated server, appends each room's session to a file in D, the log
+	// directory's recordings/ by default; --replay FILE [--from T] [--to T] [--replay-csv F], headless, steps through
+	// a recording's ticks T to T, logs what it finds and exits
+	bool record_ = false;
+	String recordDir_;
+	String replayFile_;
+	unsigned replayFrom_ = 0;
+	unsigned replayTo_ = M_MAX_UNSIGNED;
+	String replayCsv_;
+
+	// Command line: --latency MS [--loss PERCENT], delays and drops this process's outgoing packets, for a poor
+	// connection on one host; --exit-after S, server or bot, exits after S seconds
+	int simulatedLatency_ = 0;
+	float simulatedLoss_ = 0.0f;
+	float exitAfter_ = 0.0f;
+	// Command line: --netcheck [--netcheck-profile NAME] [--netcheck-bots N] [--netcheck-time S] [--netcheck-out F],
+	// runs a server and N probe bots under each impairment profile, writes the results as JSON and exits non zero
+	// when a profile is over its limits
+	bool netCheck_ = false;
+	String netCheckProfile_;
+	int netCheckBots_ = 4;
+	float netCheckTime_ = 20.0f;
+	String netCheckOut_;
+
+	// Command line: --capture [--capture-dir D], dedicated server, writes what its clients send to a file in D, the log
+	// directory's captures/ by default; --replay-traffic FILE [--speed N|max] [--traffic-copies N], dedicated server,
+	// plays a capture back into itself N times over at N times real time, logs the tick time and allocations and exits
+	bool capture_ = false;
+	String captureDir_;
+	String trafficFile_;
+	float trafficSpeed_ = 1.0f; // 0 for as fast as the server steps
+	int trafficCopies_ = 1;
+
+	// Command line: --resume-grace S, server, holds a dropped player's ship S seconds for its client to reconnect to,
+	// 0 parks it at once like a leave
+	float resumeGrace_ = 10.0f;
 
 protected:
     /// Return XML patch instructions for screen joystick layout for a specific sample app, if any.
@@ -122,6 +242,37 @@ protected:
     }
 
 private:
+	void ParseArguments();
+	/// Return true when running without a window: dedicated server, bot or bot launcher.
+	bool IsHeadless() const { return dedicatedServer_ || botMode_ || botLaunchCount_ > 0 || checkMessages_ || !replayFile_.Empty() || netCheck_; }
+	void StartDedicatedServer();
+	void StartBot();
+	void StartBotLauncher();
+	void StartNetCheck();
+	// Dedicated server: play a capture back into it, false when it could not be read
+	bool StartTrafficReplay(unsigned short port);
+	// a recording read back, false when it could not be
+	bool RunReplay();
+	String GetProgramFileName() const;
+	/// Client: the connection to the game server. A dedicated server is never a client, a shard's server connection is its link to a neighbour.
+	Connection* GetGameServerConnection() const;
+	void SendClientReady();
+	// every room's flock steers on the work queue together, then each applies it
+	void UpdateFlocks(float timeStep);
+	// end of frame: each room's boid updates written and sent, its HUD lines, and the next step's steering, as tasks
+	// on the work queue with the dependencies between them
+	void RunFrameGraph();
+	static void SendRoomTask(void* owner, void* data);
+	static void RoomStatsTask(void* owner, void* data);
+	// Server: a room's lines on the debug HUD
+	void ShowRoomStats(Room& room);
+	// a room around scene, or with a scene of its own when there is none, and its flock
+	Room* CreateRoom(unsigned id, Scene* scene);
+	// Server: the room a connection is in, or the room whose scene this is; null when there is none
+	Room* GetRoom(Connection* connection) const;
+	Room* GetRoom(Scene* scene) const;
+	// Server or single player: one fixed step of the local player, the flock and the round timer
+	void SimulateLocalStep(float timeStep);
 	void CreateMainMenu();
 	void CreateScoreUI();
     /// Create static scene content.
@@ -137,7 +288,39 @@ private:
 	void HandleMissileCollision(StringHash eventType, VariantMap& eventData);
 
 	void HandleClientPlayerCollision(StringHash eventType, VariantMap& eventData);
-	void HandleClientMissileCollision(StringHash eventType, VariantMap& eventData);
+	// Server: test a remote player's missile path against the boids as that player saw them
+	void ValidateMissileHit(Room& room, Connection* connection, Player* shooter, unsigned viewTick);
+	// spawn a cosmetic effect here and, on a server, have every client in the room spawn it too
+	void SendEffect(Room& room, EffectType type, const Vector3& position);
+	// Server: one lockstep tick from the players' input, sent to everyone in the room's match
+	void StepLockstep(Room& room);
+	// Server: move players between the boid feeds as their links allow, once a second with fresh stats
+	void UpdateSendRates();
+	void SendLockstepStart(Room& room, Connection* connection);
+	// Shard: keep the link to the right up, trade boid sets and ghosts with the neighbours, hand over players that crossed
+	void UpdateShard(float now);
+	void HandleShardLinkStatus(StringHash eventType, VariantMap& eventData);
+	// Client: join the shard our ship has crossed into
+	void FollowRedirect();
+	// Client: the server went away while we had a ship, keep the world and reconnect with the resume token until
+	// the server's grace runs out
+	void BeginResume(float now);
+	void UpdateResume(float now);
+	void HandleServerConnectionStatus(StringHash eventType, VariantMap& eventData);
+	// Server: a reconnect claimed its held ship, it goes straight back on the player feed with what it missed
+	void ResumePlayer(Room& room, Connection* connection, Player* player);
+	// Server: park the ships whose clients did not come back in time
+	void ExpireHeldPlayers(Room& room, float now);
+	// Network thread: hand a room's due feeds and its flock over, send what has come back, wait for a room's
+	// writers to come back before touching its feeds here
+	void QueueEncode(Room& room);
+	void DeliverEncoded();
+	void DeliverJob(EncodeJob& job);
+	void FinishEncoding(Room& room);
+	// Server: a feed's bootstrap from the flock as it is now
+	SharedPtr<SharedMessage> GetBootstrap(Room& room, BroadcastGroup& feed);
+	// Network thread: decoded input into the receivers, a budget's worth each frame
+	void ApplyQueuedInputs();
 
 	Button* CreateButton(const String& text, int pHeight, Urho3D::Window* whichWindow, Font* font);
 	LineEdit* CreateLineEdit(const String& text, int pHeight, Urho3D::Window* whichWindow, Font* font);
@@ -148,17 +331,45 @@ private:
 	void HandleStartServer(StringHash eventType, VariantMap & eventData);
 	void HandleDisconnect(StringHash eventType, VariantMap & eventData);
 	void HandleClientConnected(StringHash eventType, VariantMap & eventData);
+	void HandleClientDisconnected(StringHash eventType, VariantMap & eventData);
+	// Server: the identity names the room to join, the connection gets that room's scene
+	void HandleClientIdentity(StringHash eventType, VariantMap & eventData);
 
 	Controls FromClientToServerControls();
-	void ProcessClientControls();
+	void ProcessClientControls(Room& room, float timeStep);
 	void HandlePhysicsPreStep(StringHash eventType, VariantMap & eventData);
 	void HandleClientFinishedLoading(StringHash eventType, VariantMap& eventData);
 	void HandleCustomEvent(StringHash eventType, VariantMap& eventData);
 	void HandleClientStartGame(StringHash eventType, VariantMap& eventData);
-	// Handle remote event from server to Client to share controlled object node ID.
-	void HandleServerToClientObjectID(StringHash eventType, VariantMap& eventData);
-	// Handle remote event, client tells server that client is ready to start game
-	void HandleClientToServerReadyToStart(StringHash eventType, VariantMap& eventData);
+	// Handle message from server to Client to share controlled object node ID.
+	void HandleServerToClientObjectID(const ObjectAuthorityMessage& authority);
+	// Handle message, client tells server that client is ready to start game
+	void HandleClientToServerReadyToStart(Room& room, Connection* newConnection);
+
+	// Dedicated server: time the work done in each frame
+	void HandleServerBeginFrame(StringHash eventType, VariantMap& eventData);
+	void HandleServerEndFrame(StringHash eventType, VariantMap& eventData);
+	// Bot: drive controls and record connection stats
+	void HandleBotUpdate(StringHash eventType, VariantMap& eventData);
+	void HandleBotConnectionStatus(StringHash eventType, VariantMap& eventData);
+	void HandleLauncherUpdate(StringHash eventType, VariantMap& eventData);
+	void HandleNetCheckUpdate(StringHash eventType, VariantMap& eventData);
+	// Traffic replay: one tick each frame, and the capture's messages that are due
+	void HandleTrafficReplayEndFrame(StringHash eventType, VariantMap& eventData);
+	// Client: the server's scene has loaded, build the world locally and wait for the flock
+	void HandleNetworkSceneLoaded(StringHash eventType, VariantMap& eventData);
+	// Server: input frames from a client
+	void HandleNetworkMessage(StringHash eventType, VariantMap& eventData);
+	// Client: record this tick's input and send the newest frames when a message is due
+	void SendInputFrames(Connection* serverConnection, const Controls& controls, float timeStep);
+	// Sample replication and refresh the per connection traffic counters
+	void HandleNetworkUpdate(StringHash eventType, VariantMap& eventData);
+
+	// Client: start buffering the network transform of remote nodes once they are named
+	void HandleNodeNameChanged(StringHash eventType, VariantMap& eventData);
+	void HandleNodeRemoved(StringHash eventType, VariantMap& eventData);
+	// Client: intercepted transform update from the server goes into the interpolation buffer
+	void HandleInterceptNetworkUpdate(StringHash eventType, VariantMap& eventData);
 
     /// Touch utility object.
     SharedPtr<Touch> touch_;
@@ -166,4 +377,67 @@ private:
     WeakPtr<Character> character_;
     /// First person camera flag.
     bool firstPerson_;
+	/// Client: playout buffer for replicated boids and ships.
+	SnapshotInterpolator interpolator_;
+	/// Matches in this process, room 0 plays in scene_, and the room of each client connection.
+	Vector<SharedPtr<Room> > rooms_;
+	HashMap<Connection*, Room*> connectionRooms_;
+	/// Server: a number for each client connection that is never reused, unlike its address.
+	HashMap<Connection*, unsigned> connectionSerials_;
+	unsigned nextConnectionSerial_ = 0;
+	/// Client: estimate of the server's physics clock.
+	ClockSync clockSync_;
+	/// Peers with a window: pooled local particle effects.
+	EffectPool effects_;
+	/// Dedicated server: frame work time against the tick budget.
+	ServerTickStats tickStats_;
+	/// Bot: scripted input and connection stats.
+	BotDriver botDriver_;
+	BotStats botStats_;
+	/// Bot launcher: spawned bot processes.
+	BotLauncher botLauncher_;
+	/// Network check: a server and bots per impairment profile.
+	ImpairmentSuite impairmentSuite_;
+	/// Fixed step clock for gameplay and flocking, independent of the frame rate.
+	FixedStepClock simClock_;
+	/// Client: input frames waiting to be sent, several times over.
+	InputSender inputSender_;
+	/// Checksum of the world scene file, the server's and the client's must match.
+	unsigned worldChecksum_ = 0;
+	/// Client: the server's flock as local nodes, and its own playout buffer.
+	BoidStreamReader boidReader_;
+	SnapshotInterpolator boidInterpolator_;
+	/// Shard: our slab of the arena and the links to the neighbours, and when the link to the right was last tried.
+	Shard shard_;
+	float shardConnectTime_ = -1.0f;
+	/// Client: the server's address, and the shard to move to with the ticket that carries our ship there.
+	String serverAddress_ = "localhost";
+	unsigned short redirectPort_ = 0;
+	SecureToken redirectTicket_ = 0;
+	bool redirecting_ = false;
+	/// Client: the token that gets our ship back after a drop and how long the server holds it; while reconnecting,
+	/// when the next attempt goes and when we give up.
+	SecureToken resumeToken_ = 0;
+	float resumeGraceSeconds_ = 0.0f;
+	bool resuming_ = false;
+	float resumeRetryTime_ = 0.0f;
+	float resumeDeadline_ = 0.0f;
+	/// End of frame work as a task graph, and the share of each room's due flock each of its flock tasks computes.
+	FrameGraph frameGraph_;
+	PODVector<FlockSlice> flockSlices_;
+	/// Dedicated server: input decode and boid stream writing, declared after rooms_ so it stops before their jobs go.
+	NetworkThread networkThread_;
+	/// Client: a lockstep match and the nodes showing it.
+	LockstepClient lockstepClient_;
+	LockstepView lockstepView_;
+	/// Client: Connect to first playable frame.
+	JoinTimer joinTimer_;
+	/// Per connection traffic by message type.
+	NetworkStats networkStats_;
+	/// Dedicated server: what the clients send, or a capture of it played back, each room's scene checksum for
+	/// the replay clients' scene loaded and when it started.
+	TrafficCapture trafficCapture_;
+	TrafficReplay trafficReplay_;
+	PODVector<unsigned> sceneChecksums_;
+	float trafficReplayStart_ = 0.0f;
 };
@@ -0,0 +1,127 @@
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#include "ClockSync.h"
+#include "GameMessages.h"
+
+ClockSync::ClockSync()
+{
+	interval = 1.0f;
+	fastInterval = 0.1f;
+	fastSamples = 8;
+	maxSlew = 0.01f;
+	stepThreshold = 0.25f;
+
+	Reset();
+}
+
+void ClockSync::Reset()
+{
+	offset = 0.0;
+	rtt = 0.0f;
+	jitter = 0.0f;
+	tickRate = 60;
+	pings = 0;
+	pongs = 0;
+	steps = 0;
+
+	sampleCount = 0;
+	newest = -1;
+	targetOffset = 0.0;
+	pingTimer = 0.0f;
+	synced = false;
+}
+
+bool ClockSync::WritePing(float timeStep, float localTime, VectorBuffer& message)
+{
+	pingTimer -= timeStep;
+	if (pingTimer > 0.0f)
+	{
+		return false;
+	}
+	pingTimer = (int)pongs < fastSamples ? fastInterval : interval;
+
+	ClockPingMessage ping;
+	ping.clientTime = (unsigned)(localTime * 1000.0f);
+	WriteGameMessage(ping, message);
+	pings++;
+	return true;
+}
+
+void ClockSync::ReadPong(const ClockPongMessage& pong, float localTime)
+{
+	// t0 and t3 are ours, the server stamps t1 = t2 as it answers at once
+	double sent = pong.clientTime / 1000.0;
+	double received = localTime;
+	float roundTrip = (float)(received - sent);
+	if (roundTrip < 0.0f || roundTrip > 5.0f)
+	{
+		// from before a reset, or so late it says nothing
+		return;
+	}
+
+	newest = (newest + 1) % MAX_SAMPLES;
+	sampleOffsets[newest] = pong.serverTime / 1000.0 - (sent + received) * 0.5;
+	sampleRtts[newest] = roundTrip;
+	sampleCount = Min(sampleCount + 1, (int)MAX_SAMPLES);
+	tickRate = pong.tickRate;
+
+	if (pongs == 0)
+	{
+		rtt = roundTrip;
+	}
+	else
+	{
+		jitter += (Abs(roundTrip - rtt) - jitter) / 8.0f;
+		rtt += (roundTrip - rtt) / 8.0f;
+	}
+	pongs++;
+
+	int best = newest;
+	for (int i = 0; i < sampleCount; i++)
+	{
+		if (sampleRtts[i] < sampleRtts[best])
+		{
+			best = i;
+		}
+	}
+	targetOffset = sampleOffsets[best];
+
+	// the first sample, or the server clock jumped (a restart), so step rather than slew for minutes
+	if (!synced || Abs(targetOffset - offset) > stepThreshold)
+	{
+		offset = targetOffset;
+		synced = true;
+		steps++;
+	}
+}
+
+void ClockSync::Update(float timeStep)
+{
+	if (!synced)
+	{
+		return;
+	}
+	double maxStep = maxSlew * timeStep;
+	offset += Clamp(targetOffset - offset, -maxStep, maxStep);
+}
+
+unsigned ClockSync::GetServerTick(float localTime) const
+{
+	if (!synced)
+	{
+		return 0;
+	}
+	return (unsigned)Max(GetServerTime(localTime) * tickRate, 0.0);
+}
+
+String ClockSync::GetDebugText() const
+{
+	if (!synced)
+	{
+		return "not synced, " + String(pings) + " pings";
+	}
+	return "offset " + String((float)offset) + " s error " + String((int)((targetOffset - offset) * 1000.0)) + " ms"
+		+ " rtt " + String((int)(rtt * 1000.0f)) + " ms jitter " + String((int)(jitter * 1000.0f)) + " ms"
+		+ " samples " + String(sampleCount) + " steps " + String(steps);
+}
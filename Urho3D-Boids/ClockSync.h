@@ -0,0 +1,66 @@
+#pragma once
+#include <Urho3D/Container/Str.h>
+
+namespace Urho3D
+{
+	class VectorBuffer;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+struct ClockPongMessage;
+
+// client: estimates the server's simulation clock from ping/pong exchanges, NTP style. The offset comes from the
+// sample with the shortest round trip in the window, the one least delayed by queueing, and the estimate slews
+// towards it so server time on the client never jumps or runs backwards once synced
+class ClockSync
+{
+public:
+	static const int MAX_SAMPLES = 16;
+
+	ClockSync();
+
+	void Reset();
+
+	// true when a ping is due, written into message
+	bool WritePing(float timeStep, float localTime, VectorBuffer& message);
+
+	void ReadPong(const ClockPongMessage& pong, float localTime);
+
+	// slew the estimate towards the filtered offset, call every frame
+	void Update(float timeStep);
+
+	bool IsSynced() const { return synced; }
+
+	// server simulation time and tick at the given local time, the tick is 0 until synced
+	double GetServerTime(float localTime) const { return localTime + offset; }
+	unsigned GetServerTick(float localTime) const;
+
+	String GetDebugText() const;
+
+	// seconds between pings, the first fastSamples go out at fastInterval to sync quickly
+	float interval;
+	float fastInterval;
+	int fastSamples;
+	// most the estimate moves per second when slewing, and the error past which it steps instead
+	float maxSlew;
+	float stepThreshold;
+
+	// readout, seconds
+	double offset;
+	float rtt;
+	float jitter;
+	int tickRate;
+	unsigned pings;
+	unsigned pongs;
+	unsigned steps;
+
+private:
+	double sampleOffsets[MAX_SAMPLES];
+	float sampleRtts[MAX_SAMPLES];
+	int sampleCount;
+	int newest;
+	double targetOffset;
+	float pingTimer;
+	bool synced;
+};
@@ -0,0 +1,40 @@
+#include "DeterministicRandom.h"
+
+DeterministicRandom::DeterministicRandom(unsigned seed)
+{
+	Seed(seed);
+}
+
+void DeterministicRandom::Seed(unsigned seed)
+{
+	// spread nearby seeds apart, and xorshift never leaves 0
+	state = seed * 2654435761u ^ 0x9e3779b9u;
+	if (state == 0)
+	{
+		state = 1;
+	}
+}
+
+DeterministicRandom DeterministicRandom::ForTick(unsigned seed, unsigned tick)
+{
+	return DeterministicRandom(seed ^ (tick * 0x85ebca6bu + 0xc2b2ae35u));
+}
+
+unsigned DeterministicRandom::Next()
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+float DeterministicRandom::Float(float range)
+{
+	// the top 24 bits fill a float mantissa exactly
+	return (Next() >> 8) * (1.0f / 16777216.0f) * range;
+}
+
+float DeterministicRandom::Float(float min, float max)
+{
+	return min + Float(max - min);
+}
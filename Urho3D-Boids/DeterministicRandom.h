@@ -0,0 +1,23 @@
+#pragma once
+
+// xorshift generator with its own state. Random() shares one process wide seed, so two peers never draw the same
+// numbers; this gives the same sequence anywhere it is given the same seed
+class DeterministicRandom
+{
+public:
+	DeterministicRandom(unsigned seed = 1);
+
+	void Seed(unsigned seed);
+
+	// a generator for one simulation tick, so a tick draws the same numbers whatever ran before it
+	static DeterministicRandom ForTick(unsigned seed, unsigned tick);
+
+	unsigned Next();
+
+	// 0 to range, and min to max, like Random(range) and Random(min, max)
+	float Float(float range);
+	float Float(float min, float max);
+
+private:
+	unsigned state;
+};
@@ -0,0 +1,112 @@
+#include <Urho3D/Graphics/ParticleEffect.h>
+#include <Urho3D/Graphics/ParticleEmitter.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Effects.h"
+
+static const char* EFFECT_FILES[MAX_EFFECT_TYPES] = { "Particle/Burst.xml" };
+
+EffectPool::EffectPool()
+{
+	emitTime = 0.25f;
+	lifeTime = 1.5f;
+
+	spawned = 0;
+	recycled = 0;
+
+	pRes = nullptr;
+	pScene = nullptr;
+	for (int i = 0; i < MAX_EFFECT_TYPES; i++)
+	{
+		next[i] = 0;
+	}
+}
+
+void EffectPool::Initialise(ResourceCache* res, Scene* scene, int size)
+{
+	pRes = res;
+	pScene = scene;
+	for (int i = 0; i < MAX_EFFECT_TYPES; i++)
+	{
+		slots[i].Clear();
+		slots[i].Resize(size);
+		for (unsigned j = 0; j < slots[i].Size(); j++)
+		{
+			slots[i][j].age = lifeTime;
+		}
+		next[i] = 0;
+	}
+}
+
+void EffectPool::Spawn(EffectType type, const Vector3& position)
+{
+	if (!pScene || type >= MAX_EFFECT_TYPES || slots[type].Empty())
+	{
+		return;
+	}
+
+	// the oldest slot, still fading or not
+	Slot& slot = slots[type][next[type]];
+	next[type] = (next[type] + 1) % slots[type].Size();
+
+	// clearing the scene on a disconnect takes the node with it, so make another
+	if (!slot.node || !slot.emitter)
+	{
+		slot.node = pScene->CreateChild("Effect", LOCAL);
+		slot.node->SetScale(2.0f);
+		slot.emitter = slot.node->CreateComponent<ParticleEmitter>(LOCAL);
+		slot.emitter->SetEffect(pRes->GetResource<ParticleEffect>(EFFECT_FILES[type]));
+	}
+	else if (slot.age < lifeTime)
+	{
+		recycled++;
+	}
+
+	slot.node->SetPosition(position);
+	slot.emitter->RemoveAllParticles();
+	slot.emitter->Reset();
+	slot.emitter->SetEmitting(true);
+	slot.age = 0.0f;
+	spawned++;
+}
+
+void EffectPool::Update(float timeStep)
+{
+	for (int i = 0; i < MAX_EFFECT_TYPES; i++)
+	{
+		for (unsigned j = 0; j < slots[i].Size(); j++)
+		{
+			Slot& slot = slots[i][j];
+			if (!slot.emitter || slot.age >= lifeTime)
+			{
+				continue;
+			}
+			slot.age += timeStep;
+			if (slot.age >= emitTime && slot.emitter->IsEmitting())
+			{
+				slot.emitter->SetEmitting(false);
+			}
+		}
+	}
+}
+
+void EffectPool::AttachEngine(Node* ship)
+{
+	if (!pRes || !ship || ship->GetChild("Engine"))
+	{
+		return;
+	}
+
+	Node* particle = ship->CreateChild("Engine", LOCAL);
+	particle->SetPosition(Vector3(0.0f, 2.0f, -4.0f));
+	particle->SetScale(2.0f);
+	ParticleEmitter* emitter = particle->CreateComponent<ParticleEmitter>(LOCAL);
+	emitter->SetEffect(pRes->GetResource<ParticleEffect>("Particle/Fire.xml"));
+}
+
+String EffectPool::GetDebugText() const
+{
+	return "spawned " + String(spawned) + " recycled early " + String(recycled);
+}
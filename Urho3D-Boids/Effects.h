@@ -0,0 +1,65 @@
+#pragma once
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+	class Node;
+	class ParticleEmitter;
+	class ResourceCache;
+	class Scene;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+enum EffectType
+{
+	EFFECT_BURST = 0,
+	MAX_EFFECT_TYPES
+};
+
+// a cosmetic effect is never scene data, the server sends an EffectMessage and each peer with a window spawns it here.
+// The emitter nodes are LOCAL, made on first use and recycled oldest first
+class EffectPool
+{
+public:
+	EffectPool();
+
+	// size emitters per effect type, a peer that never calls this spawns nothing
+	void Initialise(ResourceCache* pRes, Scene* pScene, int size);
+
+	void Spawn(EffectType type, const Vector3& position);
+
+	// stop emitting once a burst has run its time
+	void Update(float timeStep);
+
+	// the engine fire on a ship, a LOCAL child so it is never replicated, does nothing if the ship has one
+	void AttachEngine(Node* ship);
+
+	bool IsInitialised() const { return pScene != nullptr; }
+
+	String GetDebugText() const;
+
+	// seconds an effect emits, and before its emitter may be reused
+	float emitTime;
+	float lifeTime;
+
+	// readout
+	unsigned spawned;
+	unsigned recycled;
+
+private:
+	struct Slot
+	{
+		WeakPtr<Node> node;
+		WeakPtr<ParticleEmitter> emitter;
+		float age;
+	};
+
+	ResourceCache* pRes;
+	Scene* pScene;
+	Vector<Slot> slots[MAX_EFFECT_TYPES];
+	unsigned next[MAX_EFFECT_TYPES];
+};
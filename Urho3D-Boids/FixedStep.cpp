@@ -0,0 +1,42 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include "FixedStep.h"
+
+FixedStepClock::FixedStepClock()
+{
+	step = 1.0f / 60.0f;
+	maxSteps = 5;
+
+	steps = 0;
+	droppedSteps = 0;
+
+	accumulator = 0.0f;
+}
+
+void FixedStepClock::SetRate(int hz)
+{
+	step = 1.0f / Max(hz, 1);
+}
+
+int FixedStepClock::Advance(float timeStep)
+{
+	accumulator += timeStep;
+
+	int due = (int)(accumulator / step);
+	accumulator -= due * step;
+
+	// after a long hitch run a few steps and let the rest go rather than stall every frame after it
+	if (due > maxSteps)
+	{
+		droppedSteps += due - maxSteps;
+		due = maxSteps;
+	}
+
+	steps += due;
+	return due;
+}
+
+String FixedStepClock::GetDebugText() const
+{
+	return String((int)(1.0f / step + 0.5f)) + " Hz steps " + String(steps) + " dropped " + String(droppedSteps);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <Urho3D/Container/Str.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// accumulates frame time and says how many fixed simulation steps are due, so gameplay
+// speed does not depend on the frame rate
+class FixedStepClock
+{
+public:
+	FixedStepClock();
+
+	void SetRate(int hz);
+
+	// add a frame's time, returns the steps to run now
+	int Advance(float timeStep);
+
+	// how far into the next step the frame is, 0-1
+	float GetAlpha() const { return accumulator / step; }
+
+	String GetDebugText() const;
+
+	// seconds per step, and most steps per frame before time is dropped instead of caught up
+	float step;
+	int maxSteps;
+
+	// readout
+	unsigned steps;
+	unsigned droppedSteps;
+
+private:
+	float accumulator;
+};
@@ -0,0 +1,292 @@
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#include "FrameGraph.h"
+
+// columns in the timeline chart, for the slowest frame's span
+static const int TIMELINE_WIDTH = 40;
+
+FrameGraph::FrameGraph()
+{
+	serial = false;
+
+	averageMs = 0.0f;
+	maxMs = 0.0f;
+	criticalMs = 0.0f;
+	workerUse = 0.0f;
+
+	count = 0;
+	totalUs = 0;
+	maxUs = 0;
+	frames = 0;
+	lastReport = 0.0f;
+	pendingCriticalMs = 0.0f;
+	pendingWorkerUse = 0.0f;
+}
+
+FrameGraph::~FrameGraph()
+{
+	for (unsigned i = 0; i < tasks.Size(); i++)
+	{
+		delete tasks[i];
+	}
+}
+
+void FrameGraph::Clear()
+{
+	count = 0;
+}
+
+unsigned FrameGraph::Add(const String& name, FrameTaskFunction function, void* owner, void* data, bool mainThread)
+{
+	if (count == tasks.Size())
+	{
+		tasks.Push(new FrameTask());
+	}
+	FrameTask& task = *tasks[count];
+	task.name = name;
+	task.function = function;
+	task.owner = owner;
+	task.data = data;
+	task.mainThread = mainThread;
+	task.dependencies.Clear();
+	task.graph = this;
+	return count++;
+}
+
+void FrameGraph::DependsOn(unsigned task, unsigned dependency)
+{
+	// only on one added before, so the graph cannot have a cycle
+	if (task < count && dependency < task)
+	{
+		tasks[task]->dependencies.Push(dependency);
+	}
+}
+
+void FrameGraph::Run(WorkQueue* queue)
+{
+	runTimer.Reset();
+	for (unsigned i = 0; i < count; i++)
+	{
+		FrameTask& task = *tasks[i];
+		task.started = false;
+		task.finished.store(false, std::memory_order_relaxed);
+		task.startUs = 0;
+		task.endUs = 0;
+		task.thread = 0;
+		task.critical = false;
+	}
+
+	unsigned threads = queue ? queue->GetNumThreads() : 0;
+	if (serial || threads == 0)
+	{
+		// in the order they were added, which every dependency follows
+		for (unsigned i = 0; i < count; i++)
+		{
+			tasks[i]->started = true;
+			Execute(*tasks[i], 0);
+		}
+	}
+	else
+	{
+		for (;;)
+		{
+			bool finished = true;
+			FrameTask* mainTask = nullptr;
+			FrameTask* spareTask = nullptr;
+			for (unsigned i = 0; i < count; i++)
+			{
+				FrameTask& task = *tasks[i];
+				if (!task.finished.load(std::memory_order_acquire))
+				{
+					finished = false;
+				}
+				if (task.started || !IsReady(task))
+				{
+					continue;
+				}
+				if (task.mainThread)
+				{
+					mainTask = mainTask ? mainTask : &task;
+					continue;
+				}
+				// the first ready worker task is held back in case the main thread has nothing of its own to do
+				if (!spareTask)
+				{
+					spareTask = &task;
+					continue;
+				}
+				task.started = true;
+				SharedPtr<WorkItem> item = queue->GetFreeItem();
+				item->priority_ = M_MAX_UNSIGNED;
+				item->workFunction_ = ExecuteWork;
+				item->start_ = &task;
+				queue->AddWorkItem(item);
+			}
+			if (finished)
+			{
+				break;
+			}
+
+			if (mainTask && spareTask)
+			{
+				spareTask->started = true;
+				SharedPtr<WorkItem> item = queue->GetFreeItem();
+				item->priority_ = M_MAX_UNSIGNED;
+				item->workFunction_ = ExecuteWork;
+				item->start_ = spareTask;
+				queue->AddWorkItem(item);
+				spareTask = nullptr;
+			}
+			// a Complete elsewhere leaves the workers paused
+			queue->Resume();
+
+			FrameTask* next = mainTask ? mainTask : spareTask;
+			if (next)
+			{
+				next->started = true;
+				Execute(*next, 0);
+			}
+			else
+			{
+				// everything left is on the workers or waiting for them
+				Time::Sleep(0);
+			}
+		}
+		// as Complete does, the workers wait paused until the next pass instead of polling an empty queue
+		queue->Pause();
+	}
+
+	long long spanUs = runTimer.GetUSec(false);
+	totalUs += spanUs;
+	frames++;
+	if (spanUs >= maxUs)
+	{
+		maxUs = spanUs;
+		Analyse(spanUs, threads);
+	}
+}
+
+bool FrameGraph::Report(float time)
+{
+	if (time - lastReport < 1.0f)
+	{
+		return false;
+	}
+	lastReport = time;
+
+	averageMs = frames > 0 ? totalUs / 1000.0f / frames : 0.0f;
+	maxMs = maxUs / 1000.0f;
+	criticalMs = pendingCriticalMs;
+	workerUse = pendingWorkerUse;
+	criticalPath = pendingPath;
+	slowestTimeline = pendingTimeline;
+	totalUs = 0;
+	maxUs = 0;
+	frames = 0;
+	return true;
+}
+
+String FrameGraph::GetDebugText() const
+{
+	return "avg " + String(averageMs) + " ms max " + String(maxMs) + " ms" + (serial ? " serial" : "") + ", critical path "
+		+ String(criticalMs) + " ms: " + criticalPath + ", workers busy " + String((int)(workerUse * 100.0f)) + "%";
+}
+
+bool FrameGraph::IsReady(const FrameTask& task) const
+{
+	for (unsigned i = 0; i < task.dependencies.Size(); i++)
+	{
+		if (!tasks[task.dependencies[i]]->finished.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FrameGraph::Execute(FrameTask& task, unsigned threadIndex)
+{
+	task.thread = threadIndex;
+	task.startUs = runTimer.GetUSec(false);
+	task.function(task.owner, task.data);
+	task.endUs = runTimer.GetUSec(false);
+	task.finished.store(true, std::memory_order_release);
+}
+
+void FrameGraph::ExecuteWork(const WorkItem* item, unsigned threadIndex)
+{
+	FrameTask* task = static_cast<FrameTask*>(item->start_);
+	task->graph->Execute(*task, threadIndex);
+}
+
+void FrameGraph::Analyse(long long spanUs, unsigned threads)
+{
+	long long criticalUs = 0;
+	long long workerUs = 0;
+	pendingPath.Clear();
+
+	// back from the task that finished last, each time through the dependency that finished last
+	int current = -1;
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (current < 0 || tasks[i]->endUs > tasks[current]->endUs)
+		{
+			current = i;
+		}
+	}
+	while (current >= 0)
+	{
+		FrameTask& task = *tasks[current];
+		task.critical = true;
+		criticalUs += task.endUs - task.startUs;
+		pendingPath = pendingPath.Empty() ? task.name : task.name + " > " + pendingPath;
+
+		current = -1;
+		for (unsigned i = 0; i < task.dependencies.Size(); i++)
+		{
+			unsigned dependency = task.dependencies[i];
+			if (current < 0 || tasks[dependency]->endUs > tasks[current]->endUs)
+			{
+				current = dependency;
+			}
+		}
+	}
+
+	pendingTimeline.Clear();
+	for (unsigned i = 0; i < count; i++)
+	{
+		const FrameTask& task = *tasks[i];
+		if (task.thread != 0)
+		{
+			workerUs += task.endUs - task.startUs;
+		}
+
+		int first = spanUs > 0 ? (int)(task.startUs * TIMELINE_WIDTH / spanUs) : 0;
+		int last = spanUs > 0 ? (int)(task.endUs * TIMELINE_WIDTH / spanUs) : 0;
+		first = Clamp(first, 0, TIMELINE_WIDTH - 1);
+		last = Clamp(Max(last, first + 1), 1, TIMELINE_WIDTH);
+		String bar;
+		bar.Resize(TIMELINE_WIDTH);
+		for (int j = 0; j < TIMELINE_WIDTH; j++)
+		{
+			bar[j] = j >= first && j < last ? '#' : ' ';
+		}
+
+		String name = task.name;
+		while (name.Length() < 16)
+		{
+			name += ' ';
+		}
+		String thread = task.thread == 0 ? String("main") : "w" + String(task.thread);
+		while (thread.Length() < 5)
+		{
+			thread += ' ';
+		}
+		pendingTimeline += "  " + name + thread + "|" + bar + "| " + String((task.endUs - task.startUs) / 1000.0f) + " ms"
+			+ (task.critical ? " *" : "") + "\n";
+	}
+
+	pendingCriticalMs = criticalUs / 1000.0f;
+	pendingWorkerUse = threads > 0 && spanUs > 0 ? (float)workerUs / (float)(spanUs * threads) : 0.0f;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Timer.h>
+
+#include <atomic>
+
+namespace Urho3D
+{
+	class WorkQueue;
+	struct WorkItem;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class FrameGraph;
+
+typedef void (*FrameTaskFunction)(void* owner, void* data);
+
+// one piece of a frame's work and what it waits for
+struct FrameTask
+{
+	String name;
+	FrameTaskFunction function;
+	void* owner;
+	void* data;
+	// scene, physics, UI and network calls have to stay on the main thread, the rest may go to a worker
+	bool mainThread;
+	PODVector<unsigned> dependencies;
+
+	bool started;
+	std::atomic<bool> finished;
+	// us from the start of the run, and the thread that ran it, 0 for the main thread
+	long long startUs;
+	long long endUs;
+	unsigned thread;
+	bool critical;
+
+	FrameGraph* graph;
+};
+
+// The work at the end of a frame as tasks with dependencies, run on the engine's WorkQueue. Worker tasks go to the
+// queue as soon as everything they depend on has finished; main thread tasks run here in between, and when there is
+// none the main thread takes a worker task itself rather than wait. A task only reaches the queue when the main
+// thread next looks, so a dependent of a worker task can wait behind a long main thread one.
+// Each task's span and thread is kept for the slowest frame of each second, with the critical path through it: from
+// the task that finished last back through whichever dependency held it up
+class FrameGraph
+{
+public:
+	FrameGraph();
+	~FrameGraph();
+
+	// a new frame's tasks, the last frame's are reused
+	void Clear();
+	// returns the task's index for DependsOn
+	unsigned Add(const String& name, FrameTaskFunction function, void* owner, void* data, bool mainThread = false);
+	// task starts only once dependency has finished, which has to have been added before it
+	void DependsOn(unsigned task, unsigned dependency);
+
+	// every task, returns when all have finished
+	void Run(WorkQueue* queue);
+
+	// true once a second, when the readout below has been refreshed
+	bool Report(float time);
+
+	// averages and the slowest frame's critical path, one line
+	String GetDebugText() const;
+	// the slowest frame as a chart, a line per task with its thread and span, critical tasks marked
+	String GetTimeline() const { return slowestTimeline; }
+
+	// every task in order on the main thread, to compare against
+	bool serial;
+
+	// readout, over the last second
+	float averageMs;
+	float maxMs;
+	float criticalMs;
+	// share of the worker threads' time in the slowest frame they spent on tasks
+	float workerUse;
+	String criticalPath;
+
+private:
+	bool IsReady(const FrameTask& task) const;
+	void Execute(FrameTask& task, unsigned threadIndex);
+	static void ExecuteWork(const WorkItem* item, unsigned threadIndex);
+	// the critical path of the frame just run, and its chart
+	void Analyse(long long spanUs, unsigned threads);
+
+	PODVector<FrameTask*> tasks;
+	unsigned count;
+	HiresTimer runTimer;
+
+	// this second so far
+	long long totalUs;
+	long long maxUs;
+	int frames;
+	float lastReport;
+	float pendingCriticalMs;
+	float pendingWorkerUse;
+	String pendingPath;
+	String pendingTimeline;
+	String slowestTimeline;
+};
@@ -0,0 +1,112 @@
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#include "GameMessages.h"
+
+// not sent anywhere, covers the field kinds the live messages do not use yet
+#define CHECK_SAMPLE_FIELDS(FIELD) \
+	FIELD(bool, flag, 0, 1, 1) \
+	FIELD(int, offset, -500, 500, 1) \
+	FIELD(float, heading, -180.0f, 180.0f, 0.01f) \
+	FIELD(float, health, 0.0f, 1.0f, 1.0f / 255.0f) \
+	FIELD(unsigned, wide, 0, 0xffffffffu, 1)
+DECLARE_GAME_MESSAGE(CheckSampleMessage, 0, CHECK_SAMPLE_FIELDS)
+
+static const int CHECK_ITERATIONS = 1000;
+
+double CheckValue(double minValue, double maxValue, double precision, int variant)
+{
+	if (variant == 0)
+	{
+		return minValue;
+	}
+	if (variant == 1)
+	{
+		return maxValue;
+	}
+	unsigned steps = (unsigned)((maxValue - minValue) / precision + 0.5);
+	return minValue + Floor(Random() * steps) * precision;
+}
+
+template <class T> static bool CheckMessage()
+{
+	int bitsUsed = 0;
+	for (int i = 0; i < CHECK_ITERATIONS; i++)
+	{
+		T sent;
+		sent.Fill(i);
+
+		BitWriter writer;
+		sent.Serialize(writer);
+		bitsUsed = writer.GetBitCount();
+		if (bitsUsed != T::GetBits())
+		{
+			URHO3D_LOGERROR(String(T::GetName()) + " wrote " + String(bitsUsed) + " bits, its schema says " + String(T::GetBits()));
+			return false;
+		}
+
+		T received;
+		BitReader reader(writer.GetData(), writer.GetSize());
+		String field;
+		if (!received.Deserialize(reader) || !received.Matches(sent, field))
+		{
+			URHO3D_LOGERROR(String(T::GetName()) + " did not round trip, field " + field + " pass " + String(i));
+			return false;
+		}
+
+		// a message cut short must fail rather than read zeros
+		if (writer.GetSize() > 0)
+		{
+			T truncated;
+			BitReader shortReader(writer.GetData(), writer.GetSize() - 1);
+			if (truncated.Deserialize(shortReader))
+			{
+				URHO3D_LOGERROR(String(T::GetName()) + " read from a truncated buffer, pass " + String(i));
+				return false;
+			}
+		}
+	}
+
+	T sample;
+	sample.Fill(1);
+	VectorBuffer variantBuffer;
+	variantBuffer.WriteVariantMap(sample.ToVariantMap());
+	URHO3D_LOGINFO(String(T::GetName()) + ": " + String(T::GetBits()) + " bits, " + String((T::GetBits() + 7) / 8) + " bytes, "
+		+ String(variantBuffer.GetSize()) + " bytes as a VariantMap");
+	return true;
+}
+
+bool CheckGameMessages()
+{
+	// odd widths across byte boundaries
+	BitWriter writer;
+	for (int bits = 1; bits <= 32; bits++)
+	{
+		writer.WriteBits(0xa5a5a5a5u >> (32 - bits), bits);
+	}
+	BitReader reader(writer.GetData(), writer.GetSize());
+	for (int bits = 1; bits <= 32; bits++)
+	{
+		if (reader.ReadBits(bits) != 0xa5a5a5a5u >> (32 - bits))
+		{
+			URHO3D_LOGERROR("Bit stream mismatch at width " + String(bits));
+			return false;
+		}
+	}
+	if (reader.IsOverrun() || reader.GetBitsLeft() >= 8)
+	{
+		URHO3D_LOGERROR("Bit stream length mismatch");
+		return false;
+	}
+
+	return CheckMessage<CheckSampleMessage>()
+		&& CheckMessage<ClientReadyMessage>()
+		&& CheckMessage<ObjectAuthorityMessage>()
+		&& CheckMessage<ClockPingMessage>()
+		&& CheckMessage<ClockPongMessage>()
+		&& CheckMessage<EffectMessage>()
+		&& CheckMessage<LockstepHashMessage>()
+		&& CheckMessage<ShardPlayerMessage>()
+		&& CheckMessage<ShardRedirectMessage>()
+		&& CheckMessage<ResumeTokenMessage>();
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Core/Variant.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+#include "BitStream.h"
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// A game message is declared once as a field list macro, FIELD(type, name, min, max, precision) per field,
+// see CLIENT_READY_FIELDS below. DECLARE_GAME_MESSAGE turns it into a struct with those members, bit packed
+// Serialize/Deserialize, its size in bits, and what the self check (--check-messages) needs.
+// Values outside the range are clamped when written.
+
+// min, max, or a random value between them, for the self check
+double CheckValue(double minValue, double maxValue, double precision, int variant);
+
+#define GAME_MESSAGE_MEMBER(type, name, minValue, maxValue, precision) type name;
+#define GAME_MESSAGE_WRITE(type, name, minValue, maxValue, precision) stream.WriteQuantised((double)name, minValue, maxValue, precision);
+#define GAME_MESSAGE_READ(type, name, minValue, maxValue, precision) name = (type)stream.ReadQuantised(minValue, maxValue, precision);
+#define GAME_MESSAGE_BITS(type, name, minValue, maxValue, precision) + BitsForRange(minValue, maxValue, precision)
+#define GAME_MESSAGE_FILL(type, name, minValue, maxValue, precision) name = (type)CheckValue(minValue, maxValue, precision, variant);
+#define GAME_MESSAGE_MATCH(type, name, minValue, maxValue, precision) \
+	if (Abs((double)name - (double)other.name) > precision * 0.5 + 0.0001) { field = #name; return false; }
+#define GAME_MESSAGE_VARIANT(type, name, minValue, maxValue, precision) map[StringHash(#name)] = name;
+
+#define DECLARE_GAME_MESSAGE(className, messageID, FIELDS) \
+struct className \
+{ \
+	static const int ID = messageID; \
+	static const char* GetName() { return #className; } \
+	static constexpr int GetBits() { return 0 FIELDS(GAME_MESSAGE_BITS); } \
+	FIELDS(GAME_MESSAGE_MEMBER) \
+	void Serialize(BitWriter& stream) const { FIELDS(GAME_MESSAGE_WRITE) } \
+	bool Deserialize(BitReader& stream) { FIELDS(GAME_MESSAGE_READ) return !stream.IsOverrun(); } \
+	void Fill(int variant) { FIELDS(GAME_MESSAGE_FILL) } \
+	bool Matches(const className& other, String& field) const { FIELDS(GAME_MESSAGE_MATCH) return true; } \
+	VariantMap ToVariantMap() const { VariantMap map; FIELDS(GAME_MESSAGE_VARIANT) return map; } \
+};
+
+// custom network messages, after MSG_INPUTFRAMES and the boid stream
+static const int MSG_CLIENTREADY = 0x203;
+static const int MSG_OBJECTAUTHORITY = 0x204;
+static const int MSG_CLOCKPING = 0x205;
+static const int MSG_CLOCKPONG = 0x206;
+static const int MSG_EFFECT = 0x207;
+// 0x208 and 0x209 are the lockstep start and tick, see Lockstep.h
+static const int MSG_LOCKSTEPHASH = 0x20a;
+// 0x20b and 0x20c are the shard ghosts and boid set hand offs, see Shard.h
+static const int MSG_SHARDPLAYER = 0x20d;
+static const int MSG_SHARDREDIRECT = 0x20e;
+// 0x20f is the boid stream resume, see WorldSync.h
+static const int MSG_RESUMETOKEN = 0x210;
+// 0x211 is the shard hand off ack, see Shard.h
+
+// replicated node IDs stay below FIRST_LOCAL_ID, 24 bits
+#define CLIENT_READY_FIELDS(FIELD) \
+	FIELD(unsigned, nodeID, 0, 0xffffff, 1)
+// client: pressed start, nodeID is the ship it already controls or 0 for an observer
+DECLARE_GAME_MESSAGE(ClientReadyMessage, MSG_CLIENTREADY, CLIENT_READY_FIELDS)
+
+#define OBJECT_AUTHORITY_FIELDS(FIELD) \
+	FIELD(unsigned, nodeID, 0, 0xffffff, 1)
+// server: the ship node the client controls
+DECLARE_GAME_MESSAGE(ObjectAuthorityMessage, MSG_OBJECTAUTHORITY, OBJECT_AUTHORITY_FIELDS)
+
+// times in ms, the client's wraps after 49 days
+#define CLOCK_PING_FIELDS(FIELD) \
+	FIELD(unsigned, clientTime, 0, 0xffffffffu, 1)
+// client: asks for the server's clock, sent unreliably so a resend never inflates the round trip
+DECLARE_GAME_MESSAGE(ClockPingMessage, MSG_CLOCKPING, CLOCK_PING_FIELDS)
+
+#define CLOCK_PONG_FIELDS(FIELD) \
+	FIELD(unsigned, clientTime, 0, 0xffffffffu, 1) \
+	FIELD(unsigned, serverTime, 0, 0xffffffffu, 1) \
+	FIELD(int, tickRate, 1, 240, 1)
+// server: the ping's client time echoed, the server simulation time it arrived at and the tick rate
+DECLARE_GAME_MESSAGE(ClockPongMessage, MSG_CLOCKPONG, CLOCK_PONG_FIELDS)
+
+// effect is an EffectType, the position is good to 1/16 unit over the play area
+#define EFFECT_FIELDS(FIELD) \
+	FIELD(int, effect, 0, 7, 1) \
+	FIELD(float, x, -1024.0f, 1024.0f, 1.0f / 16.0f) \
+	FIELD(float, y, -1024.0f, 1024.0f, 1.0f / 16.0f) \
+	FIELD(float, z, -1024.0f, 1024.0f, 1.0f / 16.0f)
+// server: a cosmetic effect for each peer to spawn from its own pool, sent unreliably
+DECLARE_GAME_MESSAGE(EffectMessage, MSG_EFFECT, EFFECT_FIELDS)
+
+#define LOCKSTEP_HASH_FIELDS(FIELD) \
+	FIELD(unsigned, tick, 0, 0xffffffffu, 1) \
+	FIELD(unsigned, hash, 0, 0xffffffffu, 1)
+// client: its lockstep state hash after a tick, for the server to compare with its own
+DECLARE_GAME_MESSAGE(LockstepHashMessage, MSG_LOCKSTEPHASH, LOCKSTEP_HASH_FIELDS)
+
+// the ship's position good to 1/64 unit, score and health as the HUD shows them
+#define SHARD_PLAYER_FIELDS(FIELD) \
+	FIELD(unsigned, ticketHigh, 0, 0xffffffffu, 1) \
+	FIELD(unsigned, ticketLow, 0, 0xffffffffu, 1) \
+	FIELD(float, x, -4096.0f, 4096.0f, 1.0f / 64.0f) \
+	FIELD(float, y, -4096.0f, 4096.0f, 1.0f / 64.0f) \
+	FIELD(float, z, -4096.0f, 4096.0f, 1.0f / 64.0f) \
+	FIELD(int, score, 0, 65535, 1) \
+	FIELD(int, health, -1000, 1000, 1)
+// shard: a player whose ship crossed into the neighbour's slab, its client arrives there with the ticket
+DECLARE_GAME_MESSAGE(ShardPlayerMessage, MSG_SHARDPLAYER, SHARD_PLAYER_FIELDS)
+
+#define SHARD_REDIRECT_FIELDS(FIELD) \
+	FIELD(unsigned, port, 0, 65535, 1) \
+	FIELD(unsigned, ticketHigh, 0, 0xffffffffu, 1) \
+	FIELD(unsigned, ticketLow, 0, 0xffffffffu, 1)
+// server: the client's ship is now the shard's on port, connect there with the ticket
+DECLARE_GAME_MESSAGE(ShardRedirectMessage, MSG_SHARDREDIRECT, SHARD_REDIRECT_FIELDS)
+
+#define RESUME_TOKEN_FIELDS(FIELD) \
+	FIELD(unsigned, tokenHigh, 0, 0xffffffffu, 1) \
+	FIELD(unsigned, tokenLow, 0, 0xffffffffu, 1) \
+	FIELD(int, grace, 0, 255, 1)
+// server: after a drop, reconnect within grace seconds with the token to get the same ship back
+DECLARE_GAME_MESSAGE(ResumeTokenMessage, MSG_RESUMETOKEN, RESUME_TOKEN_FIELDS)
+
+template <class T> void WriteGameMessage(const T& message, VectorBuffer& buffer)
+{
+	BitWriter stream;
+	message.Serialize(stream);
+	buffer.Clear();
+	buffer.Write(stream.GetData(), stream.GetSize());
+}
+
+// false when the data is too short for the message
+template <class T> bool ReadGameMessage(const PODVector<unsigned char>& data, T& message)
+{
+	BitReader stream(data);
+	return message.Deserialize(stream);
+}
+
+// round trips every message schema at its limits and with random values, logs the size of each against
+// the VariantMap a remote event would carry. false on the first mismatch
+bool CheckGameMessages();
@@ -0,0 +1,238 @@
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+#include "Character.h"
+#include "InputStream.h"
+
+#include <cmath>
+
+// the one extra key the client sends besides the CTRL_ buttons
+static const unsigned CTRL_EXTRA = 1024;
+static const unsigned char FRAME_EXTRA = 32;
+
+// sequence numbers wrap, compare them by their signed distance
+static int SequenceDiff(unsigned short a, unsigned short b)
+{
+	return (short)(a - b);
+}
+
+InputSender::InputSender()
+{
+	redundancy = 8;
+	sendInterval = 1.0f / 30.0f;
+
+	Reset();
+}
+
+void InputSender::Reset()
+{
+	count = 0;
+	sequence = 0;
+	sendTimer = 0.0f;
+}
+
+void InputSender::Push(const Controls& controls)
+{
+	InputFrame frame;
+	frame.sequence = sequence++;
+
+	frame.buttons = (unsigned char)(controls.buttons_ & (CTRL_FORWARD | CTRL_BACK | CTRL_LEFT | CTRL_RIGHT | CTRL_SHOOT));
+	if (controls.buttons_ & CTRL_EXTRA)
+	{
+		frame.buttons |= FRAME_EXTRA;
+	}
+
+	// yaw to 0.005 degrees, pitch is clamped to +-90 so a byte gives it 0.7 degrees
+	float yaw = fmodf(controls.yaw_, 360.0f);
+	if (yaw < 0.0f)
+	{
+		yaw += 360.0f;
+	}
+	frame.yaw = (unsigned short)((int)(yaw / 360.0f * 65536.0f + 0.5f) & 0xffff);
+	frame.pitch = (unsigned char)Clamp((int)((controls.pitch_ + 90.0f) / 180.0f * 255.0f + 0.5f), 0, 255);
+
+	// newest last, the oldest frame falls off the end
+	if (count == MAX_HISTORY)
+	{
+		for (int i = 0; i < count - 1; i++)
+		{
+			history[i] = history[i + 1];
+		}
+		count--;
+	}
+	history[count++] = frame;
+}
+
+bool InputSender::Write(float timeStep, unsigned sendTick, unsigned viewTick, VectorBuffer& message)
+{
+	sendTimer += timeStep;
+	if (sendTimer < sendInterval || count == 0)
+	{
+		return false;
+	}
+	sendTimer = Min(sendTimer - sendInterval, sendInterval);
+
+	int frames = Min(Clamp(redundancy, 1, MAX_HISTORY), count);
+	const InputFrame& newest = history[count - 1];
+
+	// newest sequence, frame count, send and view ticks, then the frames newest first
+	message.Clear();
+	message.WriteUShort(newest.sequence);
+	message.WriteUByte((unsigned char)frames);
+	message.WriteUInt(sendTick);
+	message.WriteUInt(viewTick);
+	for (int i = 0; i < frames; i++)
+	{
+		const InputFrame& frame = history[count - 1 - i];
+		message.WriteUByte(frame.buttons);
+		message.WriteUShort(frame.yaw);
+		message.WriteUByte(frame.pitch);
+	}
+
+	return true;
+}
+
+InputReceiver::InputReceiver()
+{
+	maxQueued = 8;
+	viewTick = 0;
+
+	received = 0;
+	duplicates = 0;
+	applied = 0;
+	held = 0;
+	lost = 0;
+	skipped = 0;
+	inputAge = 0.0f;
+
+	nextSequence = 0;
+	started = false;
+
+	// level, facing along the z axis, until the first frame
+	current.sequence = 0;
+	current.buttons = 0;
+	current.yaw = 0;
+	current.pitch = 128;
+}
+
+int InputReceiver::Read(MemoryBuffer& message, unsigned serverTick)
+{
+	InputMessage decoded;
+	Decode(message, decoded);
+	return Add(decoded, serverTick);
+}
+
+void InputReceiver::Decode(MemoryBuffer& message, InputMessage& decoded)
+{
+	decoded.newest = message.ReadUShort();
+	int frames = Min((int)message.ReadUByte(), InputSender::MAX_HISTORY);
+	decoded.sendTick = message.ReadUInt();
+	decoded.viewTick = message.ReadUInt();
+
+	decoded.count = 0;
+	for (int i = 0; i < frames && !message.IsEof(); i++)
+	{
+		InputFrame& frame = decoded.frames[decoded.count++];
+		frame.sequence = (unsigned short)(decoded.newest - i);
+		frame.buttons = message.ReadUByte();
+		frame.yaw = message.ReadUShort();
+		frame.pitch = message.ReadUByte();
+	}
+}
+
+int InputReceiver::Add(const InputMessage& decoded, unsigned serverTick)
+{
+	viewTick = decoded.viewTick;
+	if (decoded.sendTick != 0)
+	{
+		inputAge += ((int)(serverTick - decoded.sendTick) - inputAge) * 0.1f;
+	}
+
+	int added = 0;
+	for (int i = 0; i < decoded.count; i++)
+	{
+		const InputFrame& frame = decoded.frames[i];
+		received++;
+
+		// already applied
+		if (started && SequenceDiff(frame.sequence, nextSequence) < 0)
+		{
+			duplicates++;
+			continue;
+		}
+
+		// keep pending sorted by sequence, an equal one is a copy from an earlier message
+		unsigned insertAt = pending.Size();
+		while (insertAt > 0 && SequenceDiff(pending[insertAt - 1].sequence, frame.sequence) > 0)
+		{
+			insertAt--;
+		}
+		if (insertAt > 0 && pending[insertAt - 1].sequence == frame.sequence)
+		{
+			duplicates++;
+			continue;
+		}
+		pending.Insert(insertAt, frame);
+		added++;
+	}
+
+	return added;
+}
+
+const Controls& InputReceiver::Next()
+{
+	if (pending.Empty())
+	{
+		// nothing new, keep doing what the client last asked for
+		held++;
+		return controls;
+	}
+
+	// fallen too far behind, drop the oldest but keep any shot in them
+	unsigned char carried = 0;
+	while ((int)pending.Size() > maxQueued)
+	{
+		carried |= pending[0].buttons & CTRL_SHOOT;
+		if (started)
+		{
+			nextSequence = (unsigned short)(pending[0].sequence + 1);
+		}
+		pending.Erase(0);
+		skipped++;
+	}
+
+	InputFrame frame = pending[0];
+	pending.Erase(0);
+	frame.buttons |= carried;
+
+	// frames that never arrived in any message
+	if (started)
+	{
+		lost += Max(SequenceDiff(frame.sequence, nextSequence), 0);
+	}
+	started = true;
+	nextSequence = (unsigned short)(frame.sequence + 1);
+
+	Apply(frame);
+	applied++;
+	return controls;
+}
+
+void InputReceiver::Apply(const InputFrame& frame)
+{
+	current = frame;
+	controls.buttons_ = frame.buttons & (CTRL_FORWARD | CTRL_BACK | CTRL_LEFT | CTRL_RIGHT | CTRL_SHOOT);
+	if (frame.buttons & FRAME_EXTRA)
+	{
+		controls.buttons_ |= CTRL_EXTRA;
+	}
+	controls.yaw_ = frame.yaw * 360.0f / 65536.0f;
+	controls.pitch_ = frame.pitch * 180.0f / 255.0f - 90.0f;
+}
+
+String InputReceiver::GetDebugText() const
+{
+	return "input queued " + String(pending.Size()) + " applied " + String(applied) + " held " + String(held)
+		+ " lost " + String(lost) + " skipped " + String(skipped) + " dup " + String(duplicates) + "/" + String(received)
+		+ " age " + String(inputAge) + " ticks";
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Input/Controls.h>
+
+namespace Urho3D
+{
+	class MemoryBuffer;
+	class VectorBuffer;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// custom network message, clear of the IDs kNet and Urho3D use for their own protocol
+static const int MSG_INPUTFRAMES = 0x200;
+
+// one tick of client input, 4 bytes on the wire besides the sequence it is implied by
+struct InputFrame
+{
+	unsigned short sequence;
+	unsigned char buttons;
+	unsigned short yaw;
+	unsigned char pitch;
+};
+
+// client: keeps the newest input frames and sends them all every message, so one that
+// arrives covers the ones that were lost before it
+class InputSender
+{
+public:
+	static const int MAX_HISTORY = 32;
+
+	InputSender();
+
+	void Reset();
+
+	// record the controls for this tick
+	void Push(const Controls& controls);
+
+	// true when a message is due, it is written with the newest frames, the server tick the client thinks it is
+	// sending at and the server tick of the world it is looking at, 0 while the clock is not synced
+	bool Write(float timeStep, unsigned sendTick, unsigned viewTick, VectorBuffer& message);
+
+	// frames per message and seconds between messages
+	int redundancy;
+	float sendInterval;
+
+private:
+	InputFrame history[MAX_HISTORY];
+	int count;
+	unsigned short sequence;
+	float sendTimer;
+};
+
+// one input message unpacked, the frames newest first
+struct InputMessage
+{
+	unsigned short newest;
+	int count;
+	unsigned sendTick;
+	unsigned viewTick;
+	InputFrame frames[InputSender::MAX_HISTORY];
+};
+
+// server: frames of one connection, deduplicated and handed out one per tick in sequence order
+class InputReceiver
+{
+public:
+	// longest message an InputSender writes
+	static const unsigned MAX_MESSAGE_SIZE = 11 + InputSender::MAX_HISTORY * 4;
+
+	InputReceiver();
+
+	// unpack a message arriving at serverTick, returns how many of its frames were new
+	int Read(MemoryBuffer& message, unsigned serverTick);
+
+	// the two halves of Read, the unpacking touches nothing here so it can run on another thread
+	static void Decode(MemoryBuffer& message, InputMessage& decoded);
+	int Add(const InputMessage& decoded, unsigned serverTick);
+
+	// input for this tick, the previous one is held when nothing has arrived
+	const Controls& Next();
+
+	// the packed frame behind the controls Next returned, for lockstep, which sends it on as it came
+	const InputFrame& GetFrame() const { return current; }
+
+	String GetDebugText() const;
+
+	// most frames waiting before the oldest are skipped to keep the input latency down
+	int maxQueued;
+
+	// server tick of the boids the client had on screen with the newest frame, 0 when it did not know
+	unsigned viewTick;
+
+	// readout
+	unsigned received;
+	unsigned duplicates;
+	unsigned applied;
+	unsigned held;
+	unsigned lost;
+	unsigned skipped;
+	// ticks between the client stamping a message and it arriving, smoothed
+	float inputAge;
+
+private:
+	void Apply(const InputFrame& frame);
+
+	PODVector<InputFrame> pending;
+	Controls controls;
+	InputFrame current;
+	unsigned short nextSequence;
+	bool started;
+};
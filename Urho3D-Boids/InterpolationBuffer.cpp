@@ -0,0 +1,376 @@
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "InterpolationBuffer.h"
+
+InterpolationBuffer::InterpolationBuffer()
+{
+	count = 0;
+}
+
+Snapshot* InterpolationBuffer::FindOrInsert(float frame)
+{
+	// search from the newest end, nearly every update is for the latest frame
+	int i = count - 1;
+	while (i >= 0 && snapshots[i].frame > frame)
+	{
+		i--;
+	}
+	if (i >= 0 && snapshots[i].frame == frame)
+	{
+		return &snapshots[i];
+	}
+
+	// late packet older than anything we still hold
+	if (i < 0 && count == MAX_SNAPSHOTS)
+	{
+		return nullptr;
+	}
+
+	int insertAt = i + 1;
+	if (count == MAX_SNAPSHOTS)
+	{
+		// drop the oldest snapshot to make room
+		for (int j = 0; j < insertAt - 1; j++)
+		{
+			snapshots[j] = snapshots[j + 1];
+		}
+		insertAt--;
+	}
+	else
+	{
+		for (int j = count; j > insertAt; j--)
+		{
+			snapshots[j] = snapshots[j - 1];
+		}
+		count++;
+	}
+
+	// start from the neighbouring snapshot so a frame that only carries one attribute keeps the other
+	Snapshot& snapshot = snapshots[insertAt];
+	if (insertAt > 0)
+	{
+		snapshot = snapshots[insertAt - 1];
+	}
+	else if (insertAt + 1 < count)
+	{
+		snapshot = snapshots[insertAt + 1];
+	}
+	else
+	{
+		snapshot.position = Vector3::ZERO;
+		snapshot.rotation = Quaternion::IDENTITY;
+	}
+	snapshot.frame = frame;
+
+	return &snapshot;
+}
+
+void InterpolationBuffer::AddPosition(float frame, const Vector3& position)
+{
+	Snapshot* snapshot = FindOrInsert(frame);
+	if (snapshot)
+	{
+		snapshot->position = position;
+	}
+}
+
+void InterpolationBuffer::AddRotation(float frame, const Quaternion& rotation)
+{
+	Snapshot* snapshot = FindOrInsert(frame);
+	if (snapshot)
+	{
+		snapshot->rotation = rotation;
+	}
+}
+
+SampleResult InterpolationBuffer::Sample(float renderFrame, float latestFrame, float maxExtrapolation, Vector3& position, Quaternion& rotation) const
+{
+	if (count == 0)
+	{
+		return SAMPLE_NONE;
+	}
+
+	const Snapshot& oldest = snapshots[0];
+	const Snapshot& newest = snapshots[count - 1];
+
+	// render clock is behind everything we hold, wait on the oldest
+	if (renderFrame <= oldest.frame)
+	{
+		position = oldest.position;
+		rotation = oldest.rotation;
+		return SAMPLE_INTERPOLATED;
+	}
+
+	if (renderFrame >= newest.frame)
+	{
+		position = newest.position;
+		rotation = newest.rotation;
+
+		// the node has not changed since its last snapshot, so holding it is exact
+		if (newest.frame < latestFrame || renderFrame <= latestFrame || count < 2)
+		{
+			return SAMPLE_INTERPOLATED;
+		}
+
+		// the stream has run dry, carry on along the last known velocity for a bounded window
+		const Snapshot& previous = snapshots[count - 2];
+		float ahead = renderFrame - newest.frame;
+		Vector3 velocity = (newest.position - previous.position) / (newest.frame - previous.frame);
+		position = newest.position + velocity * Min(ahead, maxExtrapolation);
+
+		return ahead <= maxExtrapolation ? SAMPLE_EXTRAPOLATED : SAMPLE_HELD;
+	}
+
+	int i = count - 2;
+	while (i > 0 && snapshots[i].frame > renderFrame)
+	{
+		i--;
+	}
+
+	const Snapshot& from = snapshots[i];
+	const Snapshot& to = snapshots[i + 1];
+	float t = (renderFrame - from.frame) / (to.frame - from.frame);
+	position = from.position.Lerp(to.position, t);
+	rotation = from.rotation.Slerp(to.rotation, t);
+
+	return SAMPLE_INTERPOLATED;
+}
+
+int InterpolationBuffer::Depth(float renderFrame) const
+{
+	int depth = 0;
+	for (int i = count - 1; i >= 0 && snapshots[i].frame > renderFrame; i--)
+	{
+		depth++;
+	}
+	return depth;
+}
+
+SnapshotInterpolator::SnapshotInterpolator()
+{
+	minDelay = 0.05f;
+	maxDelay = 0.5f;
+	jitterScale = 3.0f;
+	maxExtrapolation = 0.25f;
+
+	Reset();
+}
+
+void SnapshotInterpolator::Reset()
+{
+	buffers.Clear();
+
+	delay = 0.1f;
+	targetDelay = 0.1f;
+	jitter = 0.0f;
+	frameInterval = 1.0f / 30.0f;
+	averageDepth = 0.0f;
+	renderFrame = 0.0f;
+	underruns = 0;
+	extrapolating = 0;
+	held = 0;
+
+	localTime = 0.0f;
+	offset = 0.0f;
+	lastOffset = 0.0f;
+	lastArrivalTime = 0.0f;
+	lastArrivalFrame = -1;
+	serverFrame = 0;
+	lastStamp = 0;
+	haveStamp = false;
+	starved = false;
+}
+
+void SnapshotInterpolator::Track(unsigned nodeID)
+{
+	if (!buffers.Contains(nodeID))
+	{
+		buffers[nodeID] = InterpolationBuffer();
+	}
+}
+
+void SnapshotInterpolator::Untrack(unsigned nodeID)
+{
+	buffers.Erase(nodeID);
+}
+
+bool SnapshotInterpolator::IsTracked(unsigned nodeID) const
+{
+	return buffers.Contains(nodeID);
+}
+
+void SnapshotInterpolator::OnPosition(unsigned nodeID, unsigned stamp, const Vector3& position)
+{
+	float frame = StampToFrame(stamp);
+	HashMap<unsigned, InterpolationBuffer>::Iterator i = buffers.Find(nodeID);
+	if (i != buffers.End())
+	{
+		i->second_.AddPosition(frame, position);
+	}
+}
+
+void SnapshotInterpolator::OnRotation(unsigned nodeID, unsigned stamp, const Quaternion& rotation)
+{
+	float frame = StampToFrame(stamp);
+	HashMap<unsigned, InterpolationBuffer>::Iterator i = buffers.Find(nodeID);
+	if (i != buffers.End())
+	{
+		i->second_.AddRotation(frame, rotation);
+	}
+}
+
+float SnapshotInterpolator::StampToFrame(unsigned stamp)
+{
+	if (!haveStamp)
+	{
+		haveStamp = true;
+		lastStamp = stamp;
+		serverFrame = 0;
+		ObserveArrival(serverFrame);
+		return 0.0f;
+	}
+
+	// the stamp is a wrapping byte, unwrap it against the newest frame seen
+	int delta = (int)((stamp - lastStamp) & 0xff);
+	if (delta == 0)
+	{
+		return (float)serverFrame;
+	}
+	if (delta < 128)
+	{
+		serverFrame += delta;
+		lastStamp = stamp;
+		ObserveArrival(serverFrame);
+		return (float)serverFrame;
+	}
+
+	// late packet from before the newest frame
+	return (float)(serverFrame - (256 - delta));
+}
+
+void SnapshotInterpolator::ObserveArrival(int frame)
+{
+	if (lastArrivalFrame >= 0 && frame > lastArrivalFrame)
+	{
+		// the client does not know the server send rate, so learn it from the arrivals
+		float perFrame = (localTime - lastArrivalTime) / (float)(frame - lastArrivalFrame);
+		frameInterval += (perFrame - frameInterval) * 0.05f;
+		frameInterval = Clamp(frameInterval, 1.0f / 120.0f, 0.5f);
+	}
+
+	float newOffset = localTime - frame * frameInterval;
+	if (lastArrivalFrame < 0)
+	{
+		offset = newOffset;
+	}
+	else
+	{
+		// RFC 3550 style jitter estimate on the transit time
+		jitter += (Abs(newOffset - lastOffset) - jitter) / 16.0f;
+
+		// follow the earliest arrivals, drifting up slowly so clock drift is still tracked
+		if (newOffset < offset)
+		{
+			offset = newOffset;
+		}
+		else
+		{
+			offset += (newOffset - offset) * 0.01f;
+		}
+	}
+
+	lastOffset = newOffset;
+	lastArrivalTime = localTime;
+	lastArrivalFrame = frame;
+}
+
+void SnapshotInterpolator::Update(float timeStep, Scene* scene)
+{
+	localTime += timeStep;
+
+	targetDelay = Clamp(frameInterval + jitter * jitterScale, minDelay, maxDelay);
+
+	// grow quickly to stop underruns, shrink slowly so the playout clock barely changes speed
+	if (delay < targetDelay)
+	{
+		delay = Min(targetDelay, delay + timeStep * 0.5f);
+	}
+	else
+	{
+		delay = Max(targetDelay, delay - timeStep * 0.05f);
+	}
+
+	if (!haveStamp || !scene)
+	{
+		return;
+	}
+
+	renderFrame = (localTime - offset - delay) / frameInterval;
+	float latestFrame = (float)serverFrame;
+	float maxExtrapolationFrames = maxExtrapolation / frameInterval;
+
+	// count each stall of the whole stream once
+	if (renderFrame > latestFrame)
+	{
+		if (!starved)
+		{
+			underruns++;
+			starved = true;
+		}
+	}
+	else
+	{
+		starved = false;
+	}
+
+	int depthTotal = 0;
+	int sampled = 0;
+	extrapolating = 0;
+	held = 0;
+
+	for (HashMap<unsigned, InterpolationBuffer>::Iterator i = buffers.Begin(); i != buffers.End(); ++i)
+	{
+		InterpolationBuffer& buffer = i->second_;
+		if (buffer.IsEmpty())
+		{
+			continue;
+		}
+
+		Node* node = scene->GetNode(i->first_);
+		if (!node)
+		{
+			continue;
+		}
+
+		Vector3 position;
+		Quaternion rotation;
+		SampleResult result = buffer.Sample(renderFrame, latestFrame, maxExtrapolationFrames, position, rotation);
+		if (result == SAMPLE_EXTRAPOLATED)
+		{
+			extrapolating++;
+		}
+		else if (result == SAMPLE_HELD)
+		{
+			held++;
+		}
+
+		depthTotal += buffer.Depth(renderFrame);
+		sampled++;
+
+		node->SetPosition(position);
+		node->SetRotation(rotation);
+	}
+
+	averageDepth = sampled > 0 ? (float)depthTotal / sampled : 0.0f;
+}
+
+String SnapshotInterpolator::GetDebugText() const
+{
+	return "delay " + String((int)(delay * 1000.0f)) + "/" + String((int)(targetDelay * 1000.0f)) + " ms"
+		+ " jitter " + String((int)(jitter * 1000.0f)) + " ms"
+		+ " depth " + String(averageDepth)
+		+ " underruns " + String(underruns)
+		+ " extrapolating " + String(extrapolating)
+		+ " held " + String(held);
+}
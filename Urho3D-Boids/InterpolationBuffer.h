@@ -0,0 +1,115 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Math/Quaternion.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+	class Node;
+	class Scene;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// one received transform of a remote node, time is measured in server network frames
+struct Snapshot
+{
+	float frame;
+	Vector3 position;
+	Quaternion rotation;
+};
+
+enum SampleResult
+{
+	SAMPLE_NONE = 0,
+	SAMPLE_INTERPOLATED,
+	SAMPLE_EXTRAPOLATED,
+	SAMPLE_HELD
+};
+
+// snapshots of one remote node, kept sorted oldest to newest
+class InterpolationBuffer
+{
+public:
+	static const int MAX_SNAPSHOTS = 16;
+
+	InterpolationBuffer();
+
+	void AddPosition(float frame, const Vector3& position);
+	void AddRotation(float frame, const Quaternion& rotation);
+
+	// sample the buffer at the render frame. latestFrame is the newest frame seen for any node, a node whose
+	// last snapshot is older than that was idle and is held rather than extrapolated
+	SampleResult Sample(float renderFrame, float latestFrame, float maxExtrapolation, Vector3& position, Quaternion& rotation) const;
+
+	// number of snapshots still ahead of the render frame
+	int Depth(float renderFrame) const;
+
+	bool IsEmpty() const { return count == 0; }
+
+private:
+	Snapshot* FindOrInsert(float frame);
+
+	Snapshot snapshots[MAX_SNAPSHOTS];
+	int count;
+};
+
+// client side playout of remote nodes with a target delay that follows the measured arrival jitter
+class SnapshotInterpolator
+{
+public:
+	SnapshotInterpolator();
+
+	void Reset();
+
+	void Track(unsigned nodeID);
+	void Untrack(unsigned nodeID);
+	bool IsTracked(unsigned nodeID) const;
+
+	// feed intercepted network attributes, stamp is the server network frame (0-255)
+	void OnPosition(unsigned nodeID, unsigned stamp, const Vector3& position);
+	void OnRotation(unsigned nodeID, unsigned stamp, const Quaternion& rotation);
+
+	// advance the playout clock and write the sampled transforms to the tracked nodes
+	void Update(float timeStep, Scene* scene);
+
+	String GetDebugText() const;
+
+	// newest server network frame received, counts up by one per server network update
+	int GetServerFrame() const { return serverFrame; }
+
+	// tuning, all in seconds
+	float minDelay;
+	float maxDelay;
+	float jitterScale;
+	float maxExtrapolation;
+
+	// readout
+	float delay;
+	float targetDelay;
+	float jitter;
+	float frameInterval;
+	float averageDepth;
+	// server frame being shown, behind GetServerFrame by the playout delay
+	float renderFrame;
+	unsigned underruns;
+	unsigned extrapolating;
+	unsigned held;
+
+private:
+	float StampToFrame(unsigned stamp);
+	void ObserveArrival(int frame);
+
+	HashMap<unsigned, InterpolationBuffer> buffers;
+
+	float localTime;
+	float offset;
+	float lastOffset;
+	float lastArrivalTime;
+	int lastArrivalFrame;
+	int serverFrame;
+	unsigned lastStamp;
+	bool haveStamp;
+	bool starved;
+};
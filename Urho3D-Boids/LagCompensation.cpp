@@ -0,0 +1,131 @@
+#include <Urho3D/Scene/Node.h>
+
+#include "LagCompensation.h"
+
+float ClosestAlongSegment(const Vector3& start, const Vector3& end, const Vector3& point)
+{
+	Vector3 direction = end - start;
+	float lengthSquared = direction.LengthSquared();
+	if (lengthSquared <= 0.0f)
+	{
+		return 0.0f;
+	}
+	return Clamp((point - start).DotProduct(direction) / lengthSquared, 0.0f, 1.0f);
+}
+
+LagCompensator::LagCompensator()
+{
+	maxRewind = 0.3f;
+
+	Reset();
+}
+
+void LagCompensator::Reset()
+{
+	newest = -1;
+	count = 0;
+
+	lastRewind = 0.0f;
+	tests = 0;
+	hits = 0;
+}
+
+void LagCompensator::Record(float time, const PODVector<Node*>& boidNodes)
+{
+	newest = (newest + 1) % MAX_FRAMES;
+	if (count < MAX_FRAMES)
+	{
+		count++;
+	}
+
+	// the slots are reused, so after the first lap recording does not allocate
+	times[newest] = time;
+	PODVector<Vector3>& frame = positions[newest];
+	frame.Resize(boidNodes.Size());
+	for (unsigned i = 0; i < boidNodes.Size(); i++)
+	{
+		frame[i] = boidNodes[i]->GetPosition();
+	}
+}
+
+void LagCompensator::Record(float time, const PODVector<Vector3>& boidPositions)
+{
+	newest = (newest + 1) % MAX_FRAMES;
+	if (count < MAX_FRAMES)
+	{
+		count++;
+	}
+
+	times[newest] = time;
+	positions[newest] = boidPositions;
+}
+
+int LagCompensator::SweepSegment(float now, float viewTime, const Vector3& start, const Vector3& end, float radius)
+{
+	if (count == 0)
+	{
+		return -1;
+	}
+
+	tests++;
+
+	viewTime = Clamp(viewTime, now - maxRewind, now);
+
+	// find the two recorded ticks either side of the view time
+	int after = newest;
+	int before = newest;
+	for (int i = 0; i < count; i++)
+	{
+		int index = (newest - i + MAX_FRAMES) % MAX_FRAMES;
+		before = index;
+		if (times[index] <= viewTime)
+		{
+			break;
+		}
+		after = index;
+	}
+
+	float t = 0.0f;
+	if (after != before && times[after] > times[before])
+	{
+		t = Clamp((viewTime - times[before]) / (times[after] - times[before]), 0.0f, 1.0f);
+	}
+	lastRewind = now - (times[before] + (times[after] - times[before]) * t);
+
+	const PODVector<Vector3>& from = positions[before];
+	const PODVector<Vector3>& to = positions[after];
+	unsigned numBoids = Min(from.Size(), to.Size());
+
+	Vector3 direction = end - start;
+	float radiusSquared = radius * radius;
+
+	int hit = -1;
+	float nearest = M_INFINITY;
+	for (unsigned i = 0; i < numBoids; i++)
+	{
+		Vector3 position = from[i].Lerp(to[i], t);
+
+		// closest point of the missile path to the rewound boid
+		float along = ClosestAlongSegment(start, end, position);
+		Vector3 closest = start + direction * along;
+		if ((position - closest).LengthSquared() < radiusSquared && along < nearest)
+		{
+			nearest = along;
+			hit = (int)i;
+		}
+	}
+
+	if (hit >= 0)
+	{
+		hits++;
+	}
+	return hit;
+}
+
+String LagCompensator::GetDebugText() const
+{
+	return "rewind " + String((int)(lastRewind * 1000.0f)) + " ms"
+		+ " history " + String(count)
+		+ " tests " + String(tests)
+		+ " hits " + String(hits);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+	class Node;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// boid and missile boxes are both about 1.5 units across
+static const float MISSILE_HIT_RADIUS = 1.5f;
+
+// how far along the segment start..end (0 to 1) its closest point to point lies, for sweeping a missile's path
+float ClosestAlongSegment(const Vector3& start, const Vector3& end, const Vector3& point);
+
+// server side history of boid positions, used to judge a remote player's shot against what they saw
+class LagCompensator
+{
+public:
+	static const int MAX_FRAMES = 64;
+
+	LagCompensator();
+
+	void Reset();
+
+	// store where every boid is at this server tick
+	void Record(float time, const PODVector<Node*>& boidNodes);
+	// the same from positions already taken, a replay's
+	void Record(float time, const PODVector<Vector3>& boidPositions);
+
+	// rewind the boids to viewTime (never further back than maxRewind from now) and sweep the segment against them,
+	// returns the index of the first boid hit along the segment or -1
+	int SweepSegment(float now, float viewTime, const Vector3& start, const Vector3& end, float radius);
+
+	String GetDebugText() const;
+
+	// longest rewind we accept, in seconds
+	float maxRewind;
+
+	// readout
+	float lastRewind;
+	unsigned tests;
+	unsigned hits;
+
+private:
+	float times[MAX_FRAMES];
+	PODVector<Vector3> positions[MAX_FRAMES];
+	int newest;
+	int count;
+};
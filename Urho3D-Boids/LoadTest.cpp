@@ -0,0 +1,779 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+
+#include "AllocationCounter.h"
+#include "Character.h"
+#include "LoadTest.h"
+
+BotPattern BotPatternFromName(const String& name)
+{
+	if (name == "circle")
+	{
+		return BOT_CIRCLE;
+	}
+	if (name == "strafe")
+	{
+		return BOT_STRAFE;
+	}
+	if (name == "probe")
+	{
+		return BOT_PROBE;
+	}
+	return BOT_RANDOM;
+}
+
+BotDriver::BotDriver()
+{
+	Initialise(0, BOT_RANDOM);
+}
+
+void BotDriver::Initialise(int id, BotPattern botPattern)
+{
+	pattern = botPattern;
+	seed = 12345u + (unsigned)id * 7919u;
+	time = 0.0f;
+	nextChange = 0.0f;
+	fireCooldown = 1.0f + id % 10 * 0.1f;
+	moveButtons = CTRL_FORWARD;
+	yawRate = 0.0f;
+	probeStarted = false;
+
+	controls.Reset();
+	// spread the bots around the compass so they do not stack up
+	controls.yaw_ = (float)(id * 37 % 360);
+}
+
+float BotDriver::NextRandom()
+{
+	seed = seed * 1103515245u + 12345u;
+	return (float)((seed >> 16) & 0x7fff) / 32767.0f;
+}
+
+const Controls& BotDriver::Update(float timeStep)
+{
+	time += timeStep;
+
+	unsigned buttons = 0;
+	switch (pattern)
+	{
+	case BOT_CIRCLE:
+		// steady forward flight around a wide circle
+		buttons = CTRL_FORWARD;
+		controls.yaw_ += 45.0f * timeStep;
+		controls.pitch_ = 0.0f;
+		break;
+
+	case BOT_STRAFE:
+		// side to side every two seconds without turning
+		buttons = ((int)(time / 2.0f) % 2 == 0) ? CTRL_LEFT : CTRL_RIGHT;
+		break;
+
+	case BOT_PROBE:
+		// alternate seconds still and straight ahead, always on the same heading
+		buttons = (int)time % 2 == 1 ? CTRL_FORWARD : 0;
+		controls.pitch_ = 0.0f;
+		break;
+
+	default:
+		// new heading, turn rate and pitch every half to two seconds
+		if (time >= nextChange)
+		{
+			moveButtons = NextRandom() < 0.7f ? CTRL_FORWARD : CTRL_BACK;
+			float side = NextRandom();
+			if (side < 0.2f)
+			{
+				moveButtons |= CTRL_LEFT;
+			}
+			else if (side < 0.4f)
+			{
+				moveButtons |= CTRL_RIGHT;
+			}
+			yawRate = (NextRandom() - 0.5f) * 120.0f;
+			controls.pitch_ = (NextRandom() - 0.5f) * 30.0f;
+			nextChange = time + 0.5f + NextRandom() * 1.5f;
+		}
+		buttons = moveButtons;
+		controls.yaw_ += yawRate * timeStep;
+		break;
+	}
+
+	// hold fire for one frame whenever the cooldown runs out
+	fireCooldown -= timeStep;
+	if (fireCooldown <= 0.0f)
+	{
+		buttons |= CTRL_SHOOT;
+		fireCooldown = pattern == BOT_RANDOM ? 0.5f + NextRandom() * 2.5f : 1.0f;
+	}
+
+	probeStarted = (buttons & CTRL_FORWARD) && pattern == BOT_PROBE && !(controls.buttons_ & CTRL_FORWARD);
+	controls.buttons_ = buttons;
+	return controls;
+}
+
+BotStats::BotStats()
+{
+	context = nullptr;
+	connected = false;
+	playable = false;
+	connectStart = 0.0f;
+	connectedAt = -1.0f;
+	sceneLoadedAt = -1.0f;
+	playableAt = -1.0f;
+	snapshotRate = 0.0f;
+	bytesInAverage = 0.0f;
+	inputLatencyMs = 0.0f;
+	inputLatencyMaxMs = 0.0f;
+	probes = 0;
+	correctionRate = 0.0f;
+	lastReport = 0.0f;
+	lastFrame = 0;
+	bytesInTotal = 0.0f;
+	bytesInSamples = 0;
+	inputLatencyTotal = 0.0f;
+	correctionsAtPlayable = 0;
+	countingSince = 0.0f;
+	probing = false;
+	probeStart = 0.0f;
+}
+
+bool BotStats::Open(Context* botContext, const String& directory, int id)
+{
+	context = botContext;
+	latestName = directory + "bot" + String(id) + ".txt";
+
+	history = new File(context, directory + "bot" + String(id) + ".csv", FILE_WRITE);
+	if (!history->IsOpen())
+	{
+		history.Reset();
+		return false;
+	}
+	history->WriteLine("time,connected,connect_ms,scene_ms,playable_ms,snapshot_hz,rtt_ms,bytes_in_per_sec,bytes_in_avg,input_ms,"
+		"input_max_ms,probes,corrections_per_sec");
+	return true;
+}
+
+void BotStats::OnConnectStart(float time)
+{
+	connectStart = time;
+	lastReport = time;
+}
+
+void BotStats::OnConnected(float time)
+{
+	connected = true;
+	connectedAt = time;
+}
+
+void BotStats::OnSceneLoaded(float time)
+{
+	sceneLoadedAt = time;
+}
+
+void BotStats::OnPlayable(float time)
+{
+	playable = true;
+	playableAt = time;
+}
+
+void BotStats::Update(float time, int serverFrame, float rtt, float bytesInPerSec, unsigned corrections)
+{
+	if (time - lastReport < 1.0f)
+	{
+		return;
+	}
+
+	snapshotRate = (serverFrame - lastFrame) / (time - lastReport);
+	lastFrame = serverFrame;
+	lastReport = time;
+
+	// the join's bootstrap would swamp the averages, they start once the bot plays
+	if (playable)
+	{
+		if (bytesInSamples == 0)
+		{
+			correctionsAtPlayable = corrections;
+			countingSince = time;
+		}
+		bytesInTotal += bytesInPerSec;
+		bytesInSamples++;
+		bytesInAverage = bytesInTotal / bytesInSamples;
+		correctionRate = time > countingSince ? (corrections - correctionsAtPlayable) / (time - countingSince) : 0.0f;
+	}
+
+	// -1 until that stage of the join has happened
+	String line = String(time - connectStart) + "," + String(connected ? 1 : 0)
+		+ "," + String(connectedAt < 0.0f ? -1 : (int)((connectedAt - connectStart) * 1000.0f))
+		+ "," + String(sceneLoadedAt < 0.0f ? -1 : (int)((sceneLoadedAt - connectStart) * 1000.0f))
+		+ "," + String(playableAt < 0.0f ? -1 : (int)((playableAt - connectStart) * 1000.0f))
+		+ "," + String(snapshotRate) + "," + String(rtt) + "," + String((int)bytesInPerSec)
+		+ "," + String((int)bytesInAverage) + "," + String(inputLatencyMs) + "," + String(inputLatencyMaxMs)
+		+ "," + String(probes) + "," + String(correctionRate);
+
+	if (history)
+	{
+		history->WriteLine(line);
+		history->Flush();
+	}
+
+	// the launcher only needs the newest line, so keep it in a file of its own
+	if (context)
+	{
+		File latest(context, latestName, FILE_WRITE);
+		if (latest.IsOpen())
+		{
+			latest.WriteLine(line);
+		}
+	}
+}
+
+void BotStats::StartProbe(float time, const Vector3& position)
+{
+	probing = true;
+	probeStart = time;
+	probePosition = position;
+}
+
+void BotStats::UpdateProbe(float time, const Vector3& position)
+{
+	// a frame or two of flight at full speed, more than the interpolation wobbles a parked ship
+	const float MOVED = 0.5f;
+	if (!probing || (position - probePosition).Length() < MOVED)
+	{
+		return;
+	}
+	probing = false;
+
+	float latencyMs = (time - probeStart) * 1000.0f;
+	probes++;
+	inputLatencyTotal += latencyMs;
+	inputLatencyMs = inputLatencyTotal / probes;
+	inputLatencyMaxMs = Max(inputLatencyMaxMs, latencyMs);
+}
+
+BotLauncher::BotLauncher()
+{
+	context = nullptr;
+	spawned = 0;
+	lastReport = 0.0f;
+	startTime = -1.0f;
+}
+
+bool BotLauncher::Initialise(Context* launcherContext, const String& statsDirectory, const String& programName)
+{
+	context = launcherContext;
+	directory = statsDirectory;
+	program = programName;
+
+	FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+	if (!fileSystem->DirExists(directory) && !fileSystem->CreateDir(directory))
+	{
+		URHO3D_LOGERROR("Could not create bot stats directory " + directory);
+		return false;
+	}
+
+	summary = new File(context, directory + "summary.csv", FILE_WRITE);
+	if (!summary->IsOpen())
+	{
+		summary.Reset();
+		return false;
+	}
+	summary->WriteLine("time,spawned,connected,playable,avg_connect_ms,max_connect_ms,avg_snapshot_hz,min_snapshot_hz,avg_rtt_ms,max_rtt_ms");
+	return true;
+}
+
+bool BotLauncher::SpawnBot(const Vector<String>& arguments)
+{
+	Vector<String> botArguments;
+	botArguments.Push("--bot");
+	botArguments.Push("--bot-id");
+	botArguments.Push(String(spawned));
+	botArguments.Push("--stats-dir");
+	botArguments.Push(directory);
+	botArguments.Push(arguments);
+
+	if (context->GetSubsystem<FileSystem>()->SystemSpawn(program, botArguments) < 0)
+	{
+		URHO3D_LOGERROR("Could not spawn bot " + String(spawned) + " from " + program);
+		return false;
+	}
+
+	spawned++;
+	return true;
+}
+
+void BotLauncher::Update(float time)
+{
+	if (startTime < 0.0f)
+	{
+		startTime = time;
+		lastReport = time;
+	}
+	if (time - lastReport < 1.0f || !summary)
+	{
+		return;
+	}
+	lastReport = time;
+
+	int connected = 0;
+	int playable = 0;
+	int reporting = 0;
+	int connectCount = 0;
+	float connectTotal = 0.0f;
+	float connectMax = 0.0f;
+	float rateTotal = 0.0f;
+	float rateMin = M_INFINITY;
+	float rttTotal = 0.0f;
+	float rttMax = 0.0f;
+
+	FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+	for (int i = 0; i < spawned; i++)
+	{
+		String name = directory + "bot" + String(i) + ".txt";
+		if (!fileSystem->FileExists(name))
+		{
+			continue;
+		}
+
+		File latest(context, name, FILE_READ);
+		Vector<String> fields = latest.ReadLine().Split(',');
+		// a bot may be halfway through rewriting its file, skip it until next time
+		if (fields.Size() < 8)
+		{
+			continue;
+		}
+
+		reporting++;
+		if (ToInt(fields[1]) != 0)
+		{
+			connected++;
+		}
+		int connectMs = ToInt(fields[2]);
+		if (connectMs >= 0)
+		{
+			connectCount++;
+			connectTotal += connectMs;
+			connectMax = Max(connectMax, (float)connectMs);
+		}
+		if (ToInt(fields[4]) >= 0)
+		{
+			playable++;
+		}
+		float rate = ToFloat(fields[5]);
+		float rtt = ToFloat(fields[6]);
+		rateTotal += rate;
+		rateMin = Min(rateMin, rate);
+		rttTotal += rtt;
+		rttMax = Max(rttMax, rtt);
+	}
+
+	String line = String((int)(time - startTime)) + "," + String(spawned) + "," + String(connected) + "," + String(playable)
+		+ "," + String(connectCount > 0 ? connectTotal / connectCount : 0.0f) + "," + String(connectMax)
+		+ "," + String(reporting > 0 ? rateTotal / reporting : 0.0f) + "," + String(reporting > 0 ? rateMin : 0.0f)
+		+ "," + String(reporting > 0 ? rttTotal / reporting : 0.0f) + "," + String(rttMax);
+	summary->WriteLine(line);
+	summary->Flush();
+
+	URHO3D_LOGINFO("Bots " + line);
+}
+
+// Limits are a baseline from runs on a development machine with the default flock, with room to spare; tighten them
+// as the netcode improves so a regression fails the suite
+static const ImpairmentProfile IMPAIRMENT_PROFILES[] =
+{
+	// name, latency ms, loss %, join ms, input to effect ms, corrections per second, KB/s
+	{ "clean", 0, 0.0f, 3000.0f, 300.0f, 2.0f, 64.0f },
+	{ "lan", 5, 0.5f, 3500.0f, 350.0f, 5.0f, 64.0f },
+	{ "broadband", 40, 1.0f, 5000.0f, 500.0f, 10.0f, 64.0f },
+	{ "mobile", 100, 3.0f, 8000.0f, 800.0f, 25.0f, 72.0f },
+	{ "congested", 150, 8.0f, 12000.0f, 1200.0f, 60.0f, 80.0f }
+};
+
+// seconds for the server to open its port, between bot spawns, and after a profile for its processes to exit
+static const float SERVER_HEAD_START = 2.0f;
+static const float BOT_SPAWN_INTERVAL = 0.25f;
+static const float PROFILE_GAP = 3.0f;
+
+// the fields a bot's latest line has to have, see BotStats::Update
+static const unsigned BOT_FIELDS = 13;
+
+static String JsonMetric(const char* name, float average, float maximum, float limit)
+{
+	return String("      \"") + name + "\": {\"avg\": " + String(average) + ", \"max\": " + String(maximum) + ", \"limit\": "
+		+ String(limit) + "},";
+}
+
+ImpairmentSuite::ImpairmentSuite()
+{
+	context = nullptr;
+	basePort = 0;
+	botCount = 0;
+	duration = 0.0f;
+	current = 0;
+	profileStart = -1.0f;
+	spawned = 0;
+	finished = false;
+}
+
+bool ImpairmentSuite::Initialise(Context* suiteContext, const String& suiteDirectory, const String& programName, unsigned short port,
+	int bots, float runDuration, const Vector<String>& arguments, const String& only)
+{
+	context = suiteContext;
+	directory = suiteDirectory;
+	program = programName;
+	basePort = port;
+	botCount = bots;
+	duration = runDuration;
+	serverArguments = arguments;
+
+	profiles.Clear();
+	for (unsigned i = 0; i < sizeof(IMPAIRMENT_PROFILES) / sizeof(IMPAIRMENT_PROFILES[0]); i++)
+	{
+		if (only.Empty() || only == IMPAIRMENT_PROFILES[i].name)
+		{
+			profiles.Push(&IMPAIRMENT_PROFILES[i]);
+		}
+	}
+	if (profiles.Empty())
+	{
+		URHO3D_LOGERROR("No impairment profile called " + only);
+		return false;
+	}
+
+	FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+	if (!fileSystem->DirExists(directory) && !fileSystem->CreateDir(directory))
+	{
+		URHO3D_LOGERROR("Could not create the impairment suite directory " + directory);
+		return false;
+	}
+	return true;
+}
+
+bool ImpairmentSuite::Update(float time)
+{
+	if (current >= profiles.Size())
+	{
+		return false;
+	}
+	if (profileStart < 0.0f)
+	{
+		StartProfile(time);
+	}
+	const ImpairmentProfile& profile = *profiles[current];
+	float elapsed = time - profileStart;
+
+	// the bots join a little apart once the server is up, like players would
+	while (spawned < botCount && elapsed >= SERVER_HEAD_START + spawned * BOT_SPAWN_INTERVAL)
+	{
+		Vector<String> arguments;
+		arguments.Push("--bot");
+		arguments.Push("--bot-id");
+		arguments.Push(String(spawned));
+		arguments.Push("--stats-dir");
+		arguments.Push(directory + profile.name + "/");
+		arguments.Push("--port");
+		arguments.Push(String(basePort + current));
+		arguments.Push("--pattern");
+		arguments.Push("probe");
+		arguments.Push("--latency");
+		arguments.Push(String(profile.latencyMs));
+		arguments.Push("--loss");
+		arguments.Push(String(profile.lossPercent));
+		arguments.Push("--exit-after");
+		arguments.Push(String(duration + PROFILE_GAP));
+		// one that fails to start shows up as a bot that never became playable
+		Spawn(arguments);
+		spawned++;
+	}
+
+	if (!finished && elapsed >= SERVER_HEAD_START + duration)
+	{
+		FinishProfile();
+		finished = true;
+	}
+	if (elapsed >= SERVER_HEAD_START + duration + PROFILE_GAP)
+	{
+		current++;
+		profileStart = -1.0f;
+	}
+	return current < profiles.Size();
+}
+
+bool ImpairmentSuite::Passed() const
+{
+	for (unsigned i = 0; i < results.Size(); i++)
+	{
+		if (!results[i].failures.Empty())
+		{
+			return false;
+		}
+	}
+	return !results.Empty();
+}
+
+bool ImpairmentSuite::WriteJson(const String& fileName) const
+{
+	File file(context, fileName, FILE_WRITE);
+	if (!file.IsOpen())
+	{
+		return false;
+	}
+
+	file.WriteLine("{");
+	file.WriteLine("  \"passed\": " + String(Passed() ? "true" : "false") + ",");
+	file.WriteLine("  \"bots\": " + String(botCount) + ",");
+	file.WriteLine("  \"duration_s\": " + String(duration) + ",");
+	file.WriteLine("  \"profiles\": [");
+	for (unsigned i = 0; i < results.Size(); i++)
+	{
+		const ImpairmentResult& result = results[i];
+		const ImpairmentProfile& profile = *result.profile;
+		file.WriteLine("    {");
+		file.WriteLine("      \"name\": \"" + String(profile.name) + "\",");
+		file.WriteLine("      \"latency_ms\": " + String(profile.latencyMs) + ",");
+		file.WriteLine("      \"loss_percent\": " + String(profile.lossPercent) + ",");
+		file.WriteLine("      \"passed\": " + String(result.failures.Empty() ? "true" : "false") + ",");
+		file.WriteLine("      \"playable\": " + String(result.playable) + ",");
+		file.WriteLine("      \"probes\": " + String(result.probes) + ",");
+		file.WriteLine(JsonMetric("join_ms", result.joinMs, result.joinMaxMs, profile.maxJoinMs));
+		file.WriteLine(JsonMetric("input_latency_ms", result.inputMs, result.inputMaxMs, profile.maxInputMs));
+		file.WriteLine(JsonMetric("corrections_per_s", result.corrections, result.correctionsMax, profile.maxCorrections));
+		file.WriteLine(JsonMetric("bandwidth_kb_per_s", result.kbPerSec, result.kbPerSecMax, profile.maxKBPerSec));
+		file.WriteLine("      \"rtt_ms\": {\"avg\": " + String(result.rttMs) + ", \"max\": " + String(result.rttMaxMs) + "},");
+		String failures;
+		for (unsigned j = 0; j < result.failures.Size(); j++)
+		{
+			failures += (j > 0 ? ", \"" : "\"") + result.failures[j] + "\"";
+		}
+		file.WriteLine("      \"failures\": [" + failures + "]");
+		file.WriteLine(i + 1 < results.Size() ? "    }," : "    }");
+	}
+	file.WriteLine("  ]");
+	file.WriteLine("}");
+	return true;
+}
+
+bool ImpairmentSuite::Spawn(const Vector<String>& arguments)
+{
+	if (context->GetSubsystem<FileSystem>()->SystemSpawn(program, arguments) < 0)
+	{
+		URHO3D_LOGERROR("Could not spawn " + program + " " + String::Joined(arguments, " "));
+		return false;
+	}
+	return true;
+}
+
+void ImpairmentSuite::StartProfile(float time)
+{
+	const ImpairmentProfile& profile = *profiles[current];
+	profileStart = time;
+	spawned = 0;
+	finished = false;
+
+	// a previous suite's bot files would pass for this run's
+	FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+	String profileDirectory = directory + profile.name + "/";
+	fileSystem->CreateDir(profileDirectory);
+	for (int i = 0; i < botCount; i++)
+	{
+		fileSystem->Delete(profileDirectory + "bot" + String(i) + ".txt");
+	}
+
+	// a port of its own, the last profile's server may not have let go of its one yet
+	Vector<String> arguments;
+	arguments.Push("--server");
+	arguments.Push("--port");
+	arguments.Push(String(basePort + current));
+	arguments.Push("--latency");
+	arguments.Push(String(profile.latencyMs));
+	arguments.Push("--loss");
+	arguments.Push(String(profile.lossPercent));
+	arguments.Push("--exit-after");
+	arguments.Push(String(SERVER_HEAD_START + duration + PROFILE_GAP));
+	arguments.Push(serverArguments);
+	Spawn(arguments);
+
+	URHO3D_LOGINFO("Impairment profile " + String(profile.name) + ": " + String(profile.latencyMs) + " ms and " + String(profile.lossPercent)
+		+ "% loss each way, " + String(botCount) + " bots for " + String(duration) + " s on port " + String(basePort + current));
+}
+
+void ImpairmentSuite::FinishProfile()
+{
+	const ImpairmentProfile& profile = *profiles[current];
+	ImpairmentResult result;
+	result.profile = &profile;
+	result.bots = botCount;
+	result.playable = 0;
+	result.joinMs = 0.0f;
+	result.joinMaxMs = 0.0f;
+	result.inputMs = 0.0f;
+	result.inputMaxMs = 0.0f;
+	result.probes = 0;
+	result.corrections = 0.0f;
+	result.correctionsMax = 0.0f;
+	result.kbPerSec = 0.0f;
+	result.kbPerSecMax = 0.0f;
+	result.rttMs = 0.0f;
+	result.rttMaxMs = 0.0f;
+
+	int measured = 0;
+	FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+	for (int i = 0; i < botCount; i++)
+	{
+		String name = directory + profile.name + "/bot" + String(i) + ".txt";
+		if (!fileSystem->FileExists(name))
+		{
+			continue;
+		}
+		File latest(context, name, FILE_READ);
+		Vector<String> fields = latest.ReadLine().Split(',');
+		if (fields.Size() < BOT_FIELDS || ToInt(fields[4]) < 0)
+		{
+			continue;
+		}
+
+		// averages over the bots that got to play, the ones that did not fail the join on their own
+		float joinMs = (float)ToInt(fields[4]);
+		float rttMs = ToFloat(fields[6]);
+		float kbPerSec = ToFloat(fields[8]) / 1024.0f;
+		float corrections = ToFloat(fields[12]);
+		result.playable++;
+		result.joinMs += joinMs;
+		result.joinMaxMs = Max(result.joinMaxMs, joinMs);
+		result.rttMs += rttMs;
+		result.rttMaxMs = Max(result.rttMaxMs, rttMs);
+		result.kbPerSec += kbPerSec;
+		result.kbPerSecMax = Max(result.kbPerSecMax, kbPerSec);
+		result.corrections += corrections;
+		result.correctionsMax = Max(result.correctionsMax, corrections);
+
+		unsigned probes = ToUInt(fields[11]);
+		if (probes > 0)
+		{
+			measured++;
+			result.probes += probes;
+			result.inputMs += ToFloat(fields[9]);
+			result.inputMaxMs = Max(result.inputMaxMs, ToFloat(fields[10]));
+		}
+	}
+	if (result.playable > 0)
+	{
+		result.joinMs /= result.playable;
+		result.rttMs /= result.playable;
+		result.kbPerSec /= result.playable;
+		result.corrections /= result.playable;
+	}
+	if (measured > 0)
+	{
+		result.inputMs /= measured;
+	}
+
+	if (result.playable < botCount)
+	{
+		result.failures.Push(String(botCount - result.playable) + " of " + String(botCount) + " bots never became playable");
+	}
+	if (result.joinMaxMs > profile.maxJoinMs)
+	{
+		result.failures.Push("slowest join " + String((int)result.joinMaxMs) + " ms over " + String((int)profile.maxJoinMs));
+	}
+	if (measured == 0)
+	{
+		result.failures.Push("no bot saw its input reach its ship");
+	}
+	else if (result.inputMs > profile.maxInputMs)
+	{
+		result.failures.Push("input to effect " + String((int)result.inputMs) + " ms over " + String((int)profile.maxInputMs));
+	}
+	if (result.corrections > profile.maxCorrections)
+	{
+		result.failures.Push("corrections " + String(result.corrections) + "/s over " + String(profile.maxCorrections));
+	}
+	if (result.kbPerSec > profile.maxKBPerSec)
+	{
+		result.failures.Push("bandwidth " + String((int)result.kbPerSec) + " KB/s over " + String((int)profile.maxKBPerSec));
+	}
+
+	String summary = "Impairment profile " + String(profile.name) + (result.failures.Empty() ? " passed" : " FAILED") + ": join avg "
+		+ String((int)result.joinMs) + " max " + String((int)result.joinMaxMs) + " ms, input to effect " + String((int)result.inputMs)
+		+ " ms over " + String(result.probes) + " probes, corrections " + String(result.corrections) + "/s, "
+		+ String((int)result.kbPerSec) + " KB/s, rtt " + String((int)result.rttMs) + " ms";
+	for (unsigned i = 0; i < result.failures.Size(); i++)
+	{
+		summary += "; " + result.failures[i];
+	}
+	if (result.failures.Empty())
+	{
+		URHO3D_LOGINFO(summary);
+	}
+	else
+	{
+		URHO3D_LOGERROR(summary);
+	}
+	results.Push(result);
+}
+
+ServerTickStats::ServerTickStats()
+{
+	averageMs = 0.0f;
+	maxMs = 0.0f;
+	averageAllocations = 0.0f;
+	maxAllocations = 0;
+	averageAllocatedBytes = 0.0f;
+	frameUsec = 0;
+	frameAllocations = 0;
+	frameAllocatedBytes = 0;
+	totalUsec = 0;
+	maxUsec = 0;
+	allocationsAtBegin = 0;
+	bytesAtBegin = 0;
+	totalAllocations = 0;
+	totalAllocatedBytes = 0;
+	peakAllocations = 0;
+	frames = 0;
+	lastReport = 0.0f;
+}
+
+void ServerTickStats::BeginFrame()
+{
+	allocationsAtBegin = GetAllocationCount();
+	bytesAtBegin = GetAllocatedBytes();
+	frameTimer.Reset();
+}
+
+void ServerTickStats::EndFrame()
+{
+	frameUsec = frameTimer.GetUSec(false);
+	frameAllocations = (unsigned)(GetAllocationCount() - allocationsAtBegin);
+	frameAllocatedBytes = (unsigned)(GetAllocatedBytes() - bytesAtBegin);
+
+	totalUsec += frameUsec;
+	maxUsec = Max(maxUsec, frameUsec);
+	totalAllocations += frameAllocations;
+	totalAllocatedBytes += frameAllocatedBytes;
+	peakAllocations = Max(peakAllocations, frameAllocations);
+	frames++;
+}
+
+bool ServerTickStats::Report(float time)
+{
+	if (time - lastReport < 1.0f)
+	{
+		return false;
+	}
+	lastReport = time;
+
+	averageMs = frames > 0 ? totalUsec / 1000.0f / frames : 0.0f;
+	maxMs = maxUsec / 1000.0f;
+	averageAllocations = frames > 0 ? (float)totalAllocations / frames : 0.0f;
+	averageAllocatedBytes = frames > 0 ? (float)totalAllocatedBytes / frames : 0.0f;
+	maxAllocations = peakAllocations;
+	totalUsec = 0;
+	maxUsec = 0;
+	totalAllocations = 0;
+	totalAllocatedBytes = 0;
+	peakAllocations = 0;
+	frames = 0;
+	return true;
+}
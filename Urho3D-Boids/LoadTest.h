@@ -0,0 +1,241 @@
+#pragma once
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+	class Context;
+	class File;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+enum BotPattern
+{
+	BOT_RANDOM = 0,
+	BOT_CIRCLE,
+	BOT_STRAFE,
+	// still for a second, then straight ahead for one, to time input to effect
+	BOT_PROBE
+};
+
+BotPattern BotPatternFromName(const String& name);
+
+// scripted or random input for a headless bot client
+class BotDriver
+{
+public:
+	BotDriver();
+
+	void Initialise(int id, BotPattern botPattern);
+
+	// advance the pattern and return the controls to send this frame
+	const Controls& Update(float timeStep);
+
+	BotPattern pattern;
+	Controls controls;
+	// probe: true on the frame the ship is first told to move
+	bool probeStarted;
+
+private:
+	// own generator so bots started together on one box do not all fly the same path
+	float NextRandom();
+
+	unsigned seed;
+	float time;
+	float nextChange;
+	float fireCooldown;
+	unsigned moveButtons;
+	float yawRate;
+};
+
+// connect timings and receive rates of one bot, written to a csv once per second
+class BotStats
+{
+public:
+	BotStats();
+
+	bool Open(Context* context, const String& directory, int id);
+
+	void OnConnectStart(float time);
+	void OnConnected(float time);
+	void OnSceneLoaded(float time);
+	void OnPlayable(float time);
+
+	// serverFrame is the newest server network frame seen, rtt in milliseconds, corrections the boid stream's so far
+	void Update(float time, int serverFrame, float rtt, float bytesInPerSec, unsigned corrections);
+
+	// input to effect: the probe started moving the ship at position, the first frame the ship is seen to have moved
+	// away from there ends it
+	void StartProbe(float time, const Vector3& position);
+	void UpdateProbe(float time, const Vector3& position);
+
+	bool connected;
+	bool playable;
+	float connectStart;
+	float connectedAt;
+	float sceneLoadedAt;
+	float playableAt;
+	float snapshotRate;
+
+	// since playable
+	float bytesInAverage;
+	float inputLatencyMs;
+	float inputLatencyMaxMs;
+	unsigned probes;
+	float correctionRate;
+
+private:
+	SharedPtr<File> history;
+	String latestName;
+	Context* context;
+	float lastReport;
+	int lastFrame;
+	float bytesInTotal;
+	int bytesInSamples;
+	float inputLatencyTotal;
+	unsigned correctionsAtPlayable;
+	float countingSince;
+	bool probing;
+	float probeStart;
+	Vector3 probePosition;
+};
+
+// spawns bot processes and folds their latest stats into one summary csv once per second
+class BotLauncher
+{
+public:
+	BotLauncher();
+
+	bool Initialise(Context* context, const String& directory, const String& program);
+
+	// start one more bot, the arguments are appended to the bot's own --bot-id and --stats-dir
+	bool SpawnBot(const Vector<String>& arguments);
+
+	void Update(float time);
+
+	int spawned;
+
+private:
+	SharedPtr<File> summary;
+	Context* context;
+	String directory;
+	String program;
+	float lastReport;
+	float startTime;
+};
+
+// one set of network conditions for the impairment suite, and the limits a run under them has to stay within
+struct ImpairmentProfile
+{
+	const char* name;
+	// added to every packet each side sends, and the share of them each side drops
+	int latencyMs;
+	float lossPercent;
+	// join is the slowest bot's connect to playable, the rest are averages over the bots
+	float maxJoinMs;
+	float maxInputMs;
+	float maxCorrections;
+	float maxKBPerSec;
+};
+
+// what the bots measured under one profile
+struct ImpairmentResult
+{
+	const ImpairmentProfile* profile;
+	int bots;
+	int playable;
+	float joinMs;
+	float joinMaxMs;
+	float inputMs;
+	float inputMaxMs;
+	unsigned probes;
+	float corrections;
+	float correctionsMax;
+	float kbPerSec;
+	float kbPerSecMax;
+	float rttMs;
+	float rttMaxMs;
+	Vector<String> failures;
+};
+
+// Runs a headless server and probe bots on localhost under each profile in turn, each side simulating the profile's
+// latency and loss in kNet, and judges every run against the profile's limits. Each profile gets a port and a stats
+// directory of its own, and its processes exit on their own when it is over
+class ImpairmentSuite
+{
+public:
+	ImpairmentSuite();
+
+	// only the named profile when only is not empty; false when there is no such profile or the directory fails
+	bool Initialise(Context* context, const String& directory, const String& program, unsigned short port, int bots,
+		float duration, const Vector<String>& serverArguments, const String& only);
+
+	// false once every profile has run
+	bool Update(float time);
+
+	bool Passed() const;
+	bool WriteJson(const String& fileName) const;
+
+	Vector<ImpairmentResult> results;
+
+private:
+	bool Spawn(const Vector<String>& arguments);
+	void StartProfile(float time);
+	void FinishProfile();
+
+	Context* context;
+	String directory;
+	String program;
+	unsigned short basePort;
+	int botCount;
+	float duration;
+	Vector<String> serverArguments;
+	PODVector<const ImpairmentProfile*> profiles;
+
+	unsigned current;
+	float profileStart;
+	int spawned;
+	bool finished;
+};
+
+// server frame time spent on work (not sleeping in the frame limiter), reported once per second
+class ServerTickStats
+{
+public:
+	ServerTickStats();
+
+	void BeginFrame();
+	void EndFrame();
+
+	// true once a second, when the averages below have been refreshed
+	bool Report(float time);
+
+	float averageMs;
+	float maxMs;
+	// operator new calls and bytes per frame, see AllocationCounter.h
+	float averageAllocations;
+	unsigned maxAllocations;
+	float averageAllocatedBytes;
+
+	// the frame that just ended
+	long long frameUsec;
+	unsigned frameAllocations;
+	unsigned frameAllocatedBytes;
+
+private:
+	HiresTimer frameTimer;
+	long long totalUsec;
+	long long maxUsec;
+	unsigned long long allocationsAtBegin;
+	unsigned long long bytesAtBegin;
+	unsigned long long totalAllocations;
+	unsigned long long totalAllocatedBytes;
+	unsigned peakAllocations;
+	int frames;
+	float lastReport;
+};
@@ -0,0 +1,678 @@
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/Compression.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Math/MathDefs.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Character.h"
+#include "DeterministicRandom.h"
+#include "Effects.h"
+#include "LagCompensation.h"
+#include "Lockstep.h"
+#include "boids.h"
+
+// the same as a ship driven by ProcessClientControls and its Missile
+static const float SHIP_SPEED = 30.0f;
+static const float MISSILE_SPEED = 500.0f;
+static const int MISSILE_TICKS = 100;
+static const Vector3 SHIP_START(0.0f, 25.0f, -100.0f);
+
+static void HashBytes(unsigned& hash, const void* data, unsigned size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (unsigned i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+}
+
+static void WriteVector3(VectorBuffer& buffer, const Vector3& value)
+{
+	buffer.WriteFloat(value.x_);
+	buffer.WriteFloat(value.y_);
+	buffer.WriteFloat(value.z_);
+}
+
+static Vector3 ReadVector3(VectorBuffer& buffer)
+{
+	Vector3 value;
+	value.x_ = buffer.ReadFloat();
+	value.y_ = buffer.ReadFloat();
+	value.z_ = buffer.ReadFloat();
+	return value;
+}
+
+LockstepSim::LockstepSim()
+{
+	tick = 0;
+	seed = 0;
+	tickRate = 60;
+	for (int i = 0; i < MAX_SLOTS; i++)
+	{
+		ships[i].present = false;
+	}
+}
+
+void LockstepSim::Start(unsigned matchSeed, int boidCount, int rate)
+{
+	tick = 0;
+	seed = matchSeed;
+	tickRate = rate;
+
+	// whole boid sets, an even number of them, the same count CreateScene makes
+	int sets = Max((boidCount + BOIDS_PER_SET * 2 - 1) / (BOIDS_PER_SET * 2) * 2, 2);
+	positions.Resize(sets * BOIDS_PER_SET);
+	velocities.Resize(sets * BOIDS_PER_SET);
+	DeterministicRandom random(seed);
+	for (unsigned i = 0; i < positions.Size(); i++)
+	{
+		boids::RandomStart(random, positions[i], velocities[i]);
+	}
+
+	for (int i = 0; i < MAX_SLOTS; i++)
+	{
+		ships[i].present = false;
+	}
+	hits.Clear();
+}
+
+void LockstepSim::Step(const PODVector<LockstepInput>& inputs)
+{
+	float step = 1.0f / tickRate;
+	tick++;
+	hits.Clear();
+
+	StepFlock(step);
+
+	// ships in slot order, a slot missing from the input set is empty from this tick on
+	unsigned next = 0;
+	for (int i = 0; i < MAX_SLOTS; i++)
+	{
+		LockstepShip& ship = ships[i];
+		if (next >= inputs.Size() || inputs[next].slot != i)
+		{
+			ship.present = false;
+			continue;
+		}
+		if (!ship.present)
+		{
+			ship.present = true;
+			ship.position = SHIP_START;
+			ship.rotation = Quaternion::IDENTITY;
+			ship.missileActive = false;
+			ship.missilePosition = Vector3::ZERO;
+			ship.missileVelocity = Vector3::ZERO;
+			ship.missileTicks = 0;
+			ship.score = 0;
+		}
+		StepShip(ship, inputs[next].frame, step);
+		next++;
+	}
+}
+
+void LockstepSim::StepFlock(float step)
+{
+	// every force from the state at the start of the tick, then every boid moves
+	forces.Resize(positions.Size());
+	for (unsigned i = 0; i < forces.Size(); i++)
+	{
+		forces[i] = Vector3::ZERO;
+	}
+
+	// half the sets steer on each tick, like UpdateBoids
+	unsigned numSets = positions.Size() / BOIDS_PER_SET;
+	unsigned half = numSets / 2;
+	unsigned firstSet = tick % 2 == 1 ? 0 : half;
+	unsigned lastSet = tick % 2 == 1 ? half : numSets;
+	for (unsigned set = firstSet; set < lastSet; set++)
+	{
+		unsigned first = set * BOIDS_PER_SET;
+		for (int i = 0; i < BOIDS_PER_SET; i++)
+		{
+			forces[first + i] = boids::FlockForce(&positions[first], &velocities[first], BOIDS_PER_SET, i);
+		}
+	}
+
+	// a boid stopped dead has no heading to speed up along, give it one from the tick's own random numbers
+	DeterministicRandom random = DeterministicRandom::ForTick(seed, tick);
+	for (unsigned i = 0; i < positions.Size(); i++)
+	{
+		Vector3& velocity = velocities[i];
+		velocity += forces[i] * step;
+		if (velocity == Vector3::ZERO)
+		{
+			velocity = Vector3(random.Float(-1.0f, 1.0f), 0.0f, random.Float(-1.0f, 1.0f));
+		}
+		boids::LimitSpeed(velocity);
+		positions[i] += velocity * step;
+		boids::LimitHeight(positions[i]);
+	}
+}
+
+void LockstepSim::StepShip(LockstepShip& ship, const InputFrame& frame, float step)
+{
+	// unpacked the way InputReceiver::Apply does, from the bytes every peer was sent
+	float yaw = frame.yaw * 360.0f / 65536.0f;
+	float pitch = frame.pitch * 180.0f / 255.0f - 90.0f;
+
+	// moves along the facing of the last tick, then turns, as the server's ships do
+	if (frame.buttons & CTRL_FORWARD)
+	{
+		ship.position += ship.rotation * (Vector3::FORWARD * SHIP_SPEED * step);
+	}
+	if (frame.buttons & CTRL_BACK)
+	{
+		ship.position += ship.rotation * (Vector3::BACK * SHIP_SPEED * step);
+	}
+	if (frame.buttons & CTRL_LEFT)
+	{
+		ship.position += ship.rotation * (Vector3::LEFT * SHIP_SPEED * step);
+	}
+	if (frame.buttons & CTRL_RIGHT)
+	{
+		ship.position += ship.rotation * (Vector3::RIGHT * SHIP_SPEED * step);
+	}
+
+	if ((frame.buttons & CTRL_SHOOT) && !ship.missileActive)
+	{
+		ship.missileActive = true;
+		ship.missilePosition = ship.position + Vector3(0.0f, 1.0f, 1.0f);
+		ship.missileVelocity = ship.rotation * Vector3::FORWARD * MISSILE_SPEED;
+		ship.missileTicks = 0;
+	}
+	else if (ship.missileActive)
+	{
+		Vector3 start = ship.missilePosition;
+		ship.missilePosition += ship.missileVelocity * step;
+		int hit = SweepMissile(start, ship.missilePosition);
+		if (hit >= 0)
+		{
+			ship.score++;
+			ship.missileActive = false;
+			hits.Push(hit);
+		}
+		else if (++ship.missileTicks >= MISSILE_TICKS)
+		{
+			ship.missileActive = false;
+		}
+	}
+
+	ship.rotation = Quaternion(pitch, yaw, 0.0f);
+}
+
+int LockstepSim::SweepMissile(const Vector3& start, const Vector3& end) const
+{
+	Vector3 direction = end - start;
+
+	// the first boid by index within reach of the path, not the nearest, so there are no ties to break
+	for (unsigned i = 0; i < positions.Size(); i++)
+	{
+		float along = ClosestAlongSegment(start, end, positions[i]);
+		if ((start + direction * along - positions[i]).LengthSquared() <= MISSILE_HIT_RADIUS * MISSILE_HIT_RADIUS)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+unsigned LockstepSim::GetHash() const
+{
+	unsigned hash = 2166136261u;
+	HashBytes(hash, &tick, sizeof tick);
+	if (!positions.Empty())
+	{
+		HashBytes(hash, &positions[0], positions.Size() * sizeof(Vector3));
+		HashBytes(hash, &velocities[0], velocities.Size() * sizeof(Vector3));
+	}
+	for (int i = 0; i < MAX_SLOTS; i++)
+	{
+		const LockstepShip& ship = ships[i];
+		if (!ship.present)
+		{
+			continue;
+		}
+		HashBytes(hash, &i, sizeof i);
+		HashBytes(hash, &ship.position, sizeof ship.position);
+		HashBytes(hash, &ship.rotation, sizeof ship.rotation);
+		HashBytes(hash, &ship.missileActive, sizeof ship.missileActive);
+		HashBytes(hash, &ship.missilePosition, sizeof ship.missilePosition);
+		HashBytes(hash, &ship.missileVelocity, sizeof ship.missileVelocity);
+		HashBytes(hash, &ship.missileTicks, sizeof ship.missileTicks);
+		HashBytes(hash, &ship.score, sizeof ship.score);
+	}
+	return hash;
+}
+
+void LockstepSim::WriteState(VectorBuffer& message) const
+{
+	// floats as they are, a rounded copy would put the joiner out of step at once
+	VectorBuffer raw;
+	raw.WriteUInt(tick);
+	raw.WriteUInt(seed);
+	raw.WriteUByte((unsigned char)tickRate);
+	raw.WriteUShort((unsigned short)positions.Size());
+	for (unsigned i = 0; i < positions.Size(); i++)
+	{
+		WriteVector3(raw, positions[i]);
+		WriteVector3(raw, velocities[i]);
+	}
+
+	unsigned char present = 0;
+	for (int i = 0; i < MAX_SLOTS; i++)
+	{
+		present += ships[i].present ? 1 : 0;
+	}
+	raw.WriteUByte(present);
+	for (int i = 0; i < MAX_SLOTS; i++)
+	{
+		const LockstepShip& ship = ships[i];
+		if (!ship.present)
+		{
+			continue;
+		}
+		raw.WriteUByte((unsigned char)i);
+		WriteVector3(raw, ship.position);
+		raw.WriteQuaternion(ship.rotation);
+		raw.WriteBool(ship.missileActive);
+		WriteVector3(raw, ship.missilePosition);
+		WriteVector3(raw, ship.missileVelocity);
+		raw.WriteInt(ship.missileTicks);
+		raw.WriteInt(ship.score);
+	}
+
+	VectorBuffer compressed = CompressVectorBuffer(raw);
+	message.Write(compressed.GetData(), compressed.GetSize());
+}
+
+bool LockstepSim::ReadState(MemoryBuffer& message)
+{
+	VectorBuffer compressed(message.GetData() + message.GetPosition(), message.GetSize() - message.GetPosition());
+	VectorBuffer raw = DecompressVectorBuffer(compressed);
+	if (raw.GetSize() == 0)
+	{
+		return false;
+	}
+
+	tick = raw.ReadUInt();
+	seed = raw.ReadUInt();
+	tickRate = Max((int)raw.ReadUByte(), 1);
+	unsigned count = raw.ReadUShort();
+	positions.Resize(count);
+	velocities.Resize(count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		positions[i] = ReadVector3(raw);
+		velocities[i] = ReadVector3(raw);
+	}
+
+	for (int i = 0; i < MAX_SLOTS; i++)
+	{
+		ships[i].present = false;
+	}
+	unsigned present = raw.ReadUByte();
+	for (unsigned i = 0; i < present && !raw.IsEof(); i++)
+	{
+		unsigned slot = raw.ReadUByte();
+		LockstepShip ship;
+		ship.present = true;
+		ship.position = ReadVector3(raw);
+		ship.rotation = raw.ReadQuaternion();
+		ship.missileActive = raw.ReadBool();
+		ship.missilePosition = ReadVector3(raw);
+		ship.missileVelocity = ReadVector3(raw);
+		ship.missileTicks = raw.ReadInt();
+		ship.score = raw.ReadInt();
+		if (slot < MAX_SLOTS)
+		{
+			ships[slot] = ship;
+		}
+	}
+	hits.Clear();
+	return true;
+}
+
+LockstepView::LockstepView()
+{
+	pRes = nullptr;
+	pScene = nullptr;
+	pEffects = nullptr;
+}
+
+void LockstepView::Initialise(ResourceCache* res, Scene* scene, EffectPool* effects)
+{
+	pRes = res;
+	pScene = scene;
+	pEffects = effects;
+}
+
+void LockstepView::Apply(const LockstepSim& sim)
+{
+	if (!pScene)
+	{
+		return;
+	}
+
+	if (boidNodes.Size() != sim.positions.Size())
+	{
+		for (unsigned i = 0; i < boidNodes.Size(); i++)
+		{
+			if (boidNodes[i])
+			{
+				boidNodes[i]->Remove();
+			}
+		}
+		boidNodes.Resize(sim.positions.Size());
+	}
+	for (unsigned i = 0; i < boidNodes.Size(); i++)
+	{
+		if (!boidNodes[i])
+		{
+			Node* node = pScene->CreateChild("boid", LOCAL);
+			StaticModel* model = node->CreateComponent<StaticModel>(LOCAL);
+			model->SetModel(pRes->GetResource<Model>("Models/Cone.mdl"));
+			model->SetMaterial(pRes->GetResource<Material>("Materials/Stone.xml"));
+			model->SetCastShadows(true);
+			boidNodes[i] = node;
+		}
+		boidNodes[i]->SetPosition(sim.positions[i]);
+		boidNodes[i]->SetRotation(boids::Heading(sim.velocities[i]));
+	}
+
+	for (int i = 0; i < LockstepSim::MAX_SLOTS; i++)
+	{
+		const LockstepShip& ship = sim.ships[i];
+		if (!ship.present)
+		{
+			if (shipNodes[i])
+			{
+				shipNodes[i]->Remove();
+			}
+			if (missileNodes[i])
+			{
+				missileNodes[i]->Remove();
+			}
+			continue;
+		}
+
+		if (!shipNodes[i] || !missileNodes[i])
+		{
+			if (shipNodes[i])
+			{
+				shipNodes[i]->Remove();
+			}
+			Node* node = pScene->CreateChild("ship", LOCAL);
+			node->SetScale(0.5f);
+			StaticModel* model = node->CreateComponent<StaticModel>(LOCAL);
+			model->SetModel(pRes->GetResource<Model>("Models/Circle.mdl"));
+			model->SetMaterial(pRes->GetResource<Material>("Materials/Jack.xml"));
+			model->SetCastShadows(true);
+			if (pEffects)
+			{
+				pEffects->AttachEngine(node);
+			}
+			shipNodes[i] = node;
+
+			Node* missile = pScene->CreateChild("missile", LOCAL);
+			missile->SetScale(1.5f);
+			StaticModel* missileModel = missile->CreateComponent<StaticModel>(LOCAL);
+			missileModel->SetModel(pRes->GetResource<Model>("Models/Torus.mdl"));
+			missileModel->SetMaterial(pRes->GetResource<Material>("Materials/Stone.xml"));
+			missileNodes[i] = missile;
+		}
+		shipNodes[i]->SetPosition(ship.position);
+		shipNodes[i]->SetRotation(ship.rotation);
+		missileNodes[i]->SetPosition(ship.missilePosition);
+		missileNodes[i]->SetEnabled(ship.missileActive);
+	}
+}
+
+void LockstepView::Clear()
+{
+	for (unsigned i = 0; i < boidNodes.Size(); i++)
+	{
+		if (boidNodes[i])
+		{
+			boidNodes[i]->Remove();
+		}
+	}
+	boidNodes.Clear();
+	for (int i = 0; i < LockstepSim::MAX_SLOTS; i++)
+	{
+		if (shipNodes[i])
+		{
+			shipNodes[i]->Remove();
+		}
+		if (missileNodes[i])
+		{
+			missileNodes[i]->Remove();
+		}
+	}
+}
+
+Node* LockstepView::GetShip(int slot) const
+{
+	return slot >= 0 && slot < LockstepSim::MAX_SLOTS ? shipNodes[slot].Get() : nullptr;
+}
+
+LockstepServer::LockstepServer()
+{
+	hashInterval = 30;
+	hashesChecked = 0;
+	desyncs = 0;
+	tickBytes = 0;
+	running = false;
+	for (int i = 0; i < HASH_HISTORY; i++)
+	{
+		hashTicks[i] = 0;
+		hashes[i] = 0;
+	}
+}
+
+void LockstepServer::Start(unsigned seed, int boidCount, int tickRate)
+{
+	sim.Start(seed, boidCount, tickRate);
+	members.Clear();
+	running = true;
+}
+
+void LockstepServer::Stop()
+{
+	members.Clear();
+	running = false;
+}
+
+void LockstepServer::Add(Connection* connection)
+{
+	if (!members.Contains(connection))
+	{
+		members[connection] = LOCKSTEP_OBSERVER;
+	}
+}
+
+int LockstepServer::AssignSlot(Connection* connection)
+{
+	int slot = GetSlot(connection);
+	if (slot != LOCKSTEP_OBSERVER)
+	{
+		return slot;
+	}
+
+	// lowest free slot, every peer steps the ships in slot order
+	bool taken[LockstepSim::MAX_SLOTS] = {};
+	for (HashMap<Connection*, int>::ConstIterator i = members.Begin(); i != members.End(); ++i)
+	{
+		if (i->second_ != LOCKSTEP_OBSERVER)
+		{
+			taken[i->second_] = true;
+		}
+	}
+	for (int i = 0; i < LockstepSim::MAX_SLOTS; i++)
+	{
+		if (!taken[i])
+		{
+			members[connection] = i;
+			return i;
+		}
+	}
+	return LOCKSTEP_OBSERVER;
+}
+
+void LockstepServer::Remove(Connection* connection)
+{
+	members.Erase(connection);
+}
+
+int LockstepServer::GetSlot(Connection* connection) const
+{
+	HashMap<Connection*, int>::ConstIterator i = members.Find(connection);
+	return i != members.End() ? i->second_ : LOCKSTEP_OBSERVER;
+}
+
+void LockstepServer::Step(HashMap<Connection*, InputReceiver>& inputs, VectorBuffer& message)
+{
+	PODVector<LockstepInput> tickInputs;
+	for (HashMap<Connection*, int>::ConstIterator i = members.Begin(); i != members.End(); ++i)
+	{
+		HashMap<Connection*, InputReceiver>::Iterator input = inputs.Find(i->first_);
+		if (i->second_ == LOCKSTEP_OBSERVER || input == inputs.End())
+		{
+			continue;
+		}
+		input->second_.Next();
+
+		LockstepInput tickInput;
+		tickInput.slot = (unsigned char)i->second_;
+		tickInput.frame = input->second_.GetFrame();
+
+		unsigned insertAt = tickInputs.Size();
+		while (insertAt > 0 && tickInputs[insertAt - 1].slot > tickInput.slot)
+		{
+			insertAt--;
+		}
+		tickInputs.Insert(insertAt, tickInput);
+	}
+
+	sim.Step(tickInputs);
+
+	int index = sim.tick % HASH_HISTORY;
+	hashTicks[index] = sim.tick;
+	hashes[index] = sim.GetHash();
+
+	// tick, then slot and the frame's 4 bytes per player, nothing per boid
+	message.Clear();
+	message.WriteUInt(sim.tick);
+	message.WriteUByte((unsigned char)tickInputs.Size());
+	for (unsigned i = 0; i < tickInputs.Size(); i++)
+	{
+		message.WriteUByte(tickInputs[i].slot);
+		message.WriteUByte(tickInputs[i].frame.buttons);
+		message.WriteUShort(tickInputs[i].frame.yaw);
+		message.WriteUByte(tickInputs[i].frame.pitch);
+	}
+	tickBytes = message.GetSize();
+}
+
+void LockstepServer::WriteStart(Connection* connection, VectorBuffer& message) const
+{
+	message.Clear();
+	message.WriteByte((signed char)GetSlot(connection));
+	message.WriteUByte((unsigned char)hashInterval);
+	sim.WriteState(message);
+}
+
+bool LockstepServer::CheckHash(unsigned tick, unsigned hash)
+{
+	int index = tick % HASH_HISTORY;
+	if (hashTicks[index] != tick)
+	{
+		return true;
+	}
+	hashesChecked++;
+	if (hashes[index] != hash)
+	{
+		desyncs++;
+		return false;
+	}
+	return true;
+}
+
+String LockstepServer::GetDebugText() const
+{
+	int players = 0;
+	for (HashMap<Connection*, int>::ConstIterator i = members.Begin(); i != members.End(); ++i)
+	{
+		players += i->second_ != LOCKSTEP_OBSERVER ? 1 : 0;
+	}
+	return "tick " + String(sim.tick) + ", " + String(players) + " players " + String(members.Size() - players) + " observers, "
+		+ String(sim.positions.Size()) + " boids, " + String(tickBytes) + " B per tick, hashes " + String(hashesChecked)
+		+ " desyncs " + String(desyncs);
+}
+
+LockstepClient::LockstepClient()
+{
+	hashInterval = 30;
+	Reset();
+}
+
+void LockstepClient::Reset()
+{
+	active = false;
+	slot = LOCKSTEP_OBSERVER;
+	starts = 0;
+	ticks = 0;
+	dropped = 0;
+}
+
+bool LockstepClient::ReadStart(MemoryBuffer& message)
+{
+	slot = message.ReadByte();
+	hashInterval = Max((int)message.ReadUByte(), 1);
+	active = sim.ReadState(message);
+	starts++;
+	return active;
+}
+
+bool LockstepClient::ReadTick(MemoryBuffer& message)
+{
+	unsigned tick = message.ReadUInt();
+	if (!active || tick != sim.tick + 1)
+	{
+		dropped++;
+		return false;
+	}
+
+	PODVector<LockstepInput> inputs;
+	unsigned count = message.ReadUByte();
+	for (unsigned i = 0; i < count && !message.IsEof(); i++)
+	{
+		LockstepInput input;
+		input.slot = message.ReadUByte();
+		input.frame.sequence = 0;
+		input.frame.buttons = message.ReadUByte();
+		input.frame.yaw = message.ReadUShort();
+		input.frame.pitch = message.ReadUByte();
+		inputs.Push(input);
+	}
+
+	sim.Step(inputs);
+	ticks++;
+	return true;
+}
+
+bool LockstepClient::IsHashDue() const
+{
+	return active && sim.tick % hashInterval == 0;
+}
+
+String LockstepClient::GetDebugText() const
+{
+	String text = "tick " + String(sim.tick) + " slot " + String(slot) + ", " + String(sim.positions.Size()) + " boids, stepped "
+		+ String(ticks) + " dropped " + String(dropped) + " starts " + String(starts);
+	return active ? text : "waiting for the match";
+}
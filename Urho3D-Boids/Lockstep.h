@@ -0,0 +1,193 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Quaternion.h>
+#include <Urho3D/Math/Vector3.h>
+
+#include "InputStream.h"
+
+namespace Urho3D
+{
+	class Connection;
+	class MemoryBuffer;
+	class Node;
+	class ResourceCache;
+	class Scene;
+	class VectorBuffer;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class EffectPool;
+
+// custom network messages, server to client, the hash goes back as a LockstepHashMessage
+static const int MSG_LOCKSTEPSTART = 0x208;
+static const int MSG_LOCKSTEPTICK = 0x209;
+
+// slot of a connection that is only watching
+static const int LOCKSTEP_OBSERVER = -1;
+
+// one player's ship and missile in the lockstep match
+struct LockstepShip
+{
+	bool present;
+	Vector3 position;
+	Quaternion rotation;
+	bool missileActive;
+	Vector3 missilePosition;
+	Vector3 missileVelocity;
+	int missileTicks;
+	int score;
+};
+
+// one tick of one player's input, exactly as the client packed it
+struct LockstepInput
+{
+	unsigned char slot;
+	InputFrame frame;
+};
+
+// The whole match as plain state, no rigid bodies, nodes or frame time: flock forces from boids::FlockForce,
+// then each ship in slot order, all in floats stepped in a fixed order at a fixed step. Peers running the same
+// build on the same kind of CPU, which a LAN match is, then compute bit identical state from the same inputs
+class LockstepSim
+{
+public:
+	static const int MAX_SLOTS = 32;
+
+	LockstepSim();
+
+	// a new match, the flock laid out from seed like CreateScene lays out the local one
+	void Start(unsigned seed, int boidCount, int rate);
+
+	// advance one tick, inputs in slot order, a slot without input this tick has left the match
+	void Step(const PODVector<LockstepInput>& inputs);
+
+	// FNV-1a over the state's raw bits, peers at the same tick with the same hash hold the same world
+	unsigned GetHash() const;
+
+	// the state bit for bit, compressed, for a joiner or a peer that has to resync
+	void WriteState(VectorBuffer& message) const;
+	bool ReadState(MemoryBuffer& message);
+
+	unsigned tick;
+	unsigned seed;
+	int tickRate;
+	PODVector<Vector3> positions;
+	PODVector<Vector3> velocities;
+	LockstepShip ships[MAX_SLOTS];
+
+	// boids hit in the last step, for effects
+	PODVector<unsigned> hits;
+
+private:
+	void StepFlock(float step);
+	void StepShip(LockstepShip& ship, const InputFrame& frame, float step);
+	int SweepMissile(const Vector3& start, const Vector3& end) const;
+
+	PODVector<Vector3> forces;
+};
+
+// peers with a window: LOCAL nodes that show a LockstepSim, nothing here is replicated
+class LockstepView
+{
+public:
+	LockstepView();
+
+	void Initialise(ResourceCache* pRes, Scene* pScene, EffectPool* pEffects);
+
+	// move the nodes to the simulation's state, making the ones it has gained
+	void Apply(const LockstepSim& sim);
+
+	// remove every node, for a disconnect, the scene clear leaves LOCAL nodes alone
+	void Clear();
+
+	// ship node of a slot, null when the slot is empty
+	Node* GetShip(int slot) const;
+
+private:
+	ResourceCache* pRes;
+	Scene* pScene;
+	EffectPool* pEffects;
+	Vector<WeakPtr<Node> > boidNodes;
+	WeakPtr<Node> shipNodes[LockstepSim::MAX_SLOTS];
+	WeakPtr<Node> missileNodes[LockstepSim::MAX_SLOTS];
+};
+
+// server: the match, the connections in it and the hashes they report back
+class LockstepServer
+{
+public:
+	static const int HASH_HISTORY = 64;
+
+	LockstepServer();
+
+	void Start(unsigned seed, int boidCount, int tickRate);
+	bool IsRunning() const { return running; }
+	void Stop();
+
+	// an observer gets every tick but has no ship
+	void Add(Connection* connection);
+	// a ship for the connection, or LOCKSTEP_OBSERVER when every slot is taken
+	int AssignSlot(Connection* connection);
+	void Remove(Connection* connection);
+	int GetSlot(Connection* connection) const;
+
+	// take one frame from each player's receiver, step the match and write the tick's input set
+	void Step(HashMap<Connection*, InputReceiver>& inputs, VectorBuffer& message);
+
+	// the match state and the connection's slot, for a joiner or after a desync
+	void WriteStart(Connection* connection, VectorBuffer& message) const;
+
+	// a peer's hash at a tick against ours, false on a desync; ticks out of the history are not judged
+	bool CheckHash(unsigned tick, unsigned hash);
+
+	String GetDebugText() const;
+
+	LockstepSim sim;
+	HashMap<Connection*, int> members;
+	// ticks between hash reports from the peers
+	int hashInterval;
+
+	// readout
+	unsigned hashesChecked;
+	unsigned desyncs;
+	unsigned tickBytes;
+
+private:
+	bool running;
+	unsigned hashTicks[HASH_HISTORY];
+	unsigned hashes[HASH_HISTORY];
+};
+
+// client: the match as the server's tick messages step it
+class LockstepClient
+{
+public:
+	LockstepClient();
+
+	void Reset();
+
+	// the match state and our slot, replaces whatever ran before
+	bool ReadStart(MemoryBuffer& message);
+
+	// one tick's input set, steps the simulation; false for a tick that does not follow on, which is dropped
+	bool ReadTick(MemoryBuffer& message);
+
+	// true when the last tick is one the server wants a hash for
+	bool IsHashDue() const;
+
+	String GetDebugText() const;
+
+	bool active;
+	int slot;
+	int hashInterval;
+	LockstepSim sim;
+
+	// readout
+	unsigned starts;
+	unsigned ticks;
+	unsigned dropped;
+};
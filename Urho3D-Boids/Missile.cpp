@@ -8,13 +8,15 @@ Missile::Missile()
 
 	timer = 0.0f;
 	active = false;
+
+	sweepValid = false;
 }
 
 Missile::~Missile()
 {
 }
 
-void Missile::Initialise(ResourceCache * pRes, Scene * pScene, Node* camera)
+void Missile::Initialise(ResourceCache * pRes, Scene * pScene, Node* camera, CreateMode physicsMode)
 {
 	pNode = pScene->CreateChild("missile");
 	pNode->SetPosition(Vector3(0.0f, 10.0f, 50.0f));
@@ -26,13 +28,14 @@ void Missile::Initialise(ResourceCache * pRes, Scene * pScene, Node* camera)
 	pObject->SetMaterial(pRes->GetResource<Material>("Materials/Stone.xml"));
 	pObject->SetCastShadows(true);
 
-	pRigidBody = pNode->CreateComponent<RigidBody>();
+	pRigidBody = pNode->CreateComponent<RigidBody>(physicsMode);
 	pRigidBody->SetMass(1.0f);
 	pRigidBody->SetUseGravity(false);
-	pRigidBody->SetPosition(camera->GetPosition());
+	// a dedicated server has no camera, Update parks the missile at the ship anyway
+	pRigidBody->SetPosition(camera ? camera->GetPosition() : Vector3::ZERO);
 	pRigidBody->SetTrigger(true);
 
-	pCollisionShape = pNode->CreateComponent<CollisionShape>();
+	pCollisionShape = pNode->CreateComponent<CollisionShape>(physicsMode);
 	pCollisionShape->SetBox(Vector3::ONE);
 
 	pObject->SetEnabled(false);
@@ -72,7 +75,7 @@ void Missile::Shoot(Vector3 direction, Node * camera, Node* player)
 	}
 	else
 	{
-		pRigidBody->SetPosition(camera->GetPosition());
+		pRigidBody->SetPosition(camera ? camera->GetPosition() : player->GetPosition());
 		pRigidBody->SetLinearVelocity(Vector3::ZERO);
 	}
 }
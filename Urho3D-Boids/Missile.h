@@ -44,11 +44,16 @@ public:
 	float timer;
 	bool active;
 
+	// server: where the missile was at the previous tick, for lag compensated hit tests
+	Vector3 sweepStart;
+	bool sweepValid;
+
 	Missile();
 
 	~Missile();
 
-	void Initialise(ResourceCache *pRes, Scene *pScene, Node* camera);
+	// physicsMode LOCAL keeps the rigid body and shape on this peer, clients then only get the model
+	void Initialise(ResourceCache *pRes, Scene *pScene, Node* camera, CreateMode physicsMode = REPLICATED);
 
 	void Update(Node* camera, Node* player);
 
@@ -0,0 +1,406 @@
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Scene/Component.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include <kNet/UDPMessageConnection.h>
+
+#include "NetworkStats.h"
+
+static const char* categoryNames[] =
+{
+	"replication",
+	"remote_events",
+	"controls",
+	"custom"
+};
+
+ConnectionStats::ConnectionStats()
+{
+	bytesIn = 0.0f;
+	bytesOut = 0.0f;
+	packetsIn = 0.0f;
+	packetsOut = 0.0f;
+	rtt = 0.0f;
+	lostPerSec = 0.0f;
+	lossRate = 0.0f;
+	queued = 0;
+
+	for (int i = 0; i < MAX_TRAFFIC_CATEGORIES; i++)
+	{
+		categoryIn[i] = 0.0f;
+		categoryOut[i] = 0.0f;
+		pendingIn[i] = 0.0f;
+		pendingOut[i] = 0.0f;
+	}
+}
+
+NetworkStats::NetworkStats()
+{
+	lastUpdate = 0.0f;
+	lastCapture = 0.0f;
+	captureArmed = false;
+}
+
+bool NetworkStats::OpenDump(Context* context, const String& fileName)
+{
+	dump = new File(context, fileName, FILE_WRITE);
+	if (!dump->IsOpen())
+	{
+		dump.Reset();
+		return false;
+	}
+	dump->WriteLine("time,connection,metric,value");
+	return true;
+}
+
+ConnectionStats& NetworkStats::GetStats(Connection* connection)
+{
+	HashMap<Connection*, ConnectionStats>::Iterator i = connections.Find(connection);
+	if (i == connections.End())
+	{
+		i = connections.Insert(MakePair(connection, ConnectionStats()));
+	}
+	return i->second_;
+}
+
+void NetworkStats::RecordRemoteEvent(Connection* connection, const String& name, const VariantMap& eventData, bool outgoing)
+{
+	if (!connection)
+	{
+		return;
+	}
+
+	// the receiving side adds the connection to the event data, it never travels
+	VariantMap payload = eventData;
+	payload.Erase(RemoteEventData::P_CONNECTION);
+
+	VectorBuffer buffer;
+	buffer.WriteStringHash(StringHash(name));
+	buffer.WriteVariantMap(payload);
+	RecordMessage(connection, TRAFFIC_REMOTE_EVENTS, name, buffer.GetSize(), outgoing);
+}
+
+void NetworkStats::RecordMessage(Connection* connection, TrafficCategory category, const String& name, unsigned bytes, bool outgoing)
+{
+	if (!connection)
+	{
+		return;
+	}
+
+	ConnectionStats& stats = GetStats(connection);
+	if (outgoing)
+	{
+		stats.pendingOut[category] += bytes;
+		stats.pendingMessagesOut[name] += bytes;
+	}
+	else
+	{
+		stats.pendingIn[category] += bytes;
+		stats.pendingMessagesIn[name] += bytes;
+	}
+}
+
+void NetworkStats::SetValue(Connection* connection, const String& name, float value)
+{
+	if (connection)
+	{
+		GetStats(connection).values[name] = value;
+	}
+}
+
+void NetworkStats::OnNetworkUpdate(Scene* scene, float time)
+{
+	if (!scene)
+	{
+		return;
+	}
+
+	// remember the replicated state once a second and diff it at the following network update,
+	// what changed in between is what that update had to send
+	if (!captureArmed)
+	{
+		if (time - lastCapture >= 1.0f)
+		{
+			CaptureState(scene, false);
+			captureArmed = true;
+			lastCapture = time;
+		}
+		return;
+	}
+
+	CaptureState(scene, true);
+	captureArmed = false;
+}
+
+void NetworkStats::CaptureState(Scene* scene, bool diff)
+{
+	if (!diff)
+	{
+		nodeState.Clear();
+		componentState.Clear();
+	}
+	pendingReplication.Clear();
+
+	PODVector<Node*> nodes;
+	scene->GetChildren(nodes, true);
+	nodes.Push(scene);
+
+	VectorBuffer buffer;
+	for (unsigned i = 0; i < nodes.Size(); i++)
+	{
+		Node* node = nodes[i];
+		if (node->GetID() >= FIRST_LOCAL_ID)
+		{
+			continue;
+		}
+
+		// the node itself and then each replicated component, same walk for both
+		const Vector<SharedPtr<Component> >& components = node->GetComponents();
+		for (int j = -1; j < (int)components.Size(); j++)
+		{
+			Serializable* object = node;
+			String typeName = "Node";
+			Vector<Variant>* state = &nodeState[node->GetID()];
+			if (j >= 0)
+			{
+				Component* component = components[j];
+				if (!component->IsReplicated())
+				{
+					continue;
+				}
+				object = component;
+				typeName = component->GetTypeName();
+				state = &componentState[component->GetID()];
+			}
+
+			const Vector<AttributeInfo>* attributes = object->GetNetworkAttributes();
+			if (!attributes)
+			{
+				continue;
+			}
+
+			bool known = state->Size() == attributes->Size();
+			state->Resize(attributes->Size());
+
+			unsigned changedBytes = 0;
+			for (unsigned k = 0; k < attributes->Size(); k++)
+			{
+				Variant value;
+				object->OnGetAttribute(attributes->At(k), value);
+				if (diff && (!known || value != state->At(k)))
+				{
+					buffer.Clear();
+					buffer.WriteVariantData(value);
+					changedBytes += buffer.GetSize();
+				}
+				state->At(k) = value;
+			}
+
+			// object ID and dirty attribute bits ride along with every changed object
+			if (changedBytes > 0)
+			{
+				pendingReplication[typeName] += changedBytes + 4;
+			}
+		}
+	}
+
+	if (diff)
+	{
+		replicationByType = pendingReplication;
+	}
+}
+
+bool NetworkStats::Update(Network* network, float time)
+{
+	float elapsed = time - lastUpdate;
+	if (elapsed < 1.0f)
+	{
+		return false;
+	}
+	lastUpdate = time;
+
+	Vector<SharedPtr<Connection> > live = network->GetClientConnections();
+	Connection* serverConnection = network->GetServerConnection();
+	if (serverConnection)
+	{
+		live.Push(SharedPtr<Connection>(serverConnection));
+	}
+
+	// forget connections that have gone
+	for (HashMap<Connection*, ConnectionStats>::Iterator i = connections.Begin(); i != connections.End();)
+	{
+		bool alive = false;
+		for (unsigned j = 0; j < live.Size(); j++)
+		{
+			if (live[j] == i->first_)
+			{
+				alive = true;
+				break;
+			}
+		}
+		if (alive)
+		{
+			++i;
+		}
+		else
+		{
+			i = connections.Erase(i);
+		}
+	}
+
+	for (unsigned i = 0; i < live.Size(); i++)
+	{
+		Connection* connection = live[i];
+		ConnectionStats& stats = GetStats(connection);
+
+		stats.address = connection->ToString();
+		stats.bytesIn = connection->GetBytesInPerSec();
+		stats.bytesOut = connection->GetBytesOutPerSec();
+		stats.packetsIn = connection->GetPacketsInPerSec();
+		stats.packetsOut = connection->GetPacketsOutPerSec();
+		stats.rtt = connection->GetRoundTripTime();
+
+		// lost datagrams are what kNet resends, Urho3D does not expose a resend count of its own
+		kNet::UDPMessageConnection* udp = dynamic_cast<kNet::UDPMessageConnection*>(connection->GetMessageConnection());
+		if (udp)
+		{
+			stats.lostPerSec = udp->PacketLossCount();
+			stats.lossRate = udp->PacketLossRate();
+		}
+		stats.queued = connection->GetMessageConnection() ? (unsigned)connection->GetMessageConnection()->NumOutboundMessagesPending() : 0;
+
+		for (int j = 0; j < MAX_TRAFFIC_CATEGORIES; j++)
+		{
+			stats.categoryIn[j] = stats.pendingIn[j] / elapsed;
+			stats.categoryOut[j] = stats.pendingOut[j] / elapsed;
+			stats.pendingIn[j] = 0.0f;
+			stats.pendingOut[j] = 0.0f;
+		}
+
+		stats.messagesIn.Clear();
+		for (HashMap<String, float>::ConstIterator j = stats.pendingMessagesIn.Begin(); j != stats.pendingMessagesIn.End(); ++j)
+		{
+			stats.messagesIn[j->first_] = j->second_ / elapsed;
+		}
+		stats.messagesOut.Clear();
+		for (HashMap<String, float>::ConstIterator j = stats.pendingMessagesOut.Begin(); j != stats.pendingMessagesOut.End(); ++j)
+		{
+			stats.messagesOut[j->first_] = j->second_ / elapsed;
+		}
+		stats.pendingMessagesIn.Clear();
+		stats.pendingMessagesOut.Clear();
+
+		// what is left after our own messages is scene replication one way and controls the other,
+		// kNet headers and acks included
+		float residualIn = Max(stats.bytesIn - stats.categoryIn[TRAFFIC_REMOTE_EVENTS] - stats.categoryIn[TRAFFIC_CUSTOM], 0.0f);
+		float residualOut = Max(stats.bytesOut - stats.categoryOut[TRAFFIC_REMOTE_EVENTS] - stats.categoryOut[TRAFFIC_CUSTOM], 0.0f);
+		bool isServerConnection = connection == serverConnection;
+		stats.categoryIn[TRAFFIC_REPLICATION] = isServerConnection ? residualIn : 0.0f;
+		stats.categoryOut[TRAFFIC_REPLICATION] = isServerConnection ? 0.0f : residualOut;
+		stats.categoryIn[TRAFFIC_CONTROLS] = isServerConnection ? 0.0f : residualIn;
+		stats.categoryOut[TRAFFIC_CONTROLS] = isServerConnection ? residualOut : 0.0f;
+	}
+
+	if (dump)
+	{
+		Dump(time);
+	}
+	return true;
+}
+
+void NetworkStats::Dump(float time)
+{
+	float replicationTotal = 0.0f;
+	for (HashMap<String, float>::ConstIterator i = replicationByType.Begin(); i != replicationByType.End(); ++i)
+	{
+		replicationTotal += i->second_;
+	}
+
+	String prefix = String(time) + ",";
+	for (HashMap<Connection*, ConnectionStats>::ConstIterator i = connections.Begin(); i != connections.End(); ++i)
+	{
+		const ConnectionStats& stats = i->second_;
+		String row = prefix + stats.address + ",";
+
+		dump->WriteLine(row + "bytes_in," + String(stats.bytesIn));
+		dump->WriteLine(row + "bytes_out," + String(stats.bytesOut));
+		dump->WriteLine(row + "packets_in," + String(stats.packetsIn));
+		dump->WriteLine(row + "packets_out," + String(stats.packetsOut));
+		dump->WriteLine(row + "rtt_ms," + String(stats.rtt));
+		dump->WriteLine(row + "lost_per_sec," + String(stats.lostPerSec));
+		dump->WriteLine(row + "loss_rate," + String(stats.lossRate));
+		dump->WriteLine(row + "queued," + String(stats.queued));
+		for (HashMap<String, float>::ConstIterator j = stats.values.Begin(); j != stats.values.End(); ++j)
+		{
+			dump->WriteLine(row + j->first_ + "," + String(j->second_));
+		}
+
+		for (int j = 0; j < MAX_TRAFFIC_CATEGORIES; j++)
+		{
+			dump->WriteLine(row + "in_" + categoryNames[j] + "," + String(stats.categoryIn[j]));
+			dump->WriteLine(row + "out_" + categoryNames[j] + "," + String(stats.categoryOut[j]));
+		}
+		for (HashMap<String, float>::ConstIterator j = stats.messagesIn.Begin(); j != stats.messagesIn.End(); ++j)
+		{
+			dump->WriteLine(row + "in_message_" + j->first_ + "," + String(j->second_));
+		}
+		for (HashMap<String, float>::ConstIterator j = stats.messagesOut.Begin(); j != stats.messagesOut.End(); ++j)
+		{
+			dump->WriteLine(row + "out_message_" + j->first_ + "," + String(j->second_));
+		}
+
+		// split the measured replication bytes by each component type's share of the sampled update
+		float replication = stats.categoryOut[TRAFFIC_REPLICATION];
+		if (replication > 0.0f && replicationTotal > 0.0f)
+		{
+			for (HashMap<String, float>::ConstIterator j = replicationByType.Begin(); j != replicationByType.End(); ++j)
+			{
+				dump->WriteLine(row + "out_replication_" + j->first_ + "," + String(replication * j->second_ / replicationTotal));
+			}
+		}
+	}
+	dump->Flush();
+}
+
+String NetworkStats::GetDebugText(Connection* connection) const
+{
+	HashMap<Connection*, ConnectionStats>::ConstIterator i = connections.Find(connection);
+	if (i == connections.End())
+	{
+		return String::EMPTY;
+	}
+
+	const ConnectionStats& stats = i->second_;
+	String text = "in " + String((int)stats.bytesIn) + " B/s (" + String((int)stats.packetsIn) + " pkt)"
+		+ " out " + String((int)stats.bytesOut) + " B/s (" + String((int)stats.packetsOut) + " pkt)"
+		+ " rtt " + String((int)stats.rtt) + " ms lost " + String(stats.lostPerSec) + "/s";
+
+	for (int j = 0; j < MAX_TRAFFIC_CATEGORIES; j++)
+	{
+		float bytes = stats.categoryIn[j] + stats.categoryOut[j];
+		if (bytes > 0.0f)
+		{
+			text += String(" ") + categoryNames[j] + " " + String((int)bytes);
+		}
+	}
+
+	if (stats.categoryOut[TRAFFIC_REPLICATION] > 0.0f)
+	{
+		float replicationTotal = 0.0f;
+		for (HashMap<String, float>::ConstIterator j = replicationByType.Begin(); j != replicationByType.End(); ++j)
+		{
+			replicationTotal += j->second_;
+		}
+		for (HashMap<String, float>::ConstIterator j = replicationByType.Begin(); j != replicationByType.End() && replicationTotal > 0.0f; ++j)
+		{
+			text += " " + j->first_ + " " + String((int)(j->second_ * 100.0f / replicationTotal)) + "%";
+		}
+	}
+
+	return text;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Core/Variant.h>
+
+namespace Urho3D
+{
+	class Connection;
+	class Context;
+	class File;
+	class Network;
+	class Scene;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+enum TrafficCategory
+{
+	TRAFFIC_REPLICATION = 0,
+	TRAFFIC_REMOTE_EVENTS,
+	TRAFFIC_CONTROLS,
+	TRAFFIC_CUSTOM,
+	MAX_TRAFFIC_CATEGORIES
+};
+
+// traffic counters of one connection, rates are per second
+struct ConnectionStats
+{
+	ConnectionStats();
+
+	String address;
+	float bytesIn;
+	float bytesOut;
+	float packetsIn;
+	float packetsOut;
+	float rtt;
+	float lostPerSec;
+	float lossRate;
+	// kNet messages waiting to go out, grows when the link cannot keep up
+	unsigned queued;
+
+	// bytes attributed to each category, accumulated over the current second then turned into a rate
+	float categoryIn[MAX_TRAFFIC_CATEGORIES];
+	float categoryOut[MAX_TRAFFIC_CATEGORIES];
+	HashMap<String, float> messagesIn;
+	HashMap<String, float> messagesOut;
+	// anything else worth a row in the dump, set by whoever owns it
+	HashMap<String, float> values;
+
+	float pendingIn[MAX_TRAFFIC_CATEGORIES];
+	float pendingOut[MAX_TRAFFIC_CATEGORIES];
+	HashMap<String, float> pendingMessagesIn;
+	HashMap<String, float> pendingMessagesOut;
+};
+
+// per connection network counters broken down by message type, shown in the debug HUD and optionally dumped once per second
+class NetworkStats
+{
+public:
+	NetworkStats();
+
+	bool OpenDump(Context* context, const String& fileName);
+
+	// our own traffic, recorded where it is sent or handled
+	void RecordRemoteEvent(Connection* connection, const String& name, const VariantMap& eventData, bool outgoing);
+	void RecordMessage(Connection* connection, TrafficCategory category, const String& name, unsigned bytes, bool outgoing);
+	void SetValue(Connection* connection, const String& name, float value);
+
+	// server: diff the replicated state once per second to see what replication is spent on
+	void OnNetworkUpdate(Scene* scene, float time);
+
+	// refresh the rates once per second, returns true when it did
+	bool Update(Network* network, float time);
+
+	String GetDebugText(Connection* connection) const;
+
+	HashMap<Connection*, ConnectionStats> connections;
+	// estimated replication bytes per network update, by component type ("Node" for the node itself)
+	HashMap<String, float> replicationByType;
+
+private:
+	ConnectionStats& GetStats(Connection* connection);
+	void CaptureState(Scene* scene, bool diff);
+	void Dump(float time);
+
+	SharedPtr<File> dump;
+	HashMap<unsigned, Vector<Variant> > nodeState;
+	HashMap<unsigned, Vector<Variant> > componentState;
+	HashMap<String, float> pendingReplication;
+	float lastUpdate;
+	float lastCapture;
+	bool captureArmed;
+};
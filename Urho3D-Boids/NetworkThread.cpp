@@ -0,0 +1,153 @@
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#include "Broadcast.h"
+#include "NetworkThread.h"
+
+#include <cstring>
+
+void EncodeJob::Write()
+{
+	for (int i = 0; i < feedCount; i++)
+	{
+		messages[i] = feeds[i]->Write(update, positions, velocities, time);
+	}
+}
+
+NetworkThread::NetworkThread() :
+	inputsDecoded(0),
+	inputsOverflowed(0),
+	updatesEncoded(0)
+{
+	applyBudget = 256;
+
+	late = 0;
+	waits = 0;
+
+	inputsDropped = 0;
+	inputLatencyMs = 0.0f;
+	inputLatencyPeakMs = 0.0f;
+	encodeLatencyMs = 0.0f;
+	encodeLatencyPeakMs = 0.0f;
+}
+
+NetworkThread::~NetworkThread()
+{
+	// before the queues go, the base class would only stop it after
+	Stop();
+}
+
+bool NetworkThread::PushInput(Connection* connection, unsigned serial, const PODVector<unsigned char>& data)
+{
+	if (data.Size() > InputReceiver::MAX_MESSAGE_SIZE)
+	{
+		inputsDropped++;
+		return false;
+	}
+
+	RawInput raw;
+	raw.connection = connection;
+	raw.serial = serial;
+	raw.queuedUs = clock.GetUSec(false);
+	raw.size = data.Size();
+	memcpy(raw.data, data.Buffer(), data.Size());
+	if (!received.Push(raw))
+	{
+		inputsDropped++;
+		return false;
+	}
+	return true;
+}
+
+bool NetworkThread::PopInput(DecodedInput& input)
+{
+	if (!decoded.Pop(input))
+	{
+		return false;
+	}
+
+	float latencyMs = (clock.GetUSec(false) - input.queuedUs) / 1000.0f;
+	inputLatencyMs += (latencyMs - inputLatencyMs) * 0.1f;
+	inputLatencyPeakMs = Max(inputLatencyPeakMs, latencyMs);
+	return true;
+}
+
+bool NetworkThread::PushEncode(EncodeJob* job)
+{
+	job->queuedUs = clock.GetUSec(false);
+	return jobs.Push(job);
+}
+
+EncodeJob* NetworkThread::PopEncoded()
+{
+	EncodeJob* job = nullptr;
+	if (!encoded.Pop(job))
+	{
+		return nullptr;
+	}
+
+	float latencyMs = (clock.GetUSec(false) - job->queuedUs) / 1000.0f;
+	encodeLatencyMs += (latencyMs - encodeLatencyMs) * 0.1f;
+	encodeLatencyPeakMs = Max(encodeLatencyPeakMs, latencyMs);
+	return job;
+}
+
+void NetworkThread::ResetPeaks()
+{
+	inputLatencyPeakMs = 0.0f;
+	encodeLatencyPeakMs = 0.0f;
+}
+
+String NetworkThread::GetDebugText() const
+{
+	return "input queued " + String(received.Size()) + "+" + String(decoded.Size()) + " peak " + String(received.GetPeak()) + "+"
+		+ String(decoded.GetPeak()) + " of " + String(received.GetCapacity()) + ", decoded " + String(inputsDecoded.load())
+		+ " dropped " + String(inputsDropped + inputsOverflowed.load()) + ", latency " + String(inputLatencyMs) + " ms peak "
+		+ String(inputLatencyPeakMs) + " ms; updates encoded " + String(updatesEncoded.load()) + " queued " + String(jobs.Size())
+		+ " late " + String(late) + " waits " + String(waits) + ", latency " + String(encodeLatencyMs) + " ms peak "
+		+ String(encodeLatencyPeakMs) + " ms";
+}
+
+void NetworkThread::ThreadFunction()
+{
+	while (shouldRun_)
+	{
+		bool idle = true;
+
+		// inputs first, they are small and the simulation wants them soonest
+		RawInput raw;
+		while (received.Pop(raw))
+		{
+			DecodedInput input;
+			input.connection = raw.connection;
+			input.serial = raw.serial;
+			input.queuedUs = raw.queuedUs;
+			MemoryBuffer message(raw.data, raw.size);
+			InputReceiver::Decode(message, input.message);
+
+			// every message repeats the frames before it, one lost here is covered by the next
+			if (!decoded.Push(input))
+			{
+				inputsOverflowed++;
+			}
+			inputsDecoded++;
+			idle = false;
+		}
+
+		// one room at a time, so inputs that arrive meanwhile do not wait behind every room's flock
+		EncodeJob* job = nullptr;
+		if (jobs.Pop(job))
+		{
+			job->Write();
+			updatesEncoded += job->feedCount;
+			// one job in flight per room, and no more rooms than it holds
+			encoded.Push(job);
+			idle = false;
+		}
+
+		if (idle)
+		{
+			Time::Sleep(1);
+		}
+	}
+}
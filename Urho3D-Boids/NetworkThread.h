@@ -0,0 +1,121 @@
+#pragma once
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Thread.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Math/Vector3.h>
+
+#include "InputStream.h"
+#include "RateControl.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+
+namespace Urho3D
+{
+	class Connection;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class BroadcastGroup;
+class Room;
+class SharedMessage;
+
+// an input message as it arrived, copied out of the engine's buffer
+struct RawInput
+{
+	Connection* connection;
+	unsigned serial;
+	long long queuedUs;
+	unsigned size;
+	unsigned char data[InputReceiver::MAX_MESSAGE_SIZE];
+};
+
+// its frames, ready for the connection's InputReceiver. The connection may have gone by the time it is applied,
+// it is only ever looked up, never dereferenced, and only counts while the connection still has its serial: a
+// connection made since can have the same address
+struct DecodedInput
+{
+	Connection* connection;
+	unsigned serial;
+	long long queuedUs;
+	InputMessage message;
+};
+
+// one network update of one room: the flock captured on the main thread, the feeds due and what each wrote from it
+struct EncodeJob
+{
+	static const int MAX_FEEDS = RATE_TIERS + 1;
+
+	Room* room;
+	unsigned update;
+	float time;
+	long long queuedUs;
+	PODVector<Vector3> positions;
+	PODVector<Vector3> velocities;
+	int feedCount;
+	BroadcastGroup* feeds[MAX_FEEDS];
+	SharedMessage* messages[MAX_FEEDS];
+
+	// each feed writes its update from the captured flock, on whichever thread has the job
+	void Write();
+};
+
+// Dedicated server: the work between the sockets and the simulation, off the main thread. kNet already reads and
+// writes the sockets on a thread of its own, but the engine hands every message to the main thread, and sends from
+// it, so what is left to move is the decode and the encode. Input messages are copied in as they are handled and
+// come back decoded for the start of the next frame, which takes at most applyBudget of them for all rooms so a
+// burst is spread over frames rather than stalling one. Each room's flock is captured once per network update and
+// its boid feeds write their updates here; the main thread sends them as soon as it next looks.
+// Each queue has one producer and one consumer, lock free, so neither side ever waits on the other
+class NetworkThread : public Thread
+{
+public:
+	NetworkThread();
+	~NetworkThread();
+
+	// main thread: false when the message was dropped, too long for an input message or the queue is full
+	bool PushInput(Connection* connection, unsigned serial, const PODVector<unsigned char>& data);
+	// main thread: the next decoded message, false when there is none
+	bool PopInput(DecodedInput& input);
+
+	// main thread: the job is left alone until PopEncoded hands it back; false when the queue is full
+	bool PushEncode(EncodeJob* job);
+	// main thread: a job whose feeds have written their updates, null when none is done
+	EncodeJob* PopEncoded();
+
+	// peaks start over, after each report
+	void ResetPeaks();
+
+	String GetDebugText() const;
+
+	virtual void ThreadFunction();
+
+	// decoded input messages a frame takes, the rest wait for the next
+	int applyBudget;
+
+	// readout, main thread: updates a room skipped because the last was still being written, and times the main
+	// thread had to wait for one to touch a feed
+	unsigned late;
+	unsigned waits;
+
+private:
+	SpscQueue<RawInput, 256> received;
+	SpscQueue<DecodedInput, 256> decoded;
+	SpscQueue<EncodeJob*, 64> jobs;
+	SpscQueue<EncodeJob*, 64> encoded;
+
+	// main thread, stamps and latencies
+	HiresTimer clock;
+	unsigned inputsDropped;
+	float inputLatencyMs;
+	float inputLatencyPeakMs;
+	float encodeLatencyMs;
+	float encodeLatencyPeakMs;
+
+	// network thread
+	std::atomic<unsigned> inputsDecoded;
+	std::atomic<unsigned> inputsOverflowed;
+	std::atomic<unsigned> updatesEncoded;
+};
@@ -25,7 +25,7 @@ Player::~Player()
 
 }
 
-void Player::initialise(ResourceCache * pRes, Scene * pScene, Node* camera)
+void Player::initialise(ResourceCache * pRes, Scene * pScene, Node* camera, CreateMode physicsMode)
 {
 	pNode = pScene->CreateChild("ship");
 	pNode->SetPosition(Vector3(0.0f, 20.0f, 0.0f));
@@ -36,23 +36,18 @@ void Player::initialise(ResourceCache * pRes, Scene * pScene, Node* camera)
 	pObject->SetMaterial(pRes->GetResource<Material>("Materials/Jack.xml"));
 	pObject->SetCastShadows(true);
 
-	pRigidBody = pNode->CreateComponent<RigidBody>();
+	pRigidBody = pNode->CreateComponent<RigidBody>(physicsMode);
 	pRigidBody->SetMass(1.0f);
 	pRigidBody->SetUseGravity(false);
 	pRigidBody->SetPosition(Vector3(0.0f, 25.0f, -100.0f));
 	pRigidBody->SetTrigger(true);
 
-	pCollisionShape = pNode->CreateComponent<CollisionShape>();
+	pCollisionShape = pNode->CreateComponent<CollisionShape>(physicsMode);
 	pCollisionShape->SetBox(Vector3::ONE * 4, Vector3(0.0f, 1.5f, 0.0f));
 
-	// engine particle effects
-	Node* particle = pNode->CreateChild("Particle");
-	particle->SetPosition(Vector3(0.0f, 2.0f, -4.0f));
-	particle->SetScale(2.0f);
-	ParticleEmitter* emitter = particle->CreateComponent<ParticleEmitter>();
-	emitter->SetEffect(pRes->GetResource<ParticleEffect>("Particle/Fire.xml"));
+	// the engine fire is cosmetic, each peer with a window adds its own, see EffectPool::AttachEngine
 
-	playerMissile.Initialise(pRes, pScene, camera);
+	playerMissile.Initialise(pRes, pScene, camera, physicsMode);
 }
 
 void Player::update(Node* camera)
@@ -55,7 +55,8 @@ public:
 	Player();
 	~Player();
 
-	void initialise(ResourceCache * pRes, Scene * pScene, Node* camera);
+	// physicsMode LOCAL keeps the ship's and missile's physics on the server, clients then only get the models
+	void initialise(ResourceCache * pRes, Scene * pScene, Node* camera, CreateMode physicsMode = REPLICATED);
 
 	void update(Node* camera);
 
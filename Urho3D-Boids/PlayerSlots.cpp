@@ -0,0 +1,205 @@
+#include <Urho3D/Graphics/ParticleEmitter.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Player.h"
+#include "PlayerSlots.h"
+
+// out of the way of the flock while parked
+static const Vector3 PARKED_POSITION(0.0f, -1000.0f, 0.0f);
+static const Vector3 SPAWN_POSITION(0.0f, 25.0f, -100.0f);
+
+PlayerSlotPool::PlayerSlotPool()
+{
+	pRes = nullptr;
+	pScene = nullptr;
+	physicsMode = LOCAL;
+
+	joins = 0;
+	leaves = 0;
+	resumes = 0;
+	grown = 0;
+	lastJoinMs = 0.0f;
+	maxJoinMs = 0.0f;
+	averageJoinMs = 0.0f;
+	lastLeaveMs = 0.0f;
+	maxLeaveMs = 0.0f;
+}
+
+PlayerSlotPool::~PlayerSlotPool()
+{
+	Clear();
+}
+
+void PlayerSlotPool::Initialise(ResourceCache* res, Scene* scene, int capacity, CreateMode mode)
+{
+	Clear();
+
+	pRes = res;
+	pScene = scene;
+	physicsMode = mode;
+	for (int i = 0; i < capacity; i++)
+	{
+		freeSlots.Push(CreateSlot());
+	}
+}
+
+void PlayerSlotPool::Clear()
+{
+	// the nodes belong to the scene, only the bookkeeping is ours
+	for (unsigned i = 0; i < slots.Size(); i++)
+	{
+		delete slots[i];
+	}
+	slots.Clear();
+	freeSlots.Clear();
+	players.Clear();
+	connectTimes.Clear();
+}
+
+Player* PlayerSlotPool::CreateSlot()
+{
+	Player* slot = new Player();
+	slot->initialise(pRes, pScene, nullptr, physicsMode);
+	slots.Push(slot);
+	Park(slot);
+	return slot;
+}
+
+void PlayerSlotPool::Park(Player* slot)
+{
+	slot->playerMissile.active = false;
+	slot->playerMissile.timer = 0.0f;
+	slot->playerMissile.sweepValid = false;
+
+	slot->pNode->SetPosition(PARKED_POSITION);
+	slot->pRigidBody->SetLinearVelocity(Vector3::ZERO);
+	slot->pRigidBody->SetPosition(PARKED_POSITION);
+	slot->playerMissile.pNode->SetPosition(PARKED_POSITION);
+	slot->playerMissile.pRigidBody->SetLinearVelocity(Vector3::ZERO);
+	slot->playerMissile.pRigidBody->SetPosition(PARKED_POSITION);
+
+	// disabled nodes stay replicated but are hidden and out of the physics world on every peer
+	slot->pNode->SetEnabledRecursive(false);
+	slot->playerMissile.pNode->SetEnabledRecursive(false);
+}
+
+void PlayerSlotPool::OnConnected(Connection* connection, float time)
+{
+	connectTimes[connection] = time;
+}
+
+Player* PlayerSlotPool::Acquire(Connection* connection, float time)
+{
+	Player* slot = Find(connection);
+	if (slot)
+	{
+		return slot;
+	}
+
+	if (freeSlots.Empty())
+	{
+		grown++;
+		URHO3D_LOGWARNING("Player slots exhausted, growing the pool to " + String(slots.Size() + 1));
+		freeSlots.Push(CreateSlot());
+	}
+
+	slot = freeSlots.Back();
+	freeSlots.Pop();
+
+	slot->score = 0;
+	slot->health = 100;
+	slot->pNode->SetEnabledRecursive(true);
+	slot->playerMissile.pNode->SetEnabled(true);
+	// the missile model stays hidden until it is fired
+	slot->playerMissile.pObject->SetEnabled(false);
+	slot->pNode->SetPosition(SPAWN_POSITION);
+	slot->pRigidBody->SetPosition(SPAWN_POSITION);
+
+	players[connection] = slot;
+
+	HashMap<Connection*, float>::Iterator connected = connectTimes.Find(connection);
+	if (connected != connectTimes.End())
+	{
+		lastJoinMs = (time - connected->second_) * 1000.0f;
+		maxJoinMs = Max(maxJoinMs, lastJoinMs);
+		averageJoinMs += (lastJoinMs - averageJoinMs) / (float)(joins + 1);
+		connectTimes.Erase(connected);
+	}
+	joins++;
+
+	return slot;
+}
+
+Player* PlayerSlotPool::Release(Connection* connection)
+{
+	connectTimes.Erase(connection);
+
+	HashMap<Connection*, Player*>::Iterator i = players.Find(connection);
+	if (i == players.End())
+	{
+		return nullptr;
+	}
+
+	leaveTimer.Reset();
+
+	Player* slot = i->second_;
+	players.Erase(i);
+	Park(slot);
+	freeSlots.Push(slot);
+
+	lastLeaveMs = leaveTimer.GetUSec(false) / 1000.0f;
+	maxLeaveMs = Max(maxLeaveMs, lastLeaveMs);
+	leaves++;
+
+	return slot;
+}
+
+Player* PlayerSlotPool::Detach(Connection* connection)
+{
+	connectTimes.Erase(connection);
+
+	HashMap<Connection*, Player*>::Iterator i = players.Find(connection);
+	if (i == players.End())
+	{
+		return nullptr;
+	}
+
+	// the ship stays where it is, enabled and replicated, with its score and health
+	Player* slot = i->second_;
+	players.Erase(i);
+	return slot;
+}
+
+void PlayerSlotPool::Attach(Connection* connection, Player* slot)
+{
+	// a resume is not a join, the connect time would only measure the reconnect
+	connectTimes.Erase(connection);
+	players[connection] = slot;
+	resumes++;
+}
+
+void PlayerSlotPool::ReleaseDetached(Player* slot)
+{
+	Park(slot);
+	freeSlots.Push(slot);
+	leaves++;
+}
+
+Player* PlayerSlotPool::Find(Connection* connection) const
+{
+	HashMap<Connection*, Player*>::ConstIterator i = players.Find(connection);
+	return i != players.End() ? i->second_ : nullptr;
+}
+
+String PlayerSlotPool::GetDebugText() const
+{
+	return "slots " + String(players.Size()) + "/" + String(slots.Size())
+		+ " joins " + String(joins) + " leaves " + String(leaves) + " resumes " + String(resumes) + " grown " + String(grown)
+		+ " join " + String((int)lastJoinMs) + " ms (avg " + String((int)averageJoinMs) + " max " + String((int)maxJoinMs) + ")"
+		+ " leave " + String(lastLeaveMs) + " ms (max " + String(maxLeaveMs) + ")";
+}
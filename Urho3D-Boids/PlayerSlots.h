@@ -0,0 +1,78 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Math/Vector3.h>
+#include <Urho3D/Scene/Node.h>
+
+namespace Urho3D
+{
+	class Connection;
+	class ResourceCache;
+	class Scene;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class Player;
+
+// server: ships for remote players, created up front and handed out on join, parked again on leave
+class PlayerSlotPool
+{
+public:
+	PlayerSlotPool();
+	~PlayerSlotPool();
+
+	// create the slots, each a disabled ship with its missile and engine emitter, physics created with physicsMode
+	void Initialise(ResourceCache* pRes, Scene* pScene, int capacity, CreateMode physicsMode);
+	// forget every slot, for when the scene has been cleared under the pool
+	void Clear();
+
+	// join time starts counting when the connection is made
+	void OnConnected(Connection* connection, float time);
+	// slot for a connection that is ready to play, grows the pool if it is exhausted
+	Player* Acquire(Connection* connection, float time);
+	// park the connection's slot again, returns the player it had or null if it never got one
+	Player* Release(Connection* connection);
+
+	// a dropped connection's slot out of players but left as it is, for the client to resume
+	Player* Detach(Connection* connection);
+	// a resumed client takes its detached slot back
+	void Attach(Connection* connection, Player* slot);
+	// park a detached slot nobody came back for
+	void ReleaseDetached(Player* slot);
+
+	Player* Find(Connection* connection) const;
+
+	unsigned GetActiveCount() const { return players.Size(); }
+	unsigned GetCapacity() const { return slots.Size(); }
+
+	String GetDebugText() const;
+
+	// connected players, iterate this instead of the client connections
+	HashMap<Connection*, Player*> players;
+
+	// readout, latencies in milliseconds
+	unsigned joins;
+	unsigned leaves;
+	unsigned resumes;
+	unsigned grown;
+	float lastJoinMs;
+	float maxJoinMs;
+	float averageJoinMs;
+	float lastLeaveMs;
+	float maxLeaveMs;
+
+private:
+	Player* CreateSlot();
+	void Park(Player* slot);
+
+	ResourceCache* pRes;
+	Scene* pScene;
+	CreateMode physicsMode;
+	Vector<Player*> slots;
+	Vector<Player*> freeSlots;
+	HashMap<Connection*, float> connectTimes;
+	HiresTimer leaveTimer;
+};
@@ -0,0 +1,100 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include "NetworkStats.h"
+#include "RateControl.h"
+
+RateController::RateController()
+{
+	maxLoss = 0.05f;
+	rttFactor = 1.5f;
+	rttMargin = 30.0f;
+	maxRttRise = 20.0f;
+	maxQueued = 64;
+	holdTime = 3.0f;
+	recoverStep = 0.1f;
+
+	Reset(30.0f);
+}
+
+void RateController::Reset(float full)
+{
+	fullRate = full;
+	rate = full;
+	tier = 0;
+	baseRtt = 0.0f;
+	rttTrend = 0.0f;
+	decreases = 0;
+	lastReason = String::EMPTY;
+	lastRtt = 0.0f;
+	hold = 0.0f;
+}
+
+bool RateController::Update(const ConnectionStats& stats)
+{
+	// the lowest round trip seen is the link's own, let it creep up slowly in case the route changed
+	if (baseRtt <= 0.0f || stats.rtt < baseRtt)
+	{
+		baseRtt = stats.rtt;
+	}
+	else
+	{
+		baseRtt += (stats.rtt - baseRtt) * 0.01f;
+	}
+	if (lastRtt > 0.0f)
+	{
+		rttTrend += (stats.rtt - lastRtt - rttTrend) * 0.5f;
+	}
+	lastRtt = stats.rtt;
+
+	String reason;
+	if (stats.queued > maxQueued)
+	{
+		reason = "queue " + String(stats.queued);
+	}
+	else if (stats.lossRate > maxLoss)
+	{
+		reason = "loss " + String(stats.lossRate);
+	}
+	else if (stats.rtt > baseRtt * rttFactor + rttMargin)
+	{
+		reason = "rtt " + String((int)stats.rtt) + " ms";
+	}
+	else if (rttTrend > maxRttRise)
+	{
+		reason = "rtt rising " + String((int)rttTrend) + " ms/s";
+	}
+
+	float minRate = fullRate / (1 << (RATE_TIERS - 1));
+	if (!reason.Empty())
+	{
+		// a backed up queue is already costing the server, drop straight to the slowest feed
+		rate = stats.queued > maxQueued ? minRate : Max(rate * 0.5f, minRate);
+		hold = holdTime;
+		decreases++;
+		lastReason = reason;
+	}
+	else if (hold > 0.0f)
+	{
+		hold -= 1.0f;
+	}
+	else
+	{
+		rate = Min(rate + fullRate * recoverStep, fullRate);
+	}
+
+	int newTier = 0;
+	while (newTier < RATE_TIERS - 1 && rate < fullRate / (1 << newTier) - M_EPSILON)
+	{
+		newTier++;
+	}
+	bool changed = newTier != tier;
+	tier = newTier;
+	return changed;
+}
+
+String RateController::GetDebugText() const
+{
+	return "boids at " + String(fullRate / (1 << tier)) + " Hz tier " + String(tier) + " (allowed " + String((int)rate) + " Hz, base rtt "
+		+ String((int)baseRtt) + " ms, trend " + String((int)rttTrend) + " ms/s, " + String(decreases) + " cuts"
+		+ (lastReason.Empty() ? String::EMPTY : ", last " + lastReason) + ")";
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <Urho3D/Container/Str.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+struct ConnectionStats;
+
+// boid feeds a player can be on, each half the rate and twice the dead reckoning error of the one before
+static const int RATE_TIERS = 3;
+
+// server: one connection's share of the boid stream, additive increase multiplicative decrease. Once a second it
+// looks at the connection's stats for congestion, a loss rate over maxLoss, a round trip grown well past the
+// lowest seen or still climbing, or kNet's outbound queue backing up; on any of those the allowed rate halves and
+// holds for a while, otherwise it climbs back a step at a time. The tier is the fastest feed the rate allows
+class RateController
+{
+public:
+	RateController();
+
+	// fastest update rate, that of tier 0
+	void Reset(float fullRate);
+
+	// once a second with the connection's fresh stats, true when the tier changed
+	bool Update(const ConnectionStats& stats);
+
+	String GetDebugText() const;
+
+	// congestion thresholds: loss rate, round trip over the baseline as a factor plus ms, rise per second in ms
+	float maxLoss;
+	float rttFactor;
+	float rttMargin;
+	float maxRttRise;
+	unsigned maxQueued;
+	// seconds to hold after a decrease, and the fraction of the full rate regained per second after that
+	float holdTime;
+	float recoverStep;
+
+	// readout
+	int tier;
+	float rate;
+	float fullRate;
+	float baseRtt;
+	float rttTrend;
+	unsigned decreases;
+	String lastReason;
+
+private:
+	float lastRtt;
+	float hold;
+};
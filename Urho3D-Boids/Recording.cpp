@@ -0,0 +1,681 @@
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/Math/MathDefs.h>
+#include <Urho3D/Network/Connection.h>
+
+#include "LagCompensation.h"
+#include "Player.h"
+#include "Recording.h"
+#include "Room.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const unsigned RECORDING_VERSION = 1;
+// type, tick and payload size
+static const unsigned RECORD_HEADER_SIZE = 9;
+// pending records are written early past this
+static const unsigned FLUSH_SIZE = 256 * 1024;
+
+static void WriteShip(VectorBuffer& buffer, unsigned short id, const Player& player)
+{
+	buffer.WriteUShort(id);
+	buffer.WriteVector3(player.pNode->GetPosition());
+	buffer.WritePackedQuaternion(player.pNode->GetRotation());
+	buffer.WriteUShort((unsigned short)Clamp(player.score, 0, 65535));
+	buffer.WriteUByte((unsigned char)Clamp(player.health, 0, 255));
+	const Missile& missile = player.playerMissile;
+	buffer.WriteBool(missile.active);
+	if (missile.active)
+	{
+		buffer.WriteVector3(missile.pNode->GetPosition());
+	}
+}
+
+static void ReadShip(MemoryBuffer& buffer, RecordedShip& ship)
+{
+	ship.position = buffer.ReadVector3();
+	ship.rotation = buffer.ReadPackedQuaternion();
+	ship.score = buffer.ReadUShort();
+	ship.health = buffer.ReadUByte();
+	ship.missileActive = buffer.ReadBool();
+	ship.missilePosition = ship.missileActive ? buffer.ReadVector3() : Vector3::ZERO;
+}
+
+SessionRecorder::SessionRecorder()
+{
+	keyframeInterval = 60;
+
+	bytesPerSecond = 0.0f;
+	usPerTick = 0.0f;
+	bytesWritten = 0;
+
+	recordStart = 0;
+	worldChecksum = 0;
+	ticksToKeyframe = 0;
+	nextID = 1;
+	busyUs = 0;
+	ticks = 0;
+	reportBytes = 0;
+	lastReport = 0.0f;
+
+	stream.maxError = 0.1f;
+}
+
+SessionRecorder::~SessionRecorder()
+{
+	Close();
+}
+
+bool SessionRecorder::Open(Context* context, const String& fileName, unsigned roomID, int tickRate, unsigned checksum)
+{
+	Close();
+	file = new File(context, fileName, FILE_WRITE);
+	if (!file->IsOpen())
+	{
+		file.Reset();
+		return false;
+	}
+
+	worldChecksum = checksum;
+	keyframeInterval = tickRate;
+	ticksToKeyframe = 0;
+	ids.Clear();
+	nextID = 1;
+	stream.Restart(0);
+	bytesWritten = 0;
+
+	pending.Clear();
+	pending.WriteFileID("BREC");
+	pending.WriteUInt(RECORDING_VERSION);
+	pending.WriteUInt(roomID);
+	pending.WriteUInt((unsigned)tickRate);
+	pending.WriteUInt(worldChecksum);
+	Flush();
+	return true;
+}
+
+void SessionRecorder::Close()
+{
+	if (file)
+	{
+		Flush();
+		file->Close();
+		file.Reset();
+	}
+}
+
+void SessionRecorder::RecordTick(Room& room)
+{
+	if (!file)
+	{
+		return;
+	}
+	timer.Reset();
+
+	room.CaptureBoids(positions, velocities);
+	stream.WriteUpdate(positions, velocities, (unsigned short)room.serverTick, room.serverTime, update);
+
+	BeginRecord(RECORD_TICK, room.serverTick);
+	pending.WriteFloat(room.serverTime);
+	pending.WriteUShort((unsigned short)update.GetSize());
+	pending.Write(update.GetData(), update.GetSize());
+	pending.WriteUByte((unsigned char)Min(room.serverObjects.players.Size(), 255u));
+	unsigned shipsWritten = 0;
+	for (HashMap<Connection*, Player*>::ConstIterator i = room.serverObjects.players.Begin(); i != room.serverObjects.players.End() && shipsWritten < 255; ++i, shipsWritten++)
+	{
+		WriteShip(pending, GetID(i->first_), *i->second_);
+	}
+	EndRecord();
+
+	// after the tick's update, so a replay starting here carries on with the next one
+	if (--ticksToKeyframe <= 0)
+	{
+		ticksToKeyframe = keyframeInterval;
+		stream.WriteBootstrap(worldChecksum, positions, velocities, room.serverTime, keyframe);
+
+		BeginRecord(RECORD_KEYFRAME, room.serverTick);
+		pending.WriteUInt(keyframe.GetSize());
+		pending.Write(keyframe.GetData(), keyframe.GetSize());
+		pending.WriteUShort((unsigned short)ids.Size());
+		for (HashMap<Connection*, unsigned short>::ConstIterator i = ids.Begin(); i != ids.End(); ++i)
+		{
+			pending.WriteUShort(i->second_);
+		}
+		EndRecord();
+
+		if (room.lockstepServer.IsRunning())
+		{
+			room.lockstepServer.WriteStart(nullptr, keyframe);
+			BeginRecord(RECORD_LOCKSTEPSTART, room.serverTick);
+			pending.Write(keyframe.GetData(), keyframe.GetSize());
+			EndRecord();
+		}
+		Flush();
+	}
+	else if (pending.GetSize() >= FLUSH_SIZE)
+	{
+		Flush();
+	}
+
+	busyUs += timer.GetUSec(false);
+	ticks++;
+	if (room.serverTime - lastReport >= 1.0f)
+	{
+		float elapsed = room.serverTime - lastReport;
+		bytesPerSecond = (bytesWritten + pending.GetSize() - reportBytes) / elapsed;
+		usPerTick = ticks > 0 ? (float)busyUs / ticks : 0.0f;
+		reportBytes = bytesWritten + pending.GetSize();
+		busyUs = 0;
+		ticks = 0;
+		lastReport = room.serverTime;
+	}
+}
+
+void SessionRecorder::RecordInput(Connection* connection, unsigned tick, const PODVector<unsigned char>& data)
+{
+	if (!file)
+	{
+		return;
+	}
+	BeginRecord(RECORD_INPUT, tick);
+	pending.WriteUShort(GetID(connection));
+	pending.Write(data.Buffer(), data.Size());
+	EndRecord();
+}
+
+void SessionRecorder::RecordJoin(Connection* connection, unsigned tick)
+{
+	if (!file)
+	{
+		return;
+	}
+	BeginRecord(RECORD_JOIN, tick);
+	pending.WriteUShort(GetID(connection));
+	pending.WriteString(connection->ToString());
+	EndRecord();
+}
+
+void SessionRecorder::RecordLeave(Connection* connection, unsigned tick)
+{
+	HashMap<Connection*, unsigned short>::Iterator id = ids.Find(connection);
+	if (!file || id == ids.End())
+	{
+		return;
+	}
+	BeginRecord(RECORD_LEAVE, tick);
+	pending.WriteUShort(id->second_);
+	EndRecord();
+	ids.Erase(id);
+}
+
+void SessionRecorder::RecordSweep(Connection* connection, unsigned tick, float viewTime, const Vector3& start, const Vector3& end, int hit)
+{
+	if (!file)
+	{
+		return;
+	}
+	BeginRecord(RECORD_SWEEP, tick);
+	pending.WriteUShort(GetID(connection));
+	pending.WriteFloat(viewTime);
+	pending.WriteVector3(start);
+	pending.WriteVector3(end);
+	pending.WriteInt(hit);
+	EndRecord();
+}
+
+void SessionRecorder::RecordLockstepTick(unsigned tick, unsigned hash, const VectorBuffer& message)
+{
+	if (!file)
+	{
+		return;
+	}
+	BeginRecord(RECORD_LOCKSTEPTICK, tick);
+	pending.WriteUInt(hash);
+	pending.Write(message.GetData(), message.GetSize());
+	EndRecord();
+}
+
+String SessionRecorder::GetDebugText() const
+{
+	return String((int)(bytesPerSecond / 1024.0f)) + " KB/s, " + String(bytesWritten / 1024) + " KB written, "
+		+ String((int)usPerTick) + " us per tick";
+}
+
+unsigned short SessionRecorder::GetID(Connection* connection)
+{
+	HashMap<Connection*, unsigned short>::ConstIterator id = ids.Find(connection);
+	if (id != ids.End())
+	{
+		return id->second_;
+	}
+	unsigned short newID = nextID++;
+	ids[connection] = newID;
+	return newID;
+}
+
+void SessionRecorder::BeginRecord(RecordType type, unsigned tick)
+{
+	recordStart = pending.GetPosition();
+	pending.WriteUByte((unsigned char)type);
+	pending.WriteUInt(tick);
+	pending.WriteUInt(0);
+}
+
+void SessionRecorder::EndRecord()
+{
+	unsigned end = pending.GetPosition();
+	pending.Seek(recordStart + 5);
+	pending.WriteUInt(end - recordStart - RECORD_HEADER_SIZE);
+	pending.Seek(end);
+}
+
+void SessionRecorder::Flush()
+{
+	if (pending.GetSize() > 0)
+	{
+		file->Write(pending.GetData(), pending.GetSize());
+		file->Flush();
+		bytesWritten += pending.GetSize();
+		pending.Clear();
+	}
+}
+
+MappedFile::MappedFile()
+{
+	data = nullptr;
+	size = 0;
+	file = nullptr;
+	mapping = nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const String& fileName)
+{
+	Close();
+#ifdef _WIN32
+	// shared for writing, so a recording the server is still appending to can be read
+	HANDLE handle = CreateFileW(WString(GetNativePath(fileName)).CString(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0 || fileSize.QuadPart > M_MAX_UNSIGNED)
+	{
+		CloseHandle(handle);
+		return false;
+	}
+	HANDLE view = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!view)
+	{
+		CloseHandle(handle);
+		return false;
+	}
+	data = static_cast<const unsigned char*>(MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0));
+	if (!data)
+	{
+		CloseHandle(view);
+		CloseHandle(handle);
+		return false;
+	}
+	size = (unsigned)fileSize.QuadPart;
+	file = handle;
+	mapping = view;
+#else
+	int descriptor = open(GetNativePath(fileName).CString(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0 || (unsigned long long)status.st_size > M_MAX_UNSIGNED)
+	{
+		close(descriptor);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	// the mapping keeps the file open on its own
+	close(descriptor);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+	data = static_cast<const unsigned char*>(view);
+	size = (unsigned)status.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!data)
+	{
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+	CloseHandle(file);
+#else
+	munmap(const_cast<unsigned char*>(data), size);
+#endif
+	data = nullptr;
+	size = 0;
+	file = nullptr;
+	mapping = nullptr;
+}
+
+// a replayed player: its input as the server received it, and its ship as recorded
+struct ReplayPlayer
+{
+	InputReceiver input;
+	RecordedShip ship;
+};
+
+SessionReplay::SessionReplay()
+{
+	roomID = 0;
+	tickRate = 60;
+	worldChecksum = 0;
+	firstTick = 0;
+	lastTick = 0;
+
+	ticks = 0;
+	inputs = 0;
+	sweeps = 0;
+	disputes = 0;
+	lockstepTicks = 0;
+	desyncs = 0;
+	firstDesync = 0;
+	seconds = 0.0f;
+	encodeUsPerTick = 0.0f;
+	encodeBytesPerTick = 0.0f;
+	decodeUsPerInput = 0.0f;
+
+	recordsStart = 0;
+}
+
+bool SessionReplay::Open(const String& fileName)
+{
+	keyframeOffsets.Clear();
+	keyframeTicks.Clear();
+	if (!mapped.Open(fileName))
+	{
+		return false;
+	}
+
+	MemoryBuffer buffer(mapped.GetData(), mapped.GetSize());
+	if (buffer.ReadFileID() != "BREC" || buffer.ReadUInt() != RECORDING_VERSION)
+	{
+		mapped.Close();
+		return false;
+	}
+	roomID = buffer.ReadUInt();
+	tickRate = Max((int)buffer.ReadUInt(), 1);
+	worldChecksum = buffer.ReadUInt();
+	recordsStart = buffer.GetPosition();
+
+	// only the record headers are read, the payloads are stepped over
+	bool anyTick = false;
+	unsigned offset = recordsStart;
+	while (offset + RECORD_HEADER_SIZE <= mapped.GetSize())
+	{
+		MemoryBuffer header(mapped.GetData() + offset, RECORD_HEADER_SIZE);
+		unsigned char type = header.ReadUByte();
+		unsigned tick = header.ReadUInt();
+		unsigned payload = header.ReadUInt();
+		if (payload > mapped.GetSize() - offset - RECORD_HEADER_SIZE)
+		{
+			break;
+		}
+		if (type == RECORD_KEYFRAME)
+		{
+			keyframeOffsets.Push(offset);
+			keyframeTicks.Push(tick);
+		}
+		if (type == RECORD_TICK)
+		{
+			firstTick = anyTick ? firstTick : tick;
+			lastTick = tick;
+			anyTick = true;
+		}
+		offset += RECORD_HEADER_SIZE + payload;
+	}
+	return true;
+}
+
+void SessionReplay::Run(unsigned first, unsigned last, File* csv)
+{
+	ticks = 0;
+	inputs = 0;
+	sweeps = 0;
+	disputes = 0;
+	lockstepTicks = 0;
+	desyncs = 0;
+	firstDesync = 0;
+
+	// the last keyframe at or before first, the flock is only known from one
+	unsigned offset = 0;
+	for (unsigned i = 0; i < keyframeOffsets.Size() && keyframeTicks[i] <= first; i++)
+	{
+		offset = keyframeOffsets[i];
+	}
+	if (offset == 0 && !keyframeOffsets.Empty())
+	{
+		offset = keyframeOffsets[0];
+	}
+	if (offset == 0)
+	{
+		return;
+	}
+
+	BoidStreamModel model;
+	bool modelReady = false;
+	LagCompensator compensator;
+	HashMap<unsigned short, ReplayPlayer> players;
+	LockstepClient lockstep;
+	bool lockstepDiverged = false;
+	float now = 0.0f;
+
+	BoidStreamWriter encoder;
+	PODVector<Vector3> positions;
+	PODVector<Vector3> velocities;
+	VectorBuffer encoded;
+	long long encodeUs = 0;
+	long long decodeUs = 0;
+	unsigned long long encodeBytes = 0;
+	HiresTimer runTimer;
+	HiresTimer stepTimer;
+
+	if (csv)
+	{
+		csv->WriteLine("tick,time,player,x,y,z,yaw,pitch,buttons,score,health,missile");
+	}
+
+	while (offset + RECORD_HEADER_SIZE <= mapped.GetSize())
+	{
+		MemoryBuffer header(mapped.GetData() + offset, RECORD_HEADER_SIZE);
+		unsigned char type = header.ReadUByte();
+		unsigned tick = header.ReadUInt();
+		unsigned payload = header.ReadUInt();
+		if (payload > mapped.GetSize() - offset - RECORD_HEADER_SIZE)
+		{
+			break;
+		}
+		const unsigned char* payloadData = mapped.GetData() + offset + RECORD_HEADER_SIZE;
+		MemoryBuffer record(payloadData, payload);
+		offset += RECORD_HEADER_SIZE + payload;
+		if (type == RECORD_TICK && tick > last)
+		{
+			break;
+		}
+		bool inRange = tick >= first;
+
+		if (type == RECORD_KEYFRAME && !modelReady)
+		{
+			unsigned size = record.ReadUInt();
+			MemoryBuffer bootstrap(payloadData + record.GetPosition(), Min(size, payload - record.GetPosition()));
+			record.Seek(record.GetPosition() + bootstrap.GetSize());
+			modelReady = model.ReadBootstrap(bootstrap);
+			unsigned count = record.ReadUShort();
+			for (unsigned i = 0; i < count && !record.IsEof(); i++)
+			{
+				players[record.ReadUShort()];
+			}
+		}
+		else if (type == RECORD_TICK && modelReady)
+		{
+			now = record.ReadFloat();
+			unsigned size = record.ReadUShort();
+			MemoryBuffer stream(payloadData + record.GetPosition(), Min(size, payload - record.GetPosition()));
+			record.Seek(record.GetPosition() + stream.GetSize());
+			model.ReadUpdate(stream);
+			model.Predict(model.lastTime, positions, velocities);
+			compensator.Record(now, positions);
+
+			unsigned count = record.ReadUByte();
+			for (unsigned i = 0; i < count && !record.IsEof(); i++)
+			{
+				ReplayPlayer& player = players[record.ReadUShort()];
+				ReadShip(record, player.ship);
+			}
+			if (!inRange)
+			{
+				// controls still advance, so the receivers are in step by the first tick
+				for (HashMap<unsigned short, ReplayPlayer>::Iterator i = players.Begin(); i != players.End(); ++i)
+				{
+					i->second_.input.Next();
+				}
+				continue;
+			}
+
+			ticks++;
+			stepTimer.Reset();
+			encoder.WriteUpdate(positions, velocities, (unsigned short)tick, now, encoded);
+			encodeUs += stepTimer.GetUSec(false);
+			encodeBytes += encoded.GetSize();
+
+			for (HashMap<unsigned short, ReplayPlayer>::Iterator i = players.Begin(); i != players.End(); ++i)
+			{
+				const Controls& controls = i->second_.input.Next();
+				const RecordedShip& ship = i->second_.ship;
+				if (csv)
+				{
+					csv->WriteLine(String(tick) + "," + String(now) + "," + String(i->first_) + "," + String(ship.position.x_) + ","
+						+ String(ship.position.y_) + "," + String(ship.position.z_) + "," + String(controls.yaw_) + ","
+						+ String(controls.pitch_) + "," + String(controls.buttons_) + "," + String(ship.score) + ","
+						+ String(ship.health) + "," + String(ship.missileActive ? 1 : 0));
+				}
+			}
+		}
+		else if (type == RECORD_INPUT)
+		{
+			ReplayPlayer& player = players[record.ReadUShort()];
+			InputMessage message;
+			stepTimer.Reset();
+			InputReceiver::Decode(record, message);
+			decodeUs += stepTimer.GetUSec(false);
+			player.input.Add(message, tick);
+			inputs += inRange ? 1 : 0;
+		}
+		else if (type == RECORD_JOIN)
+		{
+			unsigned short id = record.ReadUShort();
+			players[id] = ReplayPlayer();
+			if (inRange)
+			{
+				URHO3D_LOGINFO("Tick " + String(tick) + ": player " + String(id) + " joined from " + record.ReadString());
+			}
+		}
+		else if (type == RECORD_LEAVE)
+		{
+			unsigned short id = record.ReadUShort();
+			players.Erase(id);
+			if (inRange)
+			{
+				URHO3D_LOGINFO("Tick " + String(tick) + ": player " + String(id) + " left");
+			}
+		}
+		else if (type == RECORD_SWEEP && inRange && modelReady)
+		{
+			unsigned short id = record.ReadUShort();
+			float viewTime = record.ReadFloat();
+			Vector3 start = record.ReadVector3();
+			Vector3 end = record.ReadVector3();
+			int hit = record.ReadInt();
+			int replayed = compensator.SweepSegment(now, viewTime, start, end, MISSILE_HIT_RADIUS);
+			sweeps++;
+
+			// the replayed flock is the recorded stream's model of it, a boid grazing the edge can go either way
+			if ((hit >= 0) != (replayed >= 0))
+			{
+				disputes++;
+				URHO3D_LOGWARNING("Tick " + String(tick) + ": player " + String(id) + " sweep " + start.ToString() + " to "
+					+ end.ToString() + " rewound " + String((int)((now - viewTime) * 1000.0f)) + " ms, server "
+					+ (hit >= 0 ? "hit boid " + String(hit) : String("missed")) + ", replay "
+					+ (replayed >= 0 ? "hits boid " + String(replayed) : String("misses")));
+			}
+		}
+		else if (type == RECORD_LOCKSTEPSTART)
+		{
+			// the first one starts the match, the later ones only bring it back after a desync
+			if (!lockstep.active || lockstepDiverged)
+			{
+				lockstep.ReadStart(record);
+				lockstepDiverged = false;
+			}
+		}
+		else if (type == RECORD_LOCKSTEPTICK)
+		{
+			unsigned hash = record.ReadUInt();
+			if (!lockstepDiverged && lockstep.ReadTick(record) && inRange)
+			{
+				lockstepTicks++;
+				if (lockstep.sim.GetHash() != hash)
+				{
+					firstDesync = desyncs == 0 ? lockstep.sim.tick : firstDesync;
+					desyncs++;
+					lockstepDiverged = true;
+					URHO3D_LOGWARNING("Lockstep tick " + String(lockstep.sim.tick) + " replays to hash " + String(lockstep.sim.GetHash())
+						+ ", the server had " + String(hash));
+				}
+			}
+		}
+	}
+
+	seconds = runTimer.GetUSec(false) / 1000000.0f;
+	encodeUsPerTick = ticks > 0 ? (float)encodeUs / ticks : 0.0f;
+	encodeBytesPerTick = ticks > 0 ? (float)encodeBytes / ticks : 0.0f;
+	decodeUsPerInput = inputs > 0 ? (float)decodeUs / inputs : 0.0f;
+}
+
+String SessionReplay::GetInfo() const
+{
+	return "room " + String(roomID) + " at " + String(tickRate) + " Hz, ticks " + String(firstTick) + " to " + String(lastTick) + " ("
+		+ String((lastTick - firstTick) / (float)tickRate) + " s), " + String(keyframeOffsets.Size()) + " keyframes, "
+		+ String(mapped.GetSize() / 1024) + " KB";
+}
+
+String SessionReplay::GetDebugText() const
+{
+	float recorded = ticks / (float)tickRate;
+	return String(ticks) + " ticks in " + String(seconds) + " s (" + String(seconds > 0.0f ? recorded / seconds : 0.0f)
+		+ "x real time), " + String(inputs) + " inputs, " + String(sweeps) + " sweeps " + String(disputes) + " disputed, "
+		+ String(lockstepTicks) + " lockstep ticks " + String(desyncs) + " desyncs"
+		+ (desyncs > 0 ? " from tick " + String(firstDesync) : String()) + "; encode " + String(encodeUsPerTick) + " us "
+		+ String((int)encodeBytesPerTick) + " bytes per tick, input decode " + String(decodeUsPerInput) + " us";
+}
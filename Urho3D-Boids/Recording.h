@@ -0,0 +1,190 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Math/Quaternion.h>
+#include <Urho3D/Math/Vector3.h>
+
+#include "WorldSync.h"
+
+namespace Urho3D
+{
+	class Connection;
+	class Context;
+	class File;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class Room;
+
+// A session file is a header, then records appended one after another and never rewritten: a type byte, the
+// server tick, the payload size and the payload, all little endian with no pointers or padding, so a file can be
+// mapped and walked in place. Records are buffered and written out at each keyframe (once a second) or every 256 KB,
+// so a crash loses what was pending, up to a second of play, and at most cuts the last record written short
+enum RecordType
+{
+	// the recorder's boid stream as a bootstrap and who is playing, to start a replay from
+	RECORD_KEYFRAME = 1,
+	// start of a physics step: server time, the boid stream's update and every ship
+	RECORD_TICK,
+	// an input message exactly as it arrived
+	RECORD_INPUT,
+	RECORD_JOIN,
+	RECORD_LEAVE,
+	// a missile sweep the lag compensator judged, and the boid it hit
+	RECORD_SWEEP,
+	// a lockstep match's state, at each keyframe
+	RECORD_LOCKSTEPSTART,
+	// a lockstep tick's input set as it was sent, and the match's hash after it
+	RECORD_LOCKSTEPTICK
+};
+
+// one ship as a tick record has it
+struct RecordedShip
+{
+	Vector3 position;
+	Quaternion rotation;
+	int score;
+	int health;
+	bool missileActive;
+	Vector3 missilePosition;
+};
+
+// server: one room's session into a file, from the main thread. Records collect in memory and go to the file in
+// one write a second, so recording costs a capture of the flock and a boid stream update per tick
+class SessionRecorder
+{
+public:
+	SessionRecorder();
+	~SessionRecorder();
+
+	bool Open(Context* context, const String& fileName, unsigned roomID, int tickRate, unsigned worldChecksum);
+	// writes what is pending
+	void Close();
+	bool IsOpen() const { return file.NotNull(); }
+
+	// at the start of the room's physics step, before its input is applied, where the lag compensator records too
+	void RecordTick(Room& room);
+	void RecordInput(Connection* connection, unsigned tick, const PODVector<unsigned char>& data);
+	void RecordJoin(Connection* connection, unsigned tick);
+	void RecordLeave(Connection* connection, unsigned tick);
+	// hit is the boid's index, -1 for a miss
+	void RecordSweep(Connection* connection, unsigned tick, float viewTime, const Vector3& start, const Vector3& end, int hit);
+	void RecordLockstepTick(unsigned tick, unsigned hash, const VectorBuffer& message);
+
+	String GetDebugText() const;
+
+	// ticks between keyframes
+	int keyframeInterval;
+
+	// readout, over the last second
+	float bytesPerSecond;
+	float usPerTick;
+	unsigned bytesWritten;
+
+private:
+	// a connection's number in this file, handed out on first sight
+	unsigned short GetID(Connection* connection);
+	// the size is filled in by EndRecord
+	void BeginRecord(RecordType type, unsigned tick);
+	void EndRecord();
+	void Flush();
+
+	SharedPtr<File> file;
+	VectorBuffer pending;
+	unsigned recordStart;
+	unsigned worldChecksum;
+
+	// its own writer, a little tighter than the clients' so a replay is close enough to judge hits against
+	BoidStreamWriter stream;
+	PODVector<Vector3> positions;
+	PODVector<Vector3> velocities;
+	VectorBuffer update;
+	VectorBuffer keyframe;
+	int ticksToKeyframe;
+
+	HashMap<Connection*, unsigned short> ids;
+	unsigned short nextID;
+
+	HiresTimer timer;
+	long long busyUs;
+	unsigned ticks;
+	unsigned reportBytes;
+	float lastReport;
+};
+
+// a whole file mapped read only
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const String& fileName);
+	void Close();
+
+	const unsigned char* GetData() const { return data; }
+	unsigned GetSize() const { return size; }
+
+private:
+	const unsigned char* data;
+	unsigned size;
+	// the platform's handles
+	void* file;
+	void* mapping;
+};
+
+// A recorded room read back headless, as fast as it steps: the flock from the recorded boid stream, the ships as
+// recorded and each player's controls from its input messages through an InputReceiver, like the server applied
+// them. Every missile sweep is judged again against the replayed flock and a lockstep match is stepped again from
+// its tick inputs, against the hashes the server had. Each tick's flock is also written through a fresh boid stream
+// writer, so a recording doubles as a benchmark of the encode on real traffic
+class SessionReplay
+{
+public:
+	SessionReplay();
+
+	// maps the file, checks the header and finds the keyframes
+	bool Open(const String& fileName);
+
+	// ticks first to last, from the keyframe at or before first; with csv open, a line per ship per tick
+	void Run(unsigned first, unsigned last, File* csv);
+
+	// what the file holds, one line
+	String GetInfo() const;
+	// what the run found and how fast it went, one line
+	String GetDebugText() const;
+
+	// header
+	unsigned roomID;
+	int tickRate;
+	unsigned worldChecksum;
+
+	// ticks in the file
+	unsigned firstTick;
+	unsigned lastTick;
+
+	// readout of the last run
+	unsigned ticks;
+	unsigned inputs;
+	unsigned sweeps;
+	// sweeps where the replayed flock gives another verdict than the server did
+	unsigned disputes;
+	unsigned lockstepTicks;
+	unsigned desyncs;
+	unsigned firstDesync;
+	float seconds;
+	float encodeUsPerTick;
+	float encodeBytesPerTick;
+	float decodeUsPerInput;
+
+private:
+	MappedFile mapped;
+	unsigned recordsStart;
+	PODVector<unsigned> keyframeOffsets;
+	PODVector<unsigned> keyframeTicks;
+};
@@ -0,0 +1,101 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include "Resume.h"
+
+ResumeTable::ResumeTable()
+{
+	grace = 0.0f;
+
+	holds = 0;
+	resumes = 0;
+	expiries = 0;
+	lastAwayMs = 0.0f;
+	maxAwayMs = 0.0f;
+}
+
+SecureToken ResumeTable::Issue(Connection* connection)
+{
+	SecureToken token = GetToken(connection);
+	while (token == 0 || held.Contains(token))
+	{
+		token = NewSecureToken();
+	}
+	tokens[connection] = token;
+	return token;
+}
+
+SecureToken ResumeTable::GetToken(Connection* connection) const
+{
+	HashMap<Connection*, SecureToken>::ConstIterator i = tokens.Find(connection);
+	return i != tokens.End() ? i->second_ : 0;
+}
+
+bool ResumeTable::Hold(Connection* connection, Player* player, float time)
+{
+	SecureToken token = GetToken(connection);
+	tokens.Erase(connection);
+	if (token == 0 || !player || grace <= 0.0f)
+	{
+		return false;
+	}
+
+	HeldPlayer& entry = held[token];
+	entry.player = player;
+	entry.time = time;
+	holds++;
+	return true;
+}
+
+void ResumeTable::Forget(Connection* connection)
+{
+	tokens.Erase(connection);
+}
+
+Player* ResumeTable::Claim(SecureToken token, Connection* connection, float time)
+{
+	HashMap<SecureToken, HeldPlayer>::Iterator i = held.Find(token);
+	if (token == 0 || i == held.End() || time - i->second_.time > grace)
+	{
+		return nullptr;
+	}
+
+	Player* player = i->second_.player;
+	lastAwayMs = (time - i->second_.time) * 1000.0f;
+	maxAwayMs = Max(maxAwayMs, lastAwayMs);
+	held.Erase(i);
+
+	// the same token, a second drop resumes the same way
+	tokens[connection] = token;
+	resumes++;
+	return player;
+}
+
+void ResumeTable::Expire(float time, PODVector<Player*>& expired)
+{
+	expired.Clear();
+	for (HashMap<SecureToken, HeldPlayer>::Iterator i = held.Begin(); i != held.End();)
+	{
+		if (time - i->second_.time > grace)
+		{
+			expired.Push(i->second_.player);
+			i = held.Erase(i);
+			expiries++;
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void ResumeTable::Clear()
+{
+	tokens.Clear();
+	held.Clear();
+}
+
+String ResumeTable::GetDebugText() const
+{
+	return "held " + String(held.Size()) + " (grace " + String(grace) + " s), holds " + String(holds) + " resumes " + String(resumes)
+		+ " expired " + String(expiries) + ", away " + String((int)lastAwayMs) + " ms (max " + String((int)maxAwayMs) + ")";
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+#include "SecureToken.h"
+
+namespace Urho3D
+{
+	class Connection;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class Player;
+
+// a player whose connection dropped, its ship left where it was for the client to come back to
+struct HeldPlayer
+{
+	Player* player;
+	// server time the connection dropped at
+	float time;
+};
+
+// server: a token for each seated player, which its client reconnects with after a drop to get the same ship,
+// score and health back. The ship is held for grace seconds, after that the caller parks it like any other leave
+class ResumeTable
+{
+public:
+	ResumeTable();
+
+	// a token for a connection that has just been given a ship
+	SecureToken Issue(Connection* connection);
+	// 0 when the connection has none
+	SecureToken GetToken(Connection* connection) const;
+
+	// the connection dropped, hold its player under its token; false when it had none or holding is off
+	bool Hold(Connection* connection, Player* player, float time);
+	// the connection left for good, to another shard or with the server stopping
+	void Forget(Connection* connection);
+	// a reconnect with token, the held player and its token move over to connection; null when the token is
+	// unknown or its grace has run out
+	Player* Claim(SecureToken token, Connection* connection, float time);
+	// players held longer than grace, out of the table for the caller to park
+	void Expire(float time, PODVector<Player*>& expired);
+	void Clear();
+
+	unsigned GetHeldCount() const { return held.Size(); }
+	String GetDebugText() const;
+
+	// seconds a dropped player is held, 0 to park it at once
+	float grace;
+
+	// readout
+	unsigned holds;
+	unsigned resumes;
+	unsigned expiries;
+	float lastAwayMs;
+	float maxAwayMs;
+
+private:
+	HashMap<Connection*, SecureToken> tokens;
+	HashMap<SecureToken, HeldPlayer> held;
+};
@@ -0,0 +1,181 @@
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Room.h"
+
+static void ComputeBoidSetWork(const WorkItem* item, unsigned threadIndex)
+{
+	static_cast<BoidSet*>(item->start_)->ComputeForces();
+}
+
+Room::Room(unsigned roomID, Scene* roomScene) :
+	id(roomID),
+	scene(roomScene)
+{
+	serverTime = 0.0f;
+	serverTick = 0;
+	networkUpdates = 0;
+	sendDue = false;
+	forcesReady = false;
+	encoding = false;
+	encodeJob.room = this;
+	encodeJob.feedCount = 0;
+
+	updateCycleIndex = 0;
+	dueFirst = 0;
+	dueLast = 0;
+}
+
+void Room::CreateFlock(ResourceCache* pRes, int boidCount, unsigned seed)
+{
+	RemoveFlock();
+
+	int numOfBoidsets = Max((boidCount + BOIDS_PER_SET * 2 - 1) / (BOIDS_PER_SET * 2) * 2, 2);
+	flock.Resize(numOfBoidsets);
+	ownedSets.Resize(numOfBoidsets);
+	DeterministicRandom random(seed);
+	for (int i = 0; i < numOfBoidsets; i++)
+	{
+		flock[i].Initialise(pRes, scene, random);
+		ownedSets[i] = true;
+		for (int j = 0; j < flock[i].numberOfBoids; j++)
+		{
+			boidNodes.Push(flock[i].boidList[j].GetNode());
+		}
+	}
+}
+
+void Room::RemoveFlock()
+{
+	for (unsigned i = 0; i < boidNodes.Size(); i++)
+	{
+		boidNodes[i]->Remove();
+	}
+	boidNodes.Clear();
+	flock.Clear();
+	ownedSets.Clear();
+	steppedSets.Clear();
+	dueFirst = 0;
+	dueLast = 0;
+}
+
+void Room::QueueFlock(WorkQueue* queue)
+{
+	BeginFlockStep();
+	for (unsigned i = dueFirst; i < dueLast; i++)
+	{
+		if (!steppedSets[i])
+		{
+			continue;
+		}
+		SharedPtr<WorkItem> item = queue->GetFreeItem();
+		item->priority_ = M_MAX_UNSIGNED;
+		item->workFunction_ = ComputeBoidSetWork;
+		item->start_ = &flock[i];
+		queue->AddWorkItem(item);
+	}
+}
+
+void Room::ApplyFlock(float timeStep)
+{
+	for (unsigned i = dueFirst; i < dueLast && i < flock.Size(); i++)
+	{
+		// computed for, and not handed away since
+		if (steppedSets[i] && ownedSets[i])
+		{
+			flock[i].ApplyForces(timeStep);
+		}
+	}
+	forcesReady = false;
+}
+
+void Room::BeginFlockStep()
+{
+	// updating half the boids at a time depending on the update cycle index
+	unsigned half = flock.Size() / 2;
+	dueFirst = updateCycleIndex == 0 ? 0 : half;
+	dueLast = updateCycleIndex == 0 ? half : flock.Size();
+	updateCycleIndex = 1 - updateCycleIndex;
+	steppedSets = ownedSets;
+}
+
+void Room::ComputeFlock(unsigned first, unsigned last)
+{
+	for (unsigned i = dueFirst + first; i < dueFirst + last && i < dueLast; i++)
+	{
+		if (steppedSets[i])
+		{
+			flock[i].ComputeForces();
+		}
+	}
+}
+
+void Room::CaptureBoids(PODVector<Vector3>& positions, PODVector<Vector3>& velocities) const
+{
+	positions.Resize(boidNodes.Size());
+	velocities.Resize(boidNodes.Size());
+	unsigned index = 0;
+	for (unsigned i = 0; i < flock.Size(); i++)
+	{
+		for (int j = 0; j < flock[i].numberOfBoids && index < boidNodes.Size(); j++, index++)
+		{
+			positions[index] = flock[i].boidList[j].GetNode()->GetPosition();
+			velocities[index] = flock[i].boidList[j].GetBody()->GetLinearVelocity();
+		}
+	}
+}
+
+bool Room::PrepareEncode()
+{
+	encodeJob.feedCount = 0;
+	for (int i = 0; i < RATE_TIERS; i++)
+	{
+		if (playerFeeds[i].IsDue(networkUpdates))
+		{
+			encodeJob.feeds[encodeJob.feedCount++] = &playerFeeds[i];
+		}
+	}
+	if (observerFeed.IsDue(networkUpdates))
+	{
+		encodeJob.feeds[encodeJob.feedCount++] = &observerFeed;
+	}
+	encodeJob.update = networkUpdates;
+	encodeJob.time = serverTime;
+	return encodeJob.feedCount > 0;
+}
+
+Player* Room::Remove(Connection* connection)
+{
+	connections.Erase(connection);
+	clientInputs.Erase(connection);
+	for (int i = 0; i < RATE_TIERS; i++)
+	{
+		playerFeeds[i].Remove(connection);
+	}
+	observerFeed.Remove(connection);
+	rateControllers.Erase(connection);
+	lockstepServer.Remove(connection);
+	return serverObjects.Release(connection);
+}
+
+void Room::ClearConnections()
+{
+	connections.Clear();
+	serverObjects.Clear();
+	resumes.Clear();
+	clientInputs.Clear();
+	for (int i = 0; i < RATE_TIERS; i++)
+	{
+		playerFeeds[i].Clear();
+	}
+	observerFeed.Clear();
+	rateControllers.Clear();
+}
+
+String Room::GetDebugText() const
+{
+	return "room " + String(id) + ": " + String(connections.Size()) + " connections, " + String(serverObjects.GetActiveCount())
+		+ " players, " + String(resumes.GetHeldCount()) + " held, " + String(boidNodes.Size()) + " boids, tick " + String(serverTick);
+}
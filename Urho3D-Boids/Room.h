@@ -0,0 +1,122 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/RefCounted.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+#include "Broadcast.h"
+#include "InputStream.h"
+#include "LagCompensation.h"
+#include "Lockstep.h"
+#include "NetworkThread.h"
+#include "PlayerSlots.h"
+#include "RateControl.h"
+#include "Recording.h"
+#include "Resume.h"
+#include "boids.h"
+
+namespace Urho3D
+{
+	class Connection;
+	class Node;
+	class ResourceCache;
+	class Scene;
+	class WorkQueue;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class Room;
+
+// a share of a room's due boid sets, for one frame graph task
+struct FlockSlice
+{
+	Room* room;
+	unsigned first;
+	unsigned last;
+};
+
+// one match: its own scene and physics world, flock, player ships, clock, boid feeds and the connections in it.
+// A process hosts any number of them, sharing the engine, the resource cache and the Network subsystem, which
+// replicates each connection's scene to it. Room 0 is the scene a host or single player plays in
+class Room : public RefCounted
+{
+public:
+	Room(unsigned roomID, Scene* roomScene);
+
+	// whole boid sets, an even number of them for the split update, laid out from seed
+	void CreateFlock(ResourceCache* pRes, int boidCount, unsigned seed);
+	// take the flock out of the scene, a client has the server's instead
+	void RemoveFlock();
+
+	// one work item per boid set due this step, each computes its set's steering; the queue is completed by the
+	// caller, so every room's flock computes at once
+	void QueueFlock(WorkQueue* queue);
+	// apply the steering through Bullet, main thread, after the queue completes
+	void ApplyFlock(float timeStep);
+
+	// QueueFlock in pieces, for the frame graph: pick the half due next step, then compute slices of it on any thread
+	void BeginFlockStep();
+	unsigned GetDueCount() const { return dueLast - dueFirst; }
+	void ComputeFlock(unsigned first, unsigned last);
+
+	// every boid's position and velocity, in boidNodes order, for the boid feeds to write from
+	void CaptureBoids(PODVector<Vector3>& positions, PODVector<Vector3>& velocities) const;
+	// the feeds due at this network update into encodeJob, false when none is
+	bool PrepareEncode();
+
+	// a connection leaves the room, its parked ship if it had one
+	Player* Remove(Connection* connection);
+	// the server has stopped, every connection is gone
+	void ClearConnections();
+
+	String GetDebugText() const;
+
+	unsigned id;
+	SharedPtr<Scene> scene;
+
+	Vector<BoidSet> flock;
+	// the due half's steering was computed ahead by the frame graph, the next step only applies it
+	bool forcesReady;
+	// sets steered here, all of them unless the world is sharded, then the rest are a neighbour's ghosts
+	PODVector<bool> ownedSets;
+	// ownedSets as it was when the due half was picked, a set handed to us after that has no steering computed yet
+	PODVector<bool> steppedSets;
+	// every boid node, in the order the lag compensator and the boid feeds index them
+	PODVector<Node*> boidNodes;
+
+	// Server
+	HashSet<Connection*> connections;
+	PlayerSlotPool serverObjects;
+	// players whose connection dropped, held for their client to resume
+	ResumeTable resumes;
+	LagCompensator lagCompensator;
+	HashMap<Connection*, InputReceiver> clientInputs;
+	// physics time and tick, advanced by the room's own physics steps
+	float serverTime;
+	unsigned serverTick;
+	// boid feeds, one per rate tier for players and one for observers, sequenced by the room's network updates
+	BroadcastGroup playerFeeds[RATE_TIERS];
+	BroadcastGroup observerFeed;
+	unsigned networkUpdates;
+	// a network update has come and the frame graph is to write the feeds' updates
+	bool sendDue;
+	// the flock as the main thread last captured it, for a bootstrap
+	PODVector<Vector3> boidPositions;
+	PODVector<Vector3> boidVelocities;
+	// with the network thread, the feeds' update in flight there; while encoding the feeds' writers are not ours
+	EncodeJob encodeJob;
+	bool encoding;
+	HashMap<Connection*, RateController> rateControllers;
+	LockstepServer lockstepServer;
+	// with --record, the session into a file
+	SessionRecorder recorder;
+
+private:
+	// 0 or 1, which half of the flock steers next
+	int updateCycleIndex;
+	unsigned dueFirst;
+	unsigned dueLast;
+};
@@ -0,0 +1,31 @@
+#include <random>
+
+#include <Urho3D/Math/MathDefs.h>
+
+#include "SecureToken.h"
+
+SecureToken NewSecureToken()
+{
+	// random_device reads the OS generator (/dev/urandom, or RtlGenRandom on Windows), slow but only called per join
+	static std::random_device device;
+	SecureToken token = 0;
+	while (token == 0)
+	{
+		token = MakeToken(device(), device());
+	}
+	return token;
+}
+
+bool SecretsMatch(const String& given, const String& expected)
+{
+	// every byte of the longer one is looked at whatever the others hold
+	unsigned length = Max(given.Length(), expected.Length());
+	unsigned difference = given.Length() ^ expected.Length();
+	for (unsigned i = 0; i < length; i++)
+	{
+		unsigned char a = i < given.Length() ? (unsigned char)given[i] : 0;
+		unsigned char b = i < expected.Length() ? (unsigned char)expected[i] : 0;
+		difference |= a ^ b;
+	}
+	return difference == 0;
+}
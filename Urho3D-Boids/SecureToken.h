@@ -0,0 +1,18 @@
+#pragma once
+#include <Urho3D/Container/Str.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// A token a server hands a client for it to claim something back with later, a ship on another shard or its ship
+// after a drop. 64 bits from the OS's secure random source, so holding one tells nothing about any other; never 0
+typedef unsigned long long SecureToken;
+
+SecureToken NewSecureToken();
+// compares a secret taken from a peer against ours in time that does not depend on where they differ
+bool SecretsMatch(const String& given, const String& expected);
+
+// game messages carry it as two 32 bit fields
+inline unsigned GetTokenHigh(SecureToken token) { return (unsigned)(token >> 32); }
+inline unsigned GetTokenLow(SecureToken token) { return (unsigned)token; }
+inline SecureToken MakeToken(unsigned high, unsigned low) { return ((SecureToken)high << 32) | low; }
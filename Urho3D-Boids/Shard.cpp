@@ -0,0 +1,341 @@
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "Room.h"
+#include "Shard.h"
+
+Shard::Shard()
+{
+	index = 0;
+	count = 1;
+	width = 60.0f;
+	basePort = 0;
+	margin = 30.0f;
+	hysteresis = 5.0f;
+	arrivalTimeout = 10.0f;
+
+	links[SHARD_LEFT] = nullptr;
+	links[SHARD_RIGHT] = nullptr;
+
+	setsIn = 0;
+	setsOut = 0;
+	setsReclaimed = 0;
+	playersIn = 0;
+	playersOut = 0;
+	ghostsIn = 0;
+}
+
+void Shard::Initialise(int shardIndex, int shardCount, float slabWidth, unsigned short firstPort, Room& room)
+{
+	count = Max(shardCount, 1);
+	index = Clamp(shardIndex, 0, count - 1);
+	width = Max(slabWidth, 1.0f);
+	basePort = firstPort;
+
+	// the same seed lays out the same flock on every shard, so they all agree on who starts with which set
+	for (unsigned i = 0; i < room.flock.Size(); i++)
+	{
+		room.ownedSets[i] = GetShardAt(GetCentre(room.flock[i]).x_) == index;
+	}
+	UpdateGhosts(room);
+}
+
+int Shard::GetShardAt(float x) const
+{
+	return Clamp(FloorToInt(x / width + count * 0.5f), 0, count - 1);
+}
+
+int Shard::GetNeighbour(int side) const
+{
+	int neighbour = side == SHARD_LEFT ? index - 1 : index + 1;
+	return neighbour >= 0 && neighbour < count ? neighbour : -1;
+}
+
+void Shard::SetLink(int side, Connection* connection)
+{
+	links[side] = connection;
+}
+
+int Shard::GetLinkSide(Connection* connection) const
+{
+	if (!connection)
+	{
+		return -1;
+	}
+	if (links[SHARD_LEFT] == connection)
+	{
+		return SHARD_LEFT;
+	}
+	return links[SHARD_RIGHT] == connection ? SHARD_RIGHT : -1;
+}
+
+void Shard::RemoveLink(Connection* connection, Room& room)
+{
+	int side = GetLinkSide(connection);
+	if (side < 0)
+	{
+		return;
+	}
+	links[side] = nullptr;
+
+	// the neighbour may or may not have had these, if it did we both steer them until one hands them over again
+	for (unsigned i = 0; i < pending[side].Size(); i++)
+	{
+		room.ownedSets[pending[side][i]] = true;
+		setsReclaimed++;
+	}
+	pending[side].Clear();
+	UpdateGhosts(room);
+}
+
+bool Shard::WriteHandoffs(Room& room, int side, VectorBuffer& message)
+{
+	message.Clear();
+	if (!links[side])
+	{
+		return false;
+	}
+
+	PODVector<unsigned> leaving;
+	for (unsigned i = 0; i < room.flock.Size(); i++)
+	{
+		if (room.ownedSets[i] && GetCrossing(GetCentre(room.flock[i])) == side)
+		{
+			leaving.Push(i);
+		}
+	}
+	if (leaving.Empty())
+	{
+		return false;
+	}
+
+	message.WriteVLE(leaving.Size());
+	for (unsigned i = 0; i < leaving.Size(); i++)
+	{
+		WriteSet(room.flock[leaving[i]], leaving[i], message);
+		room.ownedSets[leaving[i]] = false;
+		pending[side].Push(leaving[i]);
+		setsOut++;
+	}
+	return true;
+}
+
+void Shard::ReadHandoffs(Room& room, MemoryBuffer& message, VectorBuffer& ack)
+{
+	PODVector<unsigned> received;
+	unsigned sets = message.ReadVLE();
+	for (unsigned i = 0; i < sets && !message.IsEof(); i++)
+	{
+		int setIndex = ReadSet(room, message, true);
+		if (setIndex >= 0)
+		{
+			received.Push((unsigned)setIndex);
+			setsIn++;
+		}
+	}
+	UpdateGhosts(room);
+
+	ack.Clear();
+	ack.WriteVLE(received.Size());
+	for (unsigned i = 0; i < received.Size(); i++)
+	{
+		ack.WriteVLE(received[i]);
+	}
+}
+
+void Shard::ReadHandoffAck(int side, MemoryBuffer& message)
+{
+	unsigned sets = message.ReadVLE();
+	for (unsigned i = 0; i < sets && !message.IsEof(); i++)
+	{
+		pending[side].Remove(message.ReadVLE());
+	}
+}
+
+bool Shard::WriteGhosts(const Room& room, int side, VectorBuffer& message)
+{
+	message.Clear();
+	if (!links[side])
+	{
+		return false;
+	}
+
+	PODVector<unsigned> nearby;
+	for (unsigned i = 0; i < room.flock.Size(); i++)
+	{
+		float x = GetCentre(room.flock[i]).x_;
+		if (room.ownedSets[i] && (side == SHARD_LEFT ? x < GetMinX() + margin : x > GetMaxX() - margin))
+		{
+			nearby.Push(i);
+		}
+	}
+	if (nearby.Empty())
+	{
+		return false;
+	}
+
+	message.WriteVLE(nearby.Size());
+	for (unsigned i = 0; i < nearby.Size(); i++)
+	{
+		WriteSet(room.flock[nearby[i]], nearby[i], message);
+	}
+	return true;
+}
+
+void Shard::ReadGhosts(Room& room, MemoryBuffer& message)
+{
+	unsigned sets = message.ReadVLE();
+	for (unsigned i = 0; i < sets && !message.IsEof(); i++)
+	{
+		if (ReadSet(room, message, false) >= 0)
+		{
+			ghostsIn++;
+		}
+	}
+}
+
+void Shard::UpdateGhosts(Room& room)
+{
+	for (unsigned i = 0; i < room.flock.Size(); i++)
+	{
+		BoidSet& set = room.flock[i];
+		float x = GetCentre(set).x_;
+		bool enabled = room.ownedSets[i] || (x >= GetMinX() - margin && x <= GetMaxX() + margin);
+		for (int j = 0; j < set.numberOfBoids; j++)
+		{
+			Node* node = set.boidList[j].GetNode();
+			if (node->IsEnabled() != enabled)
+			{
+				node->SetEnabled(enabled);
+			}
+		}
+	}
+}
+
+int Shard::GetCrossing(const Vector3& position) const
+{
+	if (index > 0 && position.x_ < GetMinX() - hysteresis)
+	{
+		return SHARD_LEFT;
+	}
+	if (index < count - 1 && position.x_ > GetMaxX() + hysteresis)
+	{
+		return SHARD_RIGHT;
+	}
+	return -1;
+}
+
+void Shard::AddArrival(const ShardPlayerMessage& handoff, float time)
+{
+	ShardArrival& arrival = arrivals[MakeToken(handoff.ticketHigh, handoff.ticketLow)];
+	arrival.position = Vector3(handoff.x, handoff.y, handoff.z);
+	arrival.score = handoff.score;
+	arrival.health = handoff.health;
+	arrival.time = time;
+}
+
+bool Shard::TakeArrival(SecureToken ticket, ShardArrival& arrival)
+{
+	HashMap<SecureToken, ShardArrival>::Iterator i = arrivals.Find(ticket);
+	if (i == arrivals.End())
+	{
+		return false;
+	}
+	arrival = i->second_;
+	arrivals.Erase(i);
+	playersIn++;
+	return true;
+}
+
+void Shard::ExpireArrivals(float time)
+{
+	for (HashMap<SecureToken, ShardArrival>::Iterator i = arrivals.Begin(); i != arrivals.End();)
+	{
+		if (time - i->second_.time > arrivalTimeout)
+		{
+			i = arrivals.Erase(i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+String Shard::GetDebugText(const Room& room) const
+{
+	unsigned owned = 0;
+	for (unsigned i = 0; i < room.ownedSets.Size(); i++)
+	{
+		owned += room.ownedSets[i] ? 1 : 0;
+	}
+	return "shard " + String(index) + " of " + String(count) + ", x " + String(GetMinX()) + " to " + String(GetMaxX()) + ", "
+		+ String(owned) + " of " + String(room.flock.Size()) + " sets, links " + String(links[SHARD_LEFT] ? "L" : "-")
+		+ String(links[SHARD_RIGHT] ? "R" : "-") + ", sets in " + String(setsIn) + " out " + String(setsOut) + " reclaimed "
+		+ String(setsReclaimed) + ", players in " + String(playersIn) + " out " + String(playersOut) + ", ghost sets " + String(ghostsIn);
+}
+
+float Shard::GetMinX() const
+{
+	return index == 0 ? -M_INFINITY : (index - count * 0.5f) * width;
+}
+
+float Shard::GetMaxX() const
+{
+	return index == count - 1 ? M_INFINITY : (index + 1 - count * 0.5f) * width;
+}
+
+Vector3 Shard::GetCentre(const BoidSet& set) const
+{
+	Vector3 centre;
+	for (int i = 0; i < set.numberOfBoids; i++)
+	{
+		centre += set.boidList[i].GetBody()->GetPosition();
+	}
+	return centre / (float)Max(set.numberOfBoids, 1);
+}
+
+void Shard::WriteSet(const BoidSet& set, unsigned setIndex, VectorBuffer& message) const
+{
+	message.WriteVLE(setIndex);
+	for (int i = 0; i < set.numberOfBoids; i++)
+	{
+		RigidBody* body = set.boidList[i].GetBody();
+		message.WriteVector3(body->GetPosition());
+		message.WriteVector3(body->GetLinearVelocity());
+	}
+}
+
+int Shard::ReadSet(Room& room, MemoryBuffer& message, bool handoff)
+{
+	unsigned setIndex = message.ReadVLE();
+	Vector3 positions[BOIDS_PER_SET];
+	Vector3 velocities[BOIDS_PER_SET];
+	for (int i = 0; i < BOIDS_PER_SET; i++)
+	{
+		positions[i] = message.ReadVector3();
+		velocities[i] = message.ReadVector3();
+	}
+
+	// ghosts are unreliable, one that arrives after the set was handed to us is older than what we have
+	if (setIndex >= room.flock.Size() || (!handoff && room.ownedSets[setIndex]))
+	{
+		return -1;
+	}
+
+	BoidSet& set = room.flock[setIndex];
+	for (int i = 0; i < set.numberOfBoids; i++)
+	{
+		RigidBody* body = set.boidList[i].GetBody();
+		body->SetPosition(positions[i]);
+		body->SetLinearVelocity(velocities[i]);
+		body->SetRotation(boids::Heading(velocities[i]));
+	}
+	if (handoff)
+	{
+		room.ownedSets[setIndex] = true;
+	}
+	return (int)setIndex;
+}
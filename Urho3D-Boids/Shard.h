@@ -0,0 +1,121 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Math/Vector3.h>
+
+#include "GameMessages.h"
+#include "SecureToken.h"
+
+namespace Urho3D
+{
+	class Connection;
+	class MemoryBuffer;
+	class VectorBuffer;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class BoidSet;
+class Room;
+
+// custom network messages between neighbouring shards, players go across as a ShardPlayerMessage
+static const int MSG_SHARDGHOSTS = 0x20b;
+static const int MSG_SHARDSETS = 0x20c;
+static const int MSG_SHARDSETSACK = 0x211;
+
+// sides of a shard, towards lower and higher x
+static const int SHARD_LEFT = 0;
+static const int SHARD_RIGHT = 1;
+
+// a player handed over by a neighbour, waiting for its client to arrive with the ticket
+struct ShardArrival
+{
+	Vector3 position;
+	int score;
+	int health;
+	float time;
+};
+
+// One of several server processes on a host that split the arena into slabs along x. Shard i owns
+// [(i - count / 2) * width, (i + 1 - count / 2) * width), the two end slabs are open ended.
+// Every shard lays out the whole flock from the same seed, but only steers the boid sets whose centre is in its
+// slab. The other sets are ghosts, moved by the state their owner sends for sets near the boundary and disabled
+// further out. A set whose centre crosses a boundary is handed to the neighbour with its state; a player whose ship
+// crosses one is handed over too, and its client is redirected to the neighbour's port.
+// Each shard connects as a client to the shard on its right, so it has one outbound link and one inbound
+class Shard
+{
+public:
+	Shard();
+
+	// every set whose centre is in the slab is owned, the rest are ghosts until a neighbour says otherwise
+	void Initialise(int shardIndex, int shardCount, float slabWidth, unsigned short firstPort, Room& room);
+	bool IsEnabled() const { return count > 1; }
+
+	int GetShardAt(float x) const;
+	unsigned short GetPort(int shard) const { return (unsigned short)(basePort + shard); }
+	// the neighbour on a side, -1 past either end
+	int GetNeighbour(int side) const;
+
+	// ghosts, hand offs and players only go to a side while it is linked
+	void SetLink(int side, Connection* connection);
+	// the side a connection links to, -1 when it is not a link
+	int GetLinkSide(Connection* connection) const;
+	// sets handed over on the link and not yet acked are steered here again
+	void RemoveLink(Connection* connection, Room& room);
+
+	// owned sets whose centre has gone past the boundary with side by the hysteresis, no longer steered here. They
+	// stay pending until the neighbour acks them, so a link lost in between does not leave them owned by nobody
+	bool WriteHandoffs(Room& room, int side, VectorBuffer& message);
+	// the sets are ours, ack lists them for the sender
+	void ReadHandoffs(Room& room, MemoryBuffer& message, VectorBuffer& ack);
+	void ReadHandoffAck(int side, MemoryBuffer& message);
+	// owned sets within the margin of the boundary with side, the neighbour shows them as ghosts
+	bool WriteGhosts(const Room& room, int side, VectorBuffer& message);
+	void ReadGhosts(Room& room, MemoryBuffer& message);
+	// ghosts within the margin of the slab take part in physics, missile hits and ship collisions, the rest wait disabled
+	void UpdateGhosts(Room& room);
+
+	// the side a ship at position has crossed to, -1 while it is still ours
+	int GetCrossing(const Vector3& position) const;
+	void AddArrival(const ShardPlayerMessage& handoff, float time);
+	// the arrival for a ticket, removed; false for one that is unknown or has expired
+	bool TakeArrival(SecureToken ticket, ShardArrival& arrival);
+	void ExpireArrivals(float time);
+
+	String GetDebugText(const Room& room) const;
+
+	int index;
+	int count;
+	float width;
+	unsigned short basePort;
+	// how far past the boundary ghosts are sent and kept enabled, how far past it an owner hands over
+	float margin;
+	float hysteresis;
+	// seconds a handed over player is held for its client
+	float arrivalTimeout;
+
+	Connection* links[2];
+	// sets handed to each side and not yet acked
+	PODVector<unsigned> pending[2];
+	HashMap<SecureToken, ShardArrival> arrivals;
+	// clients already sent to a neighbour, their ship stays until they disconnect
+	HashSet<Connection*> redirected;
+
+	// readout
+	unsigned setsIn;
+	unsigned setsOut;
+	unsigned setsReclaimed;
+	unsigned playersIn;
+	unsigned playersOut;
+	unsigned ghostsIn;
+
+private:
+	float GetMinX() const;
+	float GetMaxX() const;
+	Vector3 GetCentre(const BoidSet& set) const;
+	void WriteSet(const BoidSet& set, unsigned setIndex, VectorBuffer& message) const;
+	// the set's state onto our copy, a hand off makes it ours; its index, or -1 for a set we do not have or a late ghost
+	int ReadSet(Room& room, MemoryBuffer& message, bool handoff);
+};
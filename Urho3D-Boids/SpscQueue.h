@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+
+// A fixed size ring between exactly one producer thread and one consumer thread, no locks. The producer only
+// writes tail and the consumer only writes head; each publishes with a release store that the other side's
+// acquire load pairs with, so an item is fully written before it can be seen. CAPACITY is a power of two
+template <class T, unsigned CAPACITY> class SpscQueue
+{
+	static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+	SpscQueue() :
+		head(0),
+		tail(0),
+		peak(0)
+	{
+	}
+
+	// producer: false when the queue is full, the item is not taken
+	bool Push(const T& item)
+	{
+		unsigned t = tail.load(std::memory_order_relaxed);
+		unsigned size = t - head.load(std::memory_order_acquire);
+		if (size >= CAPACITY)
+		{
+			return false;
+		}
+		items[t & (CAPACITY - 1)] = item;
+		tail.store(t + 1, std::memory_order_release);
+
+		if (size + 1 > peak.load(std::memory_order_relaxed))
+		{
+			peak.store(size + 1, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	// consumer: false when the queue is empty
+	bool Pop(T& item)
+	{
+		unsigned h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		item = items[h & (CAPACITY - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// either side, already out of date on the other
+	unsigned Size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+	bool Empty() const { return Size() == 0; }
+	unsigned GetCapacity() const { return CAPACITY; }
+	// most items waiting at once since the start
+	unsigned GetPeak() const { return peak.load(std::memory_order_relaxed); }
+
+private:
+	// apart, so the two threads do not fight over one cache line
+	alignas(64) std::atomic<unsigned> head;
+	alignas(64) std::atomic<unsigned> tail;
+	std::atomic<unsigned> peak;
+	T items[CAPACITY];
+};
@@ -0,0 +1,497 @@
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/Math/MathDefs.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Network/Protocol.h>
+
+#include <kNet/IMessageHandler.h>
+#include <kNet/MessageConnection.h>
+#include <kNet/Network.h>
+#include <kNet/NetworkMessage.h>
+
+#include <cstring>
+
+#include "GameMessages.h"
+#include "InputStream.h"
+#include "Traffic.h"
+
+static const unsigned CAPTURE_VERSION = 1;
+// type, time, client and payload size
+static const unsigned CAPTURE_HEADER_SIZE = 11;
+
+TrafficCapture::TrafficCapture()
+{
+	clients = 0;
+	messages = 0;
+	bytesWritten = 0;
+	bytesPerSecond = 0.0f;
+
+	recordStart = 0;
+	startTime = 0.0f;
+	lastFlush = 0.0f;
+	reportBytes = 0;
+	nextID = 1;
+}
+
+TrafficCapture::~TrafficCapture()
+{
+	Close();
+}
+
+bool TrafficCapture::Open(Context* context, const String& fileName, int tickRate, unsigned worldChecksum, float time)
+{
+	Close();
+	file = new File(context, fileName, FILE_WRITE);
+	if (!file->IsOpen())
+	{
+		file.Reset();
+		return false;
+	}
+
+	startTime = time;
+	lastFlush = time;
+	ids.Clear();
+	nextID = 1;
+	clients = 0;
+	messages = 0;
+	bytesWritten = 0;
+	reportBytes = 0;
+
+	pending.Clear();
+	pending.WriteFileID("BCAP");
+	pending.WriteUInt(CAPTURE_VERSION);
+	pending.WriteUInt((unsigned)tickRate);
+	pending.WriteUInt(worldChecksum);
+	Flush();
+	return true;
+}
+
+void TrafficCapture::Close()
+{
+	if (file)
+	{
+		Flush();
+		file->Close();
+		file.Reset();
+	}
+}
+
+void TrafficCapture::RecordConnect(Connection* connection, float time, const VariantMap& identity)
+{
+	if (!file)
+	{
+		return;
+	}
+	BeginRecord(CAPTURE_CONNECT, time, GetID(connection));
+	pending.WriteVariantMap(identity);
+	EndRecord();
+	clients++;
+}
+
+void TrafficCapture::RecordSceneLoaded(Connection* connection, float time)
+{
+	if (!file || !ids.Contains(connection))
+	{
+		return;
+	}
+	BeginRecord(CAPTURE_SCENELOADED, time, GetID(connection));
+	EndRecord();
+}
+
+void TrafficCapture::RecordMessage(Connection* connection, float time, int messageID, const PODVector<unsigned char>& data)
+{
+	// only clients seen connecting, a replay could not bring any other back
+	if (!file || !ids.Contains(connection))
+	{
+		return;
+	}
+	BeginRecord(CAPTURE_MESSAGE, time, GetID(connection));
+	pending.WriteUShort((unsigned short)messageID);
+	pending.Write(data.Buffer(), data.Size());
+	EndRecord();
+	messages++;
+}
+
+void TrafficCapture::RecordDisconnect(Connection* connection, float time)
+{
+	HashMap<Connection*, unsigned short>::Iterator id = ids.Find(connection);
+	if (!file || id == ids.End())
+	{
+		return;
+	}
+	BeginRecord(CAPTURE_DISCONNECT, time, id->second_);
+	EndRecord();
+	ids.Erase(id);
+}
+
+void TrafficCapture::Update(float time)
+{
+	if (!file || time - lastFlush < 1.0f)
+	{
+		return;
+	}
+	Flush();
+	bytesPerSecond = (bytesWritten - reportBytes) / (time - lastFlush);
+	reportBytes = bytesWritten;
+	lastFlush = time;
+}
+
+String TrafficCapture::GetDebugText() const
+{
+	return String(clients) + " clients, " + String(messages) + " messages, " + String((int)(bytesPerSecond / 1024.0f)) + " KB/s, "
+		+ String(bytesWritten / 1024) + " KB written";
+}
+
+unsigned short TrafficCapture::GetID(Connection* connection)
+{
+	HashMap<Connection*, unsigned short>::ConstIterator id = ids.Find(connection);
+	if (id != ids.End())
+	{
+		return id->second_;
+	}
+	unsigned short newID = nextID++;
+	ids[connection] = newID;
+	return newID;
+}
+
+void TrafficCapture::BeginRecord(CaptureType type, float time, unsigned short id)
+{
+	recordStart = pending.GetPosition();
+	pending.WriteUByte((unsigned char)type);
+	pending.WriteUInt((unsigned)(Max(time - startTime, 0.0f) * 1000.0f));
+	pending.WriteUShort(id);
+	pending.WriteUInt(0);
+}
+
+void TrafficCapture::EndRecord()
+{
+	unsigned end = pending.GetPosition();
+	pending.Seek(recordStart + 7);
+	pending.WriteUInt(end - recordStart - CAPTURE_HEADER_SIZE);
+	pending.Seek(end);
+}
+
+void TrafficCapture::Flush()
+{
+	if (pending.GetSize() > 0)
+	{
+		file->Write(pending.GetData(), pending.GetSize());
+		file->Flush();
+		bytesWritten += pending.GetSize();
+		pending.Clear();
+	}
+}
+
+// as Urho3D's Connection queues a message, clear of the SendMessage name windows.h takes over
+static void SendRaw(kNet::MessageConnection* connection, int messageID, bool reliable, const void* data, unsigned size)
+{
+	kNet::NetworkMessage* message = connection->StartNewMessage((unsigned long)messageID, size);
+	if (!message)
+	{
+		return;
+	}
+	message->reliable = reliable;
+	message->inOrder = reliable;
+	message->priority = 0;
+	message->contentID = 0;
+	if (size > 0)
+	{
+		memcpy(message->data, data, size);
+	}
+	connection->EndAndQueueMessage(message);
+}
+
+struct ReplayClient : public kNet::IMessageHandler
+{
+	// what the server sends is only counted, the replay does not play the client's side
+	void HandleMessage(kNet::MessageConnection* source, kNet::packet_id_t packetID, kNet::message_id_t messageID, const char* data,
+		size_t numBytes) override
+	{
+		bytesReceived += numBytes;
+	}
+
+	// the captured client it plays, and its next record
+	unsigned captured;
+	unsigned next;
+	unsigned room;
+	kNet::SharedPtr<kNet::MessageConnection> connection;
+	bool finished;
+	unsigned long long bytesReceived;
+};
+
+TrafficReplay::TrafficReplay()
+{
+	tickRate = 60;
+	worldChecksum = 0;
+	duration = 0.0f;
+
+	messagesSent = 0;
+	bytesSent = 0;
+	bytesReceived = 0;
+	dropped = 0;
+	replayTime = 0.0f;
+
+	records = 0;
+	network = nullptr;
+	serverPort = 0;
+	totalAllocations = 0;
+	totalAllocatedBytes = 0;
+	maxAllocations = 0;
+}
+
+TrafficReplay::~TrafficReplay()
+{
+	Stop();
+}
+
+bool TrafficReplay::Open(const String& fileName)
+{
+	clientRecords.Clear();
+	records = 0;
+	if (!mapped.Open(fileName))
+	{
+		return false;
+	}
+
+	MemoryBuffer buffer(mapped.GetData(), mapped.GetSize());
+	if (buffer.ReadFileID() != "BCAP" || buffer.ReadUInt() != CAPTURE_VERSION)
+	{
+		mapped.Close();
+		return false;
+	}
+	tickRate = Max((int)buffer.ReadUInt(), 1);
+	worldChecksum = buffer.ReadUInt();
+
+	// a capture the server is still writing ends in the middle of a record, the whole ones before it are used
+	unsigned offset = buffer.GetPosition();
+	while (offset + CAPTURE_HEADER_SIZE <= mapped.GetSize())
+	{
+		MemoryBuffer header(mapped.GetData() + offset, CAPTURE_HEADER_SIZE);
+		unsigned char type = header.ReadUByte();
+		unsigned time = header.ReadUInt();
+		unsigned short id = header.ReadUShort();
+		unsigned payload = header.ReadUInt();
+		if (payload > mapped.GetSize() - offset - CAPTURE_HEADER_SIZE)
+		{
+			break;
+		}
+
+		if (id >= clientRecords.Size())
+		{
+			clientRecords.Resize(id + 1);
+		}
+		// a client is only played from its connect on
+		if (type == CAPTURE_CONNECT || !clientRecords[id].Empty())
+		{
+			clientRecords[id].Push(offset);
+			records++;
+		}
+		duration = Max(duration, time / 1000.0f);
+		offset += CAPTURE_HEADER_SIZE + payload;
+	}
+	return true;
+}
+
+bool TrafficReplay::Start(unsigned short port, int copies)
+{
+	Stop();
+	network = new kNet::Network();
+	serverPort = port;
+	for (int copy = 0; copy < copies; copy++)
+	{
+		for (unsigned i = 0; i < clientRecords.Size(); i++)
+		{
+			if (clientRecords[i].Empty())
+			{
+				continue;
+			}
+			ReplayClient* client = new ReplayClient();
+			client->captured = i;
+			client->next = 0;
+			client->room = 0;
+			client->finished = false;
+			client->bytesReceived = 0;
+			clients.Push(client);
+		}
+	}
+	replayTime = 0.0f;
+	return !clients.Empty();
+}
+
+bool TrafficReplay::Update(float time, const PODVector<unsigned>& sceneChecksums)
+{
+	replayTime = time;
+	bool finished = true;
+	bytesReceived = 0;
+	for (unsigned i = 0; i < clients.Size(); i++)
+	{
+		if (!UpdateClient(*clients[i], time, sceneChecksums))
+		{
+			finished = false;
+		}
+		bytesReceived += clients[i]->bytesReceived;
+	}
+	return !finished || time < duration + 1.0f;
+}
+
+bool TrafficReplay::UpdateClient(ReplayClient& client, float time, const PODVector<unsigned>& sceneChecksums)
+{
+	kNet::MessageConnection* connection = client.connection.ptr();
+	if (connection)
+	{
+		connection->Process();
+	}
+	if (client.finished)
+	{
+		return true;
+	}
+
+	const PODVector<unsigned>& offsets = clientRecords[client.captured];
+	while (client.next < offsets.Size())
+	{
+		unsigned offset = offsets[client.next];
+		MemoryBuffer header(mapped.GetData() + offset, CAPTURE_HEADER_SIZE);
+		unsigned char type = header.ReadUByte();
+		unsigned recordTime = header.ReadUInt();
+		header.ReadUShort();
+		unsigned size = header.ReadUInt();
+		if (recordTime / 1000.0f > time)
+		{
+			return false;
+		}
+		MemoryBuffer payload(mapped.GetData() + offset + CAPTURE_HEADER_SIZE, size);
+
+		// what a Urho3D client does on connecting: wait for kNet's handshake, then send its identity
+		if (type == CAPTURE_CONNECT)
+		{
+			if (!connection)
+			{
+				client.connection = network->Connect("127.0.0.1", serverPort, kNet::SocketOverUDP, &client);
+				connection = client.connection.ptr();
+				if (!connection)
+				{
+					URHO3D_LOGERROR("Replay client could not connect to port " + String(serverPort));
+					dropped++;
+					client.finished = true;
+					return true;
+				}
+			}
+			if (connection->GetConnectionState() == kNet::ConnectionPending)
+			{
+				return false;
+			}
+		}
+		if (connection->GetConnectionState() != kNet::ConnectionOK)
+		{
+			// the server turned it away or timed it out, the rest of its capture has nowhere to go
+			dropped++;
+			client.finished = true;
+			return true;
+		}
+
+		VectorBuffer message;
+		switch (type)
+		{
+		case CAPTURE_CONNECT:
+		{
+			VariantMap identity = payload.ReadVariantMap();
+			client.room = identity["RoomID"].GetUInt();
+			message.WriteVariantMap(identity);
+			SendRaw(connection, MSG_IDENTITY, true, message.GetData(), message.GetSize());
+			break;
+		}
+
+		case CAPTURE_SCENELOADED:
+			message.WriteUInt(client.room < sceneChecksums.Size() ? sceneChecksums[client.room] : 0);
+			SendRaw(connection, MSG_SCENELOADED, true, message.GetData(), message.GetSize());
+			break;
+
+		case CAPTURE_MESSAGE:
+		{
+			// the way the game's client sends each, input and pings are the only unreliable ones
+			int messageID = payload.ReadUShort();
+			bool reliable = messageID != MSG_INPUTFRAMES && messageID != MSG_CLOCKPING;
+			unsigned dataSize = payload.GetSize() - payload.GetPosition();
+			SendRaw(connection, messageID, reliable, payload.GetData() + payload.GetPosition(), dataSize);
+			messagesSent++;
+			bytesSent += dataSize;
+			break;
+		}
+
+		case CAPTURE_DISCONNECT:
+			connection->Disconnect(0);
+			client.finished = true;
+			return true;
+
+		default:
+			break;
+		}
+		client.next++;
+	}
+
+	// the capture ended with the client still playing, it stays connected until the replay stops
+	client.finished = true;
+	return true;
+}
+
+void TrafficReplay::OnFrame(long long usec, unsigned allocations, unsigned allocatedBytes)
+{
+	frameUsec.Push((unsigned)usec);
+	totalAllocations += allocations;
+	totalAllocatedBytes += allocatedBytes;
+	maxAllocations = Max(maxAllocations, allocations);
+}
+
+void TrafficReplay::Stop()
+{
+	for (unsigned i = 0; i < clients.Size(); i++)
+	{
+		if (clients[i]->connection.ptr())
+		{
+			clients[i]->connection->Disconnect(0);
+		}
+		delete clients[i];
+	}
+	clients.Clear();
+
+	// the connections go before the network that owns their sockets
+	delete network;
+	network = nullptr;
+}
+
+String TrafficReplay::GetInfo() const
+{
+	unsigned captured = 0;
+	for (unsigned i = 0; i < clientRecords.Size(); i++)
+	{
+		captured += clientRecords[i].Empty() ? 0 : 1;
+	}
+	return String(captured) + " clients, " + String(records) + " records over " + String(duration) + " s, captured at "
+		+ String(tickRate) + " Hz";
+}
+
+String TrafficReplay::GetDebugText(float wallSeconds) const
+{
+	if (frameUsec.Empty())
+	{
+		return "no frames";
+	}
+	PODVector<unsigned> sorted = frameUsec;
+	Sort(sorted.Begin(), sorted.End());
+	unsigned long long total = 0;
+	for (unsigned i = 0; i < sorted.Size(); i++)
+	{
+		total += sorted[i];
+	}
+	unsigned frames = sorted.Size();
+
+	return String(frames) + " frames in " + String(wallSeconds) + " s (" + String(wallSeconds > 0.0f ? replayTime / wallSeconds : 0.0f)
+		+ "x), tick avg " + String(total / 1000.0f / frames) + " ms p50 " + String(sorted[frames / 2] / 1000.0f) + " ms p99 "
+		+ String(sorted[frames * 99 / 100] / 1000.0f) + " ms max " + String(sorted.Back() / 1000.0f) + " ms, allocations avg "
+		+ String((float)totalAllocations / frames) + " max " + String(maxAllocations) + " ("
+		+ String((int)(totalAllocatedBytes / frames)) + " bytes) per frame, " + String(clients.Size()) + " clients sent "
+		+ String(messagesSent) + " messages (" + String(bytesSent / 1024) + " KB) and got " + String((unsigned)(bytesReceived / 1024))
+		+ " KB back, " + String(dropped) + " dropped";
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Variant.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+#include <kNet/kNetFwd.h>
+
+#include "Recording.h"
+
+namespace Urho3D
+{
+	class Connection;
+	class Context;
+	class File;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// A capture is what the server's clients sent it, as it arrived: a header, then records of a type byte, the time in
+// ms since the capture started, the client's number in the file and the payload size, then the payload. Flat and
+// only appended to, like a session recording. Urho3D's own messages (identity, scene loaded, controls) never reach
+// the game, the capture keeps the identity and when the scene loaded and a replay sends those itself
+enum CaptureType
+{
+	// the client's identity, once it has one
+	CAPTURE_CONNECT = 1,
+	CAPTURE_SCENELOADED,
+	// a game message, its ID and data
+	CAPTURE_MESSAGE,
+	CAPTURE_DISCONNECT
+};
+
+// server: every client's messages into one file, from the main thread, written out once a second
+class TrafficCapture
+{
+public:
+	TrafficCapture();
+	~TrafficCapture();
+
+	// time is the server's elapsed time, records are stamped from it
+	bool Open(Context* context, const String& fileName, int tickRate, unsigned worldChecksum, float time);
+	void Close();
+	bool IsOpen() const { return file.NotNull(); }
+
+	void RecordConnect(Connection* connection, float time, const VariantMap& identity);
+	void RecordSceneLoaded(Connection* connection, float time);
+	void RecordMessage(Connection* connection, float time, int messageID, const PODVector<unsigned char>& data);
+	void RecordDisconnect(Connection* connection, float time);
+
+	// writes what is pending once a second
+	void Update(float time);
+
+	String GetDebugText() const;
+
+	// readout
+	unsigned clients;
+	unsigned messages;
+	unsigned bytesWritten;
+	float bytesPerSecond;
+
+private:
+	unsigned short GetID(Connection* connection);
+	void BeginRecord(CaptureType type, float time, unsigned short id);
+	void EndRecord();
+	void Flush();
+
+	SharedPtr<File> file;
+	VectorBuffer pending;
+	unsigned recordStart;
+	float startTime;
+	float lastFlush;
+	unsigned reportBytes;
+
+	HashMap<Connection*, unsigned short> ids;
+	unsigned short nextID;
+};
+
+// one captured client played back over its own loopback connection
+struct ReplayClient;
+
+// A capture sent back into this process's server, each captured client through a kNet connection of its own on
+// localhost, so the server reads, replicates and sends to them as it would to players. Messages go when the replay
+// clock reaches their capture time; the clock is the server's simulation time, so with the server stepping one tick
+// a frame the replay runs as fast as the frame limiter lets it. What the server sends back is read and counted
+// and thrown away
+class TrafficReplay
+{
+public:
+	TrafficReplay();
+	~TrafficReplay();
+
+	// maps the file, checks the header and sorts the records by client
+	bool Open(const String& fileName);
+	// connect copies times over, each copy of a client is a client of its own
+	bool Start(unsigned short port, int copies);
+
+	// send what is due by time; sceneChecksums is each room's, a client's scene loaded needs it. False once
+	// every client has finished and the server has had a second to settle
+	bool Update(float time, const PODVector<unsigned>& sceneChecksums);
+	// a server frame's work and allocations, see ServerTickStats
+	void OnFrame(long long usec, unsigned allocations, unsigned allocatedBytes);
+
+	void Stop();
+
+	// what the file holds, one line
+	String GetInfo() const;
+	// how the server did over the run, one line
+	String GetDebugText(float wallSeconds) const;
+
+	// header
+	int tickRate;
+	unsigned worldChecksum;
+
+	// capture length in seconds
+	float duration;
+
+	// readout
+	unsigned messagesSent;
+	unsigned bytesSent;
+	unsigned long long bytesReceived;
+	// clients the server dropped before their capture ended
+	unsigned dropped;
+	float replayTime;
+
+private:
+	// true when the client is done with its records
+	bool UpdateClient(ReplayClient& client, float time, const PODVector<unsigned>& sceneChecksums);
+
+	MappedFile mapped;
+	// record offsets of each captured client, in time order
+	Vector<PODVector<unsigned> > clientRecords;
+	unsigned records;
+
+	kNet::Network* network;
+	unsigned short serverPort;
+	Vector<ReplayClient*> clients;
+
+	// each frame's work in us, sorted for the percentiles when asked
+	PODVector<unsigned> frameUsec;
+	unsigned long long totalAllocations;
+	unsigned long long totalAllocatedBytes;
+	unsigned maxAllocations;
+};
@@ -0,0 +1,534 @@
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/Compression.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "InterpolationBuffer.h"
+#include "WorldSync.h"
+
+// positions go out as 16 bit fixed point, 1/32 unit over +-1024 units, velocities 1/16 unit/s over +-2048
+static const float POSITION_SCALE = 32.0f;
+static const float VELOCITY_SCALE = 16.0f;
+
+static short Quantise(float value, float scale)
+{
+	return (short)Clamp((int)(value * scale + (value < 0.0f ? -0.5f : 0.5f)), -32767, 32767);
+}
+
+static Vector3 Dequantise(const short* values, float scale)
+{
+	return Vector3(values[0] / scale, values[1] / scale, values[2] / scale);
+}
+
+// the model both sides run: carry on at the last sent velocity
+static Vector3 Predict(const BoidState& state, unsigned time)
+{
+	float elapsed = (int)(time - state.time) / 1000.0f;
+	return Dequantise(state.position, POSITION_SCALE) + Dequantise(state.velocity, VELOCITY_SCALE) * elapsed;
+}
+
+static void WriteState(VectorBuffer& message, const BoidState& state)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		message.WriteShort(state.position[i]);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		message.WriteShort(state.velocity[i]);
+	}
+}
+
+static void ReadState(Deserializer& message, BoidState& state)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		state.position[i] = message.ReadShort();
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		state.velocity[i] = message.ReadShort();
+	}
+}
+
+// boids face along their velocity, so their rotation never needs sending
+static Quaternion BoidRotation(const Vector3& velocity)
+{
+	Quaternion rotation;
+	rotation.FromLookRotation(velocity.Normalized(), Vector3::UP);
+	return rotation * Quaternion(90, 0, 0);
+}
+
+unsigned LoadWorld(ResourceCache* pRes, Scene* pScene)
+{
+	SharedPtr<File> file = pRes->GetFile(WORLD_SCENE_FILE);
+	if (!file)
+	{
+		URHO3D_LOGERROR(String("Could not open ") + WORLD_SCENE_FILE);
+		return 0;
+	}
+
+	unsigned checksum = file->GetChecksum();
+	if (!pScene->InstantiateXML(*file, Vector3::ZERO, Quaternion::IDENTITY, LOCAL))
+	{
+		URHO3D_LOGERROR(String("Could not instantiate ") + WORLD_SCENE_FILE);
+		return 0;
+	}
+
+	return checksum;
+}
+
+BoidStreamWriter::BoidStreamWriter()
+{
+	maxError = 0.25f;
+	maxSilence = 1.0f;
+	sequence = 0;
+
+	candidatesPerSecond = 0.0f;
+	sentPerSecond = 0.0f;
+	candidates = 0;
+	sent = 0;
+	lastReport = 0.0f;
+}
+
+void BoidStreamWriter::Capture(BoidState& state, const Vector3& position, const Vector3& velocity, unsigned time)
+{
+	state.position[0] = Quantise(position.x_, POSITION_SCALE);
+	state.position[1] = Quantise(position.y_, POSITION_SCALE);
+	state.position[2] = Quantise(position.z_, POSITION_SCALE);
+	state.velocity[0] = Quantise(velocity.x_, VELOCITY_SCALE);
+	state.velocity[1] = Quantise(velocity.y_, VELOCITY_SCALE);
+	state.velocity[2] = Quantise(velocity.z_, VELOCITY_SCALE);
+	state.time = time;
+}
+
+void BoidStreamWriter::WriteBootstrap(unsigned worldChecksum, const PODVector<Vector3>& positions, const PODVector<Vector3>& velocities, float time, VectorBuffer& message)
+{
+	unsigned timeMs = (unsigned)(time * 1000.0f);
+	if (states.Size() != positions.Size())
+	{
+		states.Resize(positions.Size());
+		for (unsigned i = 0; i < positions.Size(); i++)
+		{
+			Capture(states[i], positions[i], velocities[i], timeMs);
+		}
+	}
+
+	// the mirrored model rather than the real flock, so the new client predicts exactly what the others do
+	VectorBuffer raw;
+	raw.WriteUInt(worldChecksum);
+	raw.WriteUShort(sequence);
+	raw.WriteUShort((unsigned short)states.Size());
+	for (unsigned i = 0; i < states.Size(); i++)
+	{
+		WriteState(raw, states[i]);
+		raw.WriteUInt(states[i].time);
+	}
+
+	message = CompressVectorBuffer(raw);
+}
+
+void BoidStreamWriter::WriteUpdate(const PODVector<Vector3>& positions, const PODVector<Vector3>& velocities, unsigned short updateSequence, float time, VectorBuffer& message)
+{
+	sequence = updateSequence;
+	unsigned timeMs = (unsigned)(time * 1000.0f);
+	unsigned maxSilenceMs = (unsigned)(maxSilence * 1000.0f);
+
+	bool resized = states.Size() != positions.Size();
+	states.Resize(positions.Size());
+
+	// sequence, server time, then index, position and velocity of each boid that drifted
+	message.Clear();
+	message.WriteUShort(sequence);
+	message.WriteUInt(timeMs);
+
+	unsigned countPosition = message.GetPosition();
+	unsigned short count = 0;
+	message.WriteUShort(0);
+
+	for (unsigned i = 0; i < positions.Size(); i++)
+	{
+		BoidState& state = states[i];
+		float error = (positions[i] - Predict(state, timeMs)).Length();
+		if (!resized && error <= maxError && timeMs - state.time < maxSilenceMs)
+		{
+			continue;
+		}
+
+		Capture(state, positions[i], velocities[i], timeMs);
+		message.WriteUShort((unsigned short)i);
+		WriteState(message, state);
+		count++;
+	}
+
+	unsigned end = message.GetPosition();
+	message.Seek(countPosition);
+	message.WriteUShort(count);
+	message.Seek(end);
+
+	candidates += positions.Size();
+	sent += count;
+	if (time - lastReport >= 1.0f)
+	{
+		candidatesPerSecond = candidates / (time - lastReport);
+		sentPerSecond = sent / (time - lastReport);
+		candidates = 0;
+		sent = 0;
+		lastReport = time;
+	}
+}
+
+unsigned BoidStreamWriter::WriteResume(unsigned worldChecksum, unsigned sinceTime, float time, VectorBuffer& message)
+{
+	// the mirror again, boids the client last heard of before sinceTime it still predicts as the others do
+	VectorBuffer raw;
+	raw.WriteUInt(worldChecksum);
+	raw.WriteUShort(sequence);
+	raw.WriteUInt((unsigned)(time * 1000.0f));
+	raw.WriteUShort((unsigned short)states.Size());
+
+	unsigned countPosition = raw.GetPosition();
+	unsigned short count = 0;
+	raw.WriteUShort(0);
+	for (unsigned i = 0; i < states.Size(); i++)
+	{
+		if ((int)(states[i].time - sinceTime) <= 0)
+		{
+			continue;
+		}
+		raw.WriteUShort((unsigned short)i);
+		WriteState(raw, states[i]);
+		raw.WriteUInt(states[i].time);
+		count++;
+	}
+	unsigned end = raw.GetPosition();
+	raw.Seek(countPosition);
+	raw.WriteUShort(count);
+	raw.Seek(end);
+
+	message = CompressVectorBuffer(raw);
+	return count;
+}
+
+void BoidStreamWriter::Restart(unsigned short updateSequence)
+{
+	states.Clear();
+	sequence = updateSequence;
+}
+
+String BoidStreamWriter::GetDebugText() const
+{
+	float reduction = candidatesPerSecond > 0.0f ? (1.0f - sentPerSecond / candidatesPerSecond) * 100.0f : 0.0f;
+	return "sent " + String((int)sentPerSecond) + "/" + String((int)candidatesPerSecond) + " boids/s, "
+		+ String((int)reduction) + "% saved by dead reckoning (error " + String(maxError) + " silence " + String(maxSilence) + " s)";
+}
+
+BoidStreamReader::BoidStreamReader()
+{
+	ready = false;
+	serverChecksum = 0;
+	bootstrapBytes = 0;
+	bootstrapRawBytes = 0;
+	lastSequence = 0;
+	lastTime = 0;
+	snapDistance = 1.0f;
+	corrections = 0;
+}
+
+bool BoidStreamReader::ReadBootstrap(MemoryBuffer& message, unsigned worldChecksum, ResourceCache* pRes, Scene* pScene, SnapshotInterpolator& interpolator)
+{
+	VectorBuffer compressed(message.GetData(), message.GetSize());
+	VectorBuffer raw = DecompressVectorBuffer(compressed);
+	bootstrapBytes = message.GetSize();
+	bootstrapRawBytes = raw.GetSize();
+
+	serverChecksum = raw.ReadUInt();
+	if (serverChecksum != worldChecksum)
+	{
+		Clear();
+		return false;
+	}
+
+	lastSequence = raw.ReadUShort();
+	unsigned count = raw.ReadUShort();
+	unsigned stamp = lastSequence & 0xff;
+
+	// moving from the observer to the player stream brings a second bootstrap, keep the boids we have
+	bool reuse = ready && nodes.Size() == count;
+	if (!reuse)
+	{
+		Clear();
+	}
+	states.Clear();
+
+	Model* model = pRes->GetResource<Model>("Models/Cone.mdl");
+	Material* material = pRes->GetResource<Material>("Materials/Stone.xml");
+	for (unsigned i = 0; i < count && !raw.IsEof(); i++)
+	{
+		BoidState state;
+		ReadState(raw, state);
+		state.time = raw.ReadUInt();
+
+		Node* node = reuse ? nodes[i] : nullptr;
+		if (node && !interpolator.IsTracked(node->GetID()))
+		{
+			// a resume starts the interpolator over
+			interpolator.Track(node->GetID());
+		}
+		if (!node)
+		{
+			// only the look of the boid, the flock is simulated on the server
+			node = pScene->CreateChild("boid", LOCAL);
+			StaticModel* object = node->CreateComponent<StaticModel>(LOCAL);
+			object->SetModel(model);
+			object->SetMaterial(material);
+			object->SetCastShadows(true);
+
+			nodes.Push(node);
+			interpolator.Track(node->GetID());
+		}
+		states.Push(state);
+
+		interpolator.OnPosition(node->GetID(), stamp, Dequantise(state.position, POSITION_SCALE));
+		interpolator.OnRotation(node->GetID(), stamp, BoidRotation(Dequantise(state.velocity, VELOCITY_SCALE)));
+	}
+
+	updated.Resize(nodes.Size());
+	ready = true;
+	return true;
+}
+
+void BoidStreamReader::ReadUpdate(MemoryBuffer& message, SnapshotInterpolator& interpolator)
+{
+	if (!ready)
+	{
+		return;
+	}
+
+	unsigned short sequence = message.ReadUShort();
+	unsigned time = message.ReadUInt();
+	unsigned stamp = sequence & 0xff;
+
+	bool newer = (short)(sequence - lastSequence) > 0;
+	if (newer)
+	{
+		lastSequence = sequence;
+		lastTime = time;
+	}
+
+	for (unsigned i = 0; i < updated.Size(); i++)
+	{
+		updated[i] = false;
+	}
+
+	unsigned count = message.ReadUShort();
+	for (unsigned i = 0; i < count && !message.IsEof(); i++)
+	{
+		unsigned index = message.ReadUShort();
+		BoidState state;
+		ReadState(message, state);
+		state.time = time;
+
+		// a late update only counts for boids we have heard nothing newer about
+		if (index >= nodes.Size() || (int)(time - states[index].time) <= 0)
+		{
+			continue;
+		}
+		Vector3 position = Dequantise(state.position, POSITION_SCALE);
+		if ((position - Predict(states[index], time)).LengthSquared() > snapDistance * snapDistance)
+		{
+			corrections++;
+		}
+		states[index] = state;
+		updated[index] = true;
+
+		unsigned nodeID = nodes[index]->GetID();
+		interpolator.OnPosition(nodeID, stamp, position);
+		interpolator.OnRotation(nodeID, stamp, BoidRotation(Dequantise(state.velocity, VELOCITY_SCALE)));
+	}
+
+	// the rest carry on along their last velocity, the same prediction the server checked them against
+	if (newer)
+	{
+		for (unsigned i = 0; i < nodes.Size(); i++)
+		{
+			if (!updated[i])
+			{
+				interpolator.OnPosition(nodes[i]->GetID(), stamp, Predict(states[i], time));
+			}
+		}
+	}
+}
+
+bool BoidStreamReader::ReadResume(MemoryBuffer& message, unsigned worldChecksum, SnapshotInterpolator& interpolator)
+{
+	VectorBuffer compressed(message.GetData(), message.GetSize());
+	VectorBuffer raw = DecompressVectorBuffer(compressed);
+	bootstrapBytes = message.GetSize();
+	bootstrapRawBytes = raw.GetSize();
+
+	serverChecksum = raw.ReadUInt();
+	unsigned short sequence = raw.ReadUShort();
+	unsigned time = raw.ReadUInt();
+	unsigned total = raw.ReadUShort();
+	if (serverChecksum != worldChecksum || !ready || total != nodes.Size())
+	{
+		return false;
+	}
+	lastSequence = sequence;
+	lastTime = time;
+	unsigned stamp = sequence & 0xff;
+
+	unsigned count = raw.ReadUShort();
+	for (unsigned i = 0; i < count && !raw.IsEof(); i++)
+	{
+		unsigned index = raw.ReadUShort();
+		BoidState state;
+		ReadState(raw, state);
+		state.time = raw.ReadUInt();
+		if (index < states.Size())
+		{
+			states[index] = state;
+		}
+	}
+
+	// every boid where the server's model has it now, the interpolator starts over from here
+	for (unsigned i = 0; i < nodes.Size(); i++)
+	{
+		unsigned nodeID = nodes[i]->GetID();
+		if (!interpolator.IsTracked(nodeID))
+		{
+			interpolator.Track(nodeID);
+		}
+		interpolator.OnPosition(nodeID, stamp, Predict(states[i], time));
+		interpolator.OnRotation(nodeID, stamp, BoidRotation(Dequantise(states[i].velocity, VELOCITY_SCALE)));
+	}
+	return true;
+}
+
+void BoidStreamReader::Clear()
+{
+	for (unsigned i = 0; i < nodes.Size(); i++)
+	{
+		nodes[i]->Remove();
+	}
+	nodes.Clear();
+	states.Clear();
+	updated.Clear();
+	ready = false;
+	lastTime = 0;
+}
+
+BoidStreamModel::BoidStreamModel()
+{
+	checksum = 0;
+	lastTime = 0;
+}
+
+bool BoidStreamModel::ReadBootstrap(MemoryBuffer& message)
+{
+	VectorBuffer compressed(message.GetData(), message.GetSize());
+	VectorBuffer raw = DecompressVectorBuffer(compressed);
+	if (raw.GetSize() < 8)
+	{
+		return false;
+	}
+
+	checksum = raw.ReadUInt();
+	raw.ReadUShort();
+	unsigned count = raw.ReadUShort();
+	states.Resize(count);
+	lastTime = 0;
+	for (unsigned i = 0; i < count && !raw.IsEof(); i++)
+	{
+		ReadState(raw, states[i]);
+		states[i].time = raw.ReadUInt();
+		lastTime = Max(lastTime, states[i].time);
+	}
+	return true;
+}
+
+void BoidStreamModel::ReadUpdate(MemoryBuffer& message)
+{
+	message.ReadUShort();
+	unsigned time = message.ReadUInt();
+	lastTime = time;
+
+	unsigned count = message.ReadUShort();
+	for (unsigned i = 0; i < count && !message.IsEof(); i++)
+	{
+		unsigned index = message.ReadUShort();
+		BoidState state;
+		ReadState(message, state);
+		state.time = time;
+		if (index < states.Size())
+		{
+			states[index] = state;
+		}
+	}
+}
+
+void BoidStreamModel::Predict(unsigned time, PODVector<Vector3>& positions, PODVector<Vector3>& velocities) const
+{
+	positions.Resize(states.Size());
+	velocities.Resize(states.Size());
+	for (unsigned i = 0; i < states.Size(); i++)
+	{
+		positions[i] = ::Predict(states[i], time);
+		velocities[i] = Dequantise(states[i].velocity, VELOCITY_SCALE);
+	}
+}
+
+JoinTimer::JoinTimer()
+{
+	started = false;
+	done = false;
+	startTime = 0.0f;
+	sceneLoadedMs = 0.0f;
+	bootstrapMs = 0.0f;
+	firstFrameMs = 0.0f;
+}
+
+void JoinTimer::Start(float time)
+{
+	started = true;
+	done = false;
+	startTime = time;
+	sceneLoadedMs = 0.0f;
+	bootstrapMs = 0.0f;
+	firstFrameMs = 0.0f;
+}
+
+void JoinTimer::OnSceneLoaded(float time)
+{
+	sceneLoadedMs = (time - startTime) * 1000.0f;
+}
+
+void JoinTimer::OnBootstrap(float time)
+{
+	bootstrapMs = (time - startTime) * 1000.0f;
+}
+
+bool JoinTimer::OnFrame(float time, bool playable)
+{
+	if (!started || done || !playable)
+	{
+		return false;
+	}
+
+	done = true;
+	firstFrameMs = (time - startTime) * 1000.0f;
+	return true;
+}
+
+String JoinTimer::GetDebugText() const
+{
+	return "scene " + String((int)sceneLoadedMs) + " ms bootstrap " + String((int)bootstrapMs) + " ms first playable frame " + String((int)firstFrameMs) + " ms";
+}
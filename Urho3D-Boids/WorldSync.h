@@ -0,0 +1,166 @@
+#pragma once
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+	class MemoryBuffer;
+	class Node;
+	class ResourceCache;
+	class Scene;
+	class VectorBuffer;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class SnapshotInterpolator;
+
+// static world both peers build locally, a joining client must have the same file as the server
+static const char* const WORLD_SCENE_FILE = "Scenes/BoidsWorld.xml";
+
+// custom network messages, server to client
+static const int MSG_WORLDBOOTSTRAP = 0x201;
+static const int MSG_BOIDUPDATE = 0x202;
+// a resumed client's catch up, see BoidStreamWriter::WriteResume
+static const int MSG_BOIDRESUME = 0x20f;
+
+// instantiate the static world as local nodes, returns the file checksum or 0 when it could not be loaded
+unsigned LoadWorld(ResourceCache* pRes, Scene* pScene);
+
+// what a client knows of one boid, the position and velocity last sent and the server time they were sent at
+struct BoidState
+{
+	short position[3];
+	short velocity[3];
+	unsigned time;
+};
+
+// server: the flock as one compressed bootstrap for a joining client, then per update the boids whose
+// dead reckoned position on the clients has drifted too far from the real one
+class BoidStreamWriter
+{
+public:
+	BoidStreamWriter();
+
+	// the flock comes as each boid's position and velocity captured at time, so it can be written away from the scene
+	void WriteBootstrap(unsigned worldChecksum, const PODVector<Vector3>& positions, const PODVector<Vector3>& velocities, float time, VectorBuffer& message);
+
+	// the same message goes to every client that shares this writer, updateSequence counts network updates so
+	// writers sending at different rates stamp the same update alike
+	void WriteUpdate(const PODVector<Vector3>& positions, const PODVector<Vector3>& velocities, unsigned short updateSequence, float time, VectorBuffer& message);
+
+	// for a client that already has the stream up to sinceTime, in ms of server time: only the boids sent since,
+	// compressed like the bootstrap. Returns how many that is, the caller sends the bootstrap instead when the
+	// catch up would be no smaller
+	unsigned WriteResume(unsigned worldChecksum, unsigned sinceTime, float time, VectorBuffer& message);
+	unsigned GetBoidCount() const { return states.Size(); }
+
+	// forget the mirror, for when nobody has been sent the stream, the next bootstrap captures the flock afresh
+	void Restart(unsigned short updateSequence);
+
+	String GetDebugText() const;
+
+	// a boid is sent when the clients' prediction is this many units out, or it has not been sent for this many seconds.
+	// The mirror moves on without an ack, so maxSilence also bounds how long a lost update leaves a client out
+	float maxError;
+	float maxSilence;
+
+	// sequence of the last update written
+	unsigned short sequence;
+
+	// readout, boids per second that could have been sent and that were
+	float candidatesPerSecond;
+	float sentPerSecond;
+
+private:
+	void Capture(BoidState& state, const Vector3& position, const Vector3& velocity, unsigned time);
+
+	// the clients' model of each boid, mirrored here
+	PODVector<BoidState> states;
+	unsigned candidates;
+	unsigned sent;
+	float lastReport;
+};
+
+// client: local boid nodes created from the bootstrap, moved by the updates and dead reckoned in between
+class BoidStreamReader
+{
+public:
+	BoidStreamReader();
+
+	// false when the server's world file does not match ours
+	bool ReadBootstrap(MemoryBuffer& message, unsigned worldChecksum, ResourceCache* pRes, Scene* pScene, SnapshotInterpolator& interpolator);
+
+	// feed the sent and predicted positions to the interpolator
+	void ReadUpdate(MemoryBuffer& message, SnapshotInterpolator& interpolator);
+
+	// after a resume, the boids sent while we were away on top of the ones we kept; false when the message does
+	// not fit what we have
+	bool ReadResume(MemoryBuffer& message, unsigned worldChecksum, SnapshotInterpolator& interpolator);
+
+	// remove the boid nodes
+	void Clear();
+
+	bool ready;
+	unsigned serverChecksum;
+	unsigned bootstrapBytes;
+	unsigned bootstrapRawBytes;
+
+	PODVector<Node*> nodes;
+
+	// server time in ms of the newest update, 0 before the first
+	unsigned lastTime;
+
+	// boids an update moved further than snapDistance from where we predicted them, a visible correction
+	float snapDistance;
+	unsigned corrections;
+
+private:
+	PODVector<BoidState> states;
+	PODVector<bool> updated;
+	unsigned short lastSequence;
+};
+
+// the clients' model of the flock without any nodes, for reading a recorded stream back
+class BoidStreamModel
+{
+public:
+	BoidStreamModel();
+
+	// false when the message is not a bootstrap
+	bool ReadBootstrap(MemoryBuffer& message);
+	void ReadUpdate(MemoryBuffer& message);
+
+	// every boid where the model has it at time, in ms of server time, and the velocity it was last sent with
+	void Predict(unsigned time, PODVector<Vector3>& positions, PODVector<Vector3>& velocities) const;
+
+	unsigned checksum;
+	// server time in ms of the newest update, 0 before the first
+	unsigned lastTime;
+
+private:
+	PODVector<BoidState> states;
+};
+
+// client: how long a join takes, from Connect to the first frame with the whole world in it
+class JoinTimer
+{
+public:
+	JoinTimer();
+
+	void Start(float time);
+	void OnSceneLoaded(float time);
+	void OnBootstrap(float time);
+	// returns true the one time the first playable frame is reached
+	bool OnFrame(float time, bool playable);
+
+	String GetDebugText() const;
+
+	bool started;
+	bool done;
+	float startTime;
+	float sceneLoadedMs;
+	float bootstrapMs;
+	float firstFrameMs;
+};
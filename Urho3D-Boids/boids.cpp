@@ -41,76 +41,107 @@ boids::~boids()
 
 }
 
-void boids::Initialise(ResourceCache *pRes, Scene *pScene)
+void boids::Initialise(ResourceCache *pRes, Scene *pScene, DeterministicRandom& random)
 {
-	pNode = pScene->CreateChild("boid");
+	// local on every peer, the server streams the flock to clients itself
+	pNode = pScene->CreateChild("boid", LOCAL);
 	pNode->SetPosition(Vector3(0.0f, 10.0f, 50.0f));
 	pNode->SetRotation(Quaternion(0.0f, 0.0f, 0.0f));
 	pNode->SetScale(1.0f);
 
-	pObject = pNode->CreateComponent<StaticModel>();
+	pObject = pNode->CreateComponent<StaticModel>(LOCAL);
 	pObject->SetModel(pRes->GetResource<Model>("Models/Cone.mdl"));
 	pObject->SetMaterial(pRes->GetResource<Material>("Materials/Stone.xml"));
 	pObject->SetCastShadows(true);
 
-	pRigidBody = pNode->CreateComponent<RigidBody>();
+	Vector3 position;
+	Vector3 velocity;
+	RandomStart(random, position, velocity);
+
+	pRigidBody = pNode->CreateComponent<RigidBody>(LOCAL);
 	pRigidBody->SetMass(1.0f);
 	pRigidBody->SetUseGravity(false);
-	pRigidBody->SetPosition(Vector3(Random(180.0f) - 90.0f, Random(40.0f), Random(180.0f) - 90.0f));
+	pRigidBody->SetPosition(position);
 	pRigidBody->SetTrigger(true);
 
-	pCollisionShape = pNode->CreateComponent<CollisionShape>();
+	pCollisionShape = pNode->CreateComponent<CollisionShape>(LOCAL);
 	pCollisionShape->SetBox(Vector3(1.5f, 1.5f, 1.5f));
 
 	//setting the initial velocity
-	pRigidBody->SetLinearVelocity(Vector3(Random(-20, 20), 0, Random(-20, 20)));
+	pRigidBody->SetLinearVelocity(velocity);
+}
+
+void boids::RandomStart(DeterministicRandom& random, Vector3& position, Vector3& velocity)
+{
+	// one call per component in a fixed order, so a seed always lays the flock out the same way
+	position.x_ = random.Float(180.0f) - 90.0f;
+	position.y_ = random.Float(40.0f);
+	position.z_ = random.Float(180.0f) - 90.0f;
+	velocity.x_ = random.Float(-20.0f, 20.0f);
+	velocity.y_ = 0.0f;
+	velocity.z_ = random.Float(-20.0f, 20.0f);
 }
 
 void boids::ComputeForce(boids * boidList)
+{
+	// the rules run on plain state, which the lockstep flock keeps instead of rigid bodies
+	Vector3 positions[BOIDS_PER_SET];
+	Vector3 velocities[BOIDS_PER_SET];
+	int self = 0;
+	for (int i = 0; i < numberOfBoids; i++)
+	{
+		if (this == &boidList[i]) self = i;
+		positions[i] = boidList[i].pRigidBody->GetPosition();
+		velocities[i] = boidList[i].pRigidBody->GetLinearVelocity();
+	}
+	force = FlockForce(positions, velocities, numberOfBoids, self);
+}
+
+Vector3 boids::FlockForce(const Vector3* positions, const Vector3* velocities, int count, int self)
 {
 	//Attraction force
 
 	Vector3 CoM; //centre of mass, accumulated total
 	int nAttract = 0; //count number of neigbours
-	//set the force member variable to zero
-	force = Vector3(0, 0, 0);
+	//set the force to zero
+	Vector3 force(0, 0, 0);
 	//Search Neighbourhood
-	for (int i = 0; i < numberOfBoids; i++)
+	for (int i = 0; i < count; i++)
 	{
 		//the current boid?
-		if (this == &boidList[i]) continue;
+		if (i == self) continue;
 		//sep = vector position of this boid from current oid
-		Vector3 sep = pRigidBody->GetPosition() - boidList[i].pRigidBody->GetPosition();
+		Vector3 sep = positions[self] - positions[i];
 		float d = sep.Length(); //distance of boid
 		if (d < Range_FAttract)
 		{
 			//with range, so is a neighbour
-			CoM += boidList[i].pRigidBody->GetPosition();
+			CoM += positions[i];
 			nAttract++;
 		}
 	}
 	if (nAttract > 0)
 	{
 		CoM /= nAttract;
-		Vector3 dir = (CoM - pRigidBody->GetPosition()).Normalized();
+		Vector3 dir = (CoM - positions[self]).Normalized();
 		Vector3 vDesired = dir * FAttract_Vmax;
-		force += (vDesired - pRigidBody->GetLinearVelocity())*FAttract_Factor;
+		force += (vDesired - velocities[self])*FAttract_Factor;
 	}
 	if (nAttract > 5)
 	{
 		// stop checking once 5 neighbours have been found
-		return;
+		return force;
 	}
 
 	//seperation force
 	Vector3 sepForce;
 	int nRepel = 0;
-	for (int i = 0; i < numberOfBoids; i++)
+	for (int i = 0; i < count; i++)
 	{
 		//the current boid?
-		if (this == &boidList[i]) continue;
+		if (i == self) continue;
 		//sep = vector position of this boid from current oid
-		Vector3 sep = pRigidBody->GetPosition() - boidList[i].pRigidBody->GetPosition();
+		Vector3 sep = positions[self] - positions[i];
 		float d = sep.Length(); //distance of boid
 		if (d < Range_FRepel)
 		{
@@ -126,22 +157,22 @@ void boids::ComputeForce(boids * boidList)
 	if (nRepel > 5)
 	{
 		// stop checking once 5 neighbours have been found
-		return;
+		return force;
 	}
 
 	//Allignment direction
 	Vector3 align;
 	int nAlign = 0;
-	for (int i = 0; i < numberOfBoids; i++)
+	for (int i = 0; i < count; i++)
 	{
 		//the current boid?
-		if (this == &boidList[i]) continue;
+		if (i == self) continue;
 		//sep = vector position of this boid from current oid
-		Vector3 sep = pRigidBody->GetPosition() - boidList[i].pRigidBody->GetPosition();
+		Vector3 sep = positions[self] - positions[i];
 		float d = sep.Length(); //distance of boid
 		if (d < Range_FAlign)
 		{
-			align += boidList[i].pRigidBody->GetLinearVelocity();
+			align += velocities[i];
 			nAlign++;
 		}
 	}
@@ -151,47 +182,66 @@ void boids::ComputeForce(boids * boidList)
 
 		Vector3 finalVel = align;
 
-		force += (finalVel - pRigidBody->GetLinearVelocity()) * FAlign_Factor;
-	}
-	if (nAlign > 5)
-	{
-		// stop checking once 5 neighbours have been found
-		return;
+		force += (finalVel - velocities[self]) * FAlign_Factor;
 	}
+	return force;
 }
 
-void boids::Update(float lastFrame)
+bool boids::LimitSpeed(Vector3& velocity)
 {
-	pRigidBody->ApplyForce(force);
-	Vector3 vel = pRigidBody->GetLinearVelocity();
-	
-	float d = vel.Length();
+	float d = velocity.Length();
 	if (d < 10.0f)
 	{
-		d = 10.0f;
-		pRigidBody->SetLinearVelocity(vel.Normalized()*d);
+		velocity = velocity.Normalized() * 10.0f;
+		return true;
 	}
 	else if (d > 50.0f)
 	{
-		d = 50.0f;
-		pRigidBody->SetLinearVelocity(vel.Normalized()*d);
+		velocity = velocity.Normalized() * 50.0f;
+		return true;
+	}
+	return false;
+}
+
+bool boids::LimitHeight(Vector3& position)
+{
+	if (position.y_ < 10.0f)
+	{
+		position.y_ = 10.0f;
+		return true;
+	}
+	else if (position.y_ > 150.0f)
+	{
+		position.y_ = 150.0f;
+		return true;
 	}
+	return false;
+}
 
+Quaternion boids::Heading(const Vector3& velocity)
+{
 	Quaternion endRot = Quaternion(0, 0, 0);
-	Vector3 nVel = vel.Normalized();
+	Vector3 nVel = velocity.Normalized();
 	endRot.FromLookRotation(nVel, Vector3::UP);
-	endRot = endRot * Quaternion(90, 0, 0);
-	pRigidBody->SetRotation(endRot);
+	return endRot * Quaternion(90, 0, 0);
+}
+
+void boids::Update(float lastFrame)
+{
+	pRigidBody->ApplyForce(force);
+	Vector3 vel = pRigidBody->GetLinearVelocity();
 	
-	Vector3 p = pRigidBody->GetPosition();
-	if (p.y_ < 10.0f)
+	Vector3 limited = vel;
+	if (LimitSpeed(limited))
 	{
-		p.y_ = 10.0f;
-		pRigidBody->SetPosition(p);
+		pRigidBody->SetLinearVelocity(limited);
 	}
-	else if (p.y_ > 150.0f)
+
+	pRigidBody->SetRotation(Heading(vel));
+	
+	Vector3 p = pRigidBody->GetPosition();
+	if (LimitHeight(p))
 	{
-		p.y_ = 150.0f;
 		pRigidBody->SetPosition(p);
 	}
 }
@@ -201,11 +251,11 @@ BoidSet::BoidSet()
 
 }
 
-void BoidSet::Initialise(ResourceCache *pRes, Scene *pScene)
+void BoidSet::Initialise(ResourceCache *pRes, Scene *pScene, DeterministicRandom& random)
 {
 	for (int i = 0; i < numberOfBoids; i++)
 	{
-		boidList[i].Initialise(pRes, pScene);
+		boidList[i].Initialise(pRes, pScene, random);
 	}
 }
 
@@ -218,4 +268,20 @@ void BoidSet::Update(float tm)
 	}
 }
 
+void BoidSet::ComputeForces()
+{
+	for (int i = 0; i < numberOfBoids; i++)
+	{
+		boidList[i].ComputeForce(&boidList[0]);
+	}
+}
+
+void BoidSet::ApplyForces(float tm)
+{
+	for (int i = 0; i < numberOfBoids; i++)
+	{
+		boidList[i].Update(tm);
+	}
+}
+
 
@@ -20,6 +20,8 @@
 #include <Urho3D/Resource/ResourceCache.h>
 #include <Urho3D/Scene/Scene.h>
 
+#include "DeterministicRandom.h"
+
 namespace Urho3D
 {
 	class Node;
@@ -31,6 +33,8 @@ namespace Urho3D
 // All Urho3D classes reside in namespace Urho3D
 using namespace Urho3D;
 
+const int BOIDS_PER_SET = 20;
+
 class boids
 {
 	Vector3 force;
@@ -48,29 +52,46 @@ class boids
 	static float FAlign_Factor;
 	static float FAttract_Vmax;
 
-	int numberOfBoids = 20;
+	int numberOfBoids = BOIDS_PER_SET;
 
 public:
 	boids();
 
 	~boids();
 
-	void Initialise(ResourceCache *pRes, Scene *pScene);
+	void Initialise(ResourceCache *pRes, Scene *pScene, DeterministicRandom& random);
 
 	void ComputeForce(boids *boid);
 
 	void Update(float lastFrame);
 
+	// starting position and velocity drawn from random
+	static void RandomStart(DeterministicRandom& random, Vector3& position, Vector3& velocity);
+	// attract, repel and align against the count boids of a set, self is the one being steered
+	static Vector3 FlockForce(const Vector3* positions, const Vector3* velocities, int count, int self);
+	// speed kept between 10 and 50 and height between 10 and 150, true when it had to be changed
+	static bool LimitSpeed(Vector3& velocity);
+	static bool LimitHeight(Vector3& position);
+	// model rotation for a boid flying along velocity
+	static Quaternion Heading(const Vector3& velocity);
+
+	Node* GetNode() const { return pNode; }
+	RigidBody* GetBody() const { return pRigidBody; }
+
 };
 
 class BoidSet
 {
 public:
-	int numberOfBoids = 20;
-	boids boidList[20];
+	int numberOfBoids = BOIDS_PER_SET;
+	boids boidList[BOIDS_PER_SET];
 	BoidSet();
-	void Initialise(ResourceCache *pRes, Scene *pScene);
+	void Initialise(ResourceCache *pRes, Scene *pScene, DeterministicRandom& random);
 	void Update(float tm);
+	// Update in two halves: the steering only reads the rigid bodies so sets can compute it on worker threads,
+	// applying it goes through Bullet and stays on the main thread
+	void ComputeForces();
+	void ApplyForces(float tm);
 };
 
 